@@ -0,0 +1,160 @@
+// Batch feasibility runner - acceptance ratio vs utilization
+//
+// For each total utilization from BATCH_U_STEP to 1.0 it generates a number
+// of UUniFast service sets and counts how many the RM LUB, completion time
+// (RTA) and scheduling point tests accept under deadline monotonic fixed
+// priorities, and how many EDF accepts.  The two exact fixed priority tests
+// should agree, so any set they disagree on is counted too.  With a minimum
+// D/T below 1 the deadlines are constrained, which is where EDF's processor
+// demand test and the fixed priority tests part ways.
+//
+// The (utilization, set) jobs are handed out to one worker per core through
+// an atomic counter, and every set is generated from a seed derived from its
+// job number, so the results do not depend on the number of threads.
+//
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "feasibility.h"
+
+#define BATCH_U_STEP (0.05)
+#define BATCH_POINTS (20)
+#define BATCH_MIN_PERIOD (1000ULL)      // 1 msec in usec
+#define BATCH_MAX_PERIOD (1000000ULL)   // 1 sec
+
+typedef struct
+{
+    U32_T lub;
+    U32_T ct;
+    U32_T sp;
+    U32_T edf;
+    U32_T disagree;
+} batchCount_t;
+
+typedef struct
+{
+    U32_T numServices;
+    U32_T setsPerPoint;
+    double minDeadlineRatio;
+    volatile unsigned long nextJob;
+    batchCount_t *counts;       // [thread][point]
+} batchShared_t;
+
+typedef struct
+{
+    batchShared_t *shared;
+    int threadIdx;
+} batchWorker_t;
+
+
+static void *batch_worker(void *arg)
+{
+    batchWorker_t *worker=(batchWorker_t *)arg;
+    batchShared_t *shared=worker->shared;
+    batchCount_t *counts=&shared->counts[worker->threadIdx * BATCH_POINTS];
+    service_t *services=malloc(sizeof(service_t) * shared->numServices);
+    unsigned long job, totalJobs=(unsigned long)BATCH_POINTS * shared->setsPerPoint;
+    unsigned int seed;
+    int point, ct, sp;
+
+    while((job=__atomic_fetch_add(&shared->nextJob, 1, __ATOMIC_RELAXED)) < totalJobs)
+    {
+        point = job / shared->setsPerPoint;
+        seed = (unsigned int)(job * 2654435761UL + 1);
+
+        uunifast_service_set(shared->numServices, BATCH_U_STEP * (point+1), BATCH_MIN_PERIOD,
+                             BATCH_MAX_PERIOD, &seed, services);
+        constrain_deadlines(shared->numServices, services, shared->minDeadlineRatio, &seed);
+
+        counts[point].lub += lub_feasibility(shared->numServices, services);
+        counts[point].ct += (ct=rta_feasibility(shared->numServices, services, NULL));
+        counts[point].sp += (sp=rta_scheduling_point_feasibility(shared->numServices, services));
+        counts[point].edf += edf_feasibility(shared->numServices, services);
+        if(ct != sp)
+            counts[point].disagree++;
+    }
+
+    free(services);
+    return NULL;
+}
+
+
+// nthreads 0 for one per online CPU
+//
+void batch_feasibility(U32_T numServices, U32_T setsPerPoint, int nthreads, double minDeadlineRatio)
+{
+    batchShared_t shared;
+    batchWorker_t *workers;
+    pthread_t *threads;
+    batchCount_t total;
+    struct timespec start, stop;
+    double secs;
+    int idx, point;
+
+    if(nthreads <= 0)
+        nthreads=sysconf(_SC_NPROCESSORS_ONLN);
+
+    shared.numServices=numServices;
+    shared.setsPerPoint=setsPerPoint;
+    shared.minDeadlineRatio=minDeadlineRatio;
+    shared.nextJob=0;
+    shared.counts=calloc((size_t)nthreads * BATCH_POINTS, sizeof(batchCount_t));
+    workers=malloc(sizeof(batchWorker_t) * nthreads);
+    threads=malloc(sizeof(pthread_t) * nthreads);
+
+    if(!shared.counts || !workers || !threads)
+    {
+        perror("batch_feasibility");
+        exit(-1);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for(idx=0; idx < nthreads; idx++)
+    {
+        workers[idx].shared=&shared;
+        workers[idx].threadIdx=idx;
+        if(pthread_create(&threads[idx], NULL, batch_worker, &workers[idx]) != 0)
+        {
+            perror("pthread_create");
+            exit(-1);
+        }
+    }
+
+    for(idx=0; idx < nthreads; idx++)
+        pthread_join(threads[idx], NULL);
+
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+    secs=(double)(stop.tv_sec - start.tv_sec) + (double)(stop.tv_nsec - start.tv_nsec)/1000000000.0;
+
+    printf("%u UUniFast sets of %u services per point, D/T %.2lf-1, %d threads, %.2lf secs, %.0lf sets/sec\n",
+           setsPerPoint, numServices, minDeadlineRatio, nthreads, secs, (double)BATCH_POINTS*setsPerPoint/secs);
+    printf("   U   RM LUB       CT   SCH PT      EDF  disagree\n");
+
+    for(point=0; point < BATCH_POINTS; point++)
+    {
+        memset(&total, 0, sizeof(total));
+
+        for(idx=0; idx < nthreads; idx++)
+        {
+            total.lub += shared.counts[idx*BATCH_POINTS + point].lub;
+            total.ct += shared.counts[idx*BATCH_POINTS + point].ct;
+            total.sp += shared.counts[idx*BATCH_POINTS + point].sp;
+            total.edf += shared.counts[idx*BATCH_POINTS + point].edf;
+            total.disagree += shared.counts[idx*BATCH_POINTS + point].disagree;
+        }
+
+        printf("%4.2f %8.3f %8.3f %8.3f %8.3f %9u\n", BATCH_U_STEP*(point+1),
+               (double)total.lub/setsPerPoint, (double)total.ct/setsPerPoint,
+               (double)total.sp/setsPerPoint, (double)total.edf/setsPerPoint, total.disagree);
+    }
+
+    free(shared.counts);
+    free(workers);
+    free(threads);
+}
@@ -0,0 +1,205 @@
+// EDF feasibility by processor demand analysis, with QPA
+//
+// With dynamic priorities EDF (and LLF, which is optimal on one core in the
+// same way) meets every deadline if and only if the processor demand in
+// every interval [0, t] is no more than t (Baruah, Rosier and Howell, 1990):
+//
+//     h(t) = sum over D(i) <= t of (floor((t - D(i))/T(i)) + 1) * C(i) <= t
+//
+// For D=T this reduces to U <= 1.  For constrained deadlines, D < T, h(t)
+// only needs checking at absolute deadlines below a bound L - the shorter of
+// the synchronous busy period and, when U < 1,
+//
+//     La = max(D(i), sum((T(i) - D(i)) * U(i)) / (1 - U))
+//
+// U is summed in floating point, so a set within UTILITY_EPSILON of U = 1 is
+// taken as U = 1 and bounded by the busy period alone, which for U <= 1 ends
+// by the hyperperiod, leaving the exact decision to the demand test.
+//
+// There can be very many deadlines below L.  QPA (Zhang and Burns, "Schedulability
+// analysis for real-time systems with EDF scheduling", IEEE Transactions on
+// Computers 58.9, 2009) walks backwards from L instead, jumping from t to
+// h(t) whenever h(t) < t, and typically evaluates h(t) only a few times.
+//
+// This is what sizes a SCHED_DEADLINE service: runtime = C, deadline = D,
+// period = T, and edf_max_wcet() gives the largest runtime one service can
+// have with the rest of the set still feasible.
+//
+
+#include "feasibility.h"
+
+
+static U64_T demand(U32_T numServices, service_t services[], U64_T t)
+{
+    U64_T h=0;
+    U32_T i;
+
+    for(i=0; i < numServices; i++)
+        if(services[i].deadline <= t)
+            h += ((t - services[i].deadline) / services[i].period + 1) * services[i].wcet;
+
+    return h;
+}
+
+
+// Largest absolute deadline k*T(i) + D(i) strictly below t, 0 if none
+//
+static U64_T deadline_before(U32_T numServices, service_t services[], U64_T t)
+{
+    U64_T d, latest=0;
+    U32_T i;
+
+    for(i=0; i < numServices; i++)
+    {
+        if(services[i].deadline >= t)
+            continue;
+
+        d = ((t - services[i].deadline - 1) / services[i].period) * services[i].period + services[i].deadline;
+
+        if(d > latest)
+            latest=d;
+    }
+
+    return latest;
+}
+
+
+// Least common multiple of the periods, ~0 if it does not fit
+//
+static U64_T hyperperiod(U32_T numServices, service_t services[])
+{
+    U64_T h=1, a, b, r;
+    U32_T i;
+
+    for(i=0; i < numServices; i++)
+    {
+        for(a=h, b=services[i].period; b != 0; a=b, b=r)
+            r = a % b;
+
+        if(h / a > ~0ULL / services[i].period)
+            return ~0ULL;
+
+        h = (h / a) * services[i].period;
+    }
+
+    return h;
+}
+
+
+// Synchronous busy period, 0 if it passes limit
+//
+static U64_T busy_period(U32_T numServices, service_t services[], U64_T limit)
+{
+    U64_T w=0, wnext=0;
+    U32_T i;
+
+    for(i=0; i < numServices; i++)
+        wnext += services[i].wcet;
+
+    while(wnext != w)
+    {
+        w = wnext;
+        if(w > limit)
+            return 0;
+
+        for(i=0, wnext=0; i < numServices; i++)
+            wnext += ((w + services[i].period - 1) / services[i].period) * services[i].wcet;
+    }
+
+    return w;
+}
+
+
+int edf_feasibility(U32_T numServices, service_t services[])
+{
+    U64_T t, h, L, La=0, Lb, dmin=0, dmax=0, limit=~0ULL;
+    double utility_sum=0.0, slack=0.0, bound;
+    int implicit_deadlines=TRUE;
+    U32_T i;
+
+    if(numServices == 0)
+        return TRUE;
+
+    for(i=0; i < numServices; i++)
+    {
+        if((services[i].period == 0) || (services[i].wcet > services[i].deadline))
+            return FALSE;
+
+        utility_sum += (double)services[i].wcet / (double)services[i].period;
+
+        // deadlines past the period only add (T - D) U < 0 to La, so clip it
+        if(services[i].deadline < services[i].period)
+            slack += (double)(services[i].period - services[i].deadline) *
+                     (double)services[i].wcet / (double)services[i].period;
+
+        if(services[i].deadline != services[i].period)
+            implicit_deadlines=FALSE;
+
+        if((i == 0) || (services[i].deadline < dmin)) dmin=services[i].deadline;
+        if(services[i].deadline > dmax) dmax=services[i].deadline;
+    }
+
+    if(utility_sum > 1.0 + UTILITY_EPSILON)
+        return FALSE;
+
+    if(utility_sum < 1.0 - UTILITY_EPSILON)
+    {
+        if(implicit_deadlines)
+            return TRUE;
+
+        // past 2^62 La is no use as a bound, and the cast would overflow
+        bound = slack / (1.0 - utility_sum);
+        if(bound < 4611686018427387904.0)
+        {
+            La = (U64_T)bound + 1;
+            if(La < dmax) La=dmax;
+            limit=La;
+        }
+    }
+
+    // the busy period is the only bound at U=1, and passes the hyperperiod
+    // only when U > 1 after all; otherwise take the shorter
+    else
+        limit = hyperperiod(numServices, services);
+
+    Lb = busy_period(numServices, services, limit);
+    L = ((Lb != 0) && ((La == 0) || (Lb < La))) ? Lb : La;
+
+    if(L == 0)
+        return FALSE;
+
+    t = deadline_before(numServices, services, L + 1);
+
+    while(((h=demand(numServices, services, t)) <= t) && (h > dmin))
+    {
+        if(h < t)
+            t = h;
+        else
+            t = deadline_before(numServices, services, t);
+    }
+
+    return (h <= dmin);
+}
+
+
+// Largest C(idx) that keeps the set EDF feasible, 0 if none does - binary
+// search on the monotone QPA decision
+//
+U64_T edf_max_wcet(U32_T numServices, service_t services[], U32_T idx)
+{
+    U64_T saved=services[idx].wcet, lo=0, hi=services[idx].deadline, mid;
+
+    while(lo < hi)
+    {
+        mid = lo + (hi - lo + 1) / 2;
+        services[idx].wcet = mid;
+
+        if(edf_feasibility(numServices, services))
+            lo = mid;
+        else
+            hi = mid - 1;
+    }
+
+    services[idx].wcet = saved;
+    return lo;
+}
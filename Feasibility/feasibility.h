@@ -0,0 +1,65 @@
+// Fixed priority feasibility tests for large service sets
+//
+// The tests in feasibility_tests.c follow the textbook formulation closely.  The
+// ones declared here give the same decisions using integer arithmetic only, so
+// they can screen thousands of generated service sets per second.
+//
+
+#ifndef FEASIBILITY_H
+#define FEASIBILITY_H
+
+#define TRUE 1
+#define FALSE 0
+#define U32_T unsigned int
+#define U64_T unsigned long long
+
+// Utilization sums are floating point, so shortcuts taken on them stay this
+// far from the bound and leave the sets in between to the integer analysis
+#define UTILITY_EPSILON (1e-9)
+
+// One service, times in any common integer unit (e.g. usec).  Services are
+// passed in priority order, index 0 highest, for the fixed priority tests.
+typedef struct
+{
+    U64_T period;
+    U64_T wcet;
+    U64_T deadline;
+    U32_T priority;
+} service_t;
+
+// Exact response time analysis, response[] (may be NULL) gets R(i) for each
+// service or 0 past the first one to miss its deadline.  Both RTA tests need
+// T(i) > 0 and C(i) <= D(i) <= T(i), and return FALSE for any other set.
+int rta_feasibility(U32_T numServices, service_t services[], U64_T response[]);
+
+// Exact scheduling point test over the reduced point set
+int rta_scheduling_point_feasibility(U32_T numServices, service_t services[]);
+
+// Sort by deadline, then period - rate monotonic when D=T
+void deadline_monotonic_order(U32_T numServices, service_t services[]);
+
+double service_utilization(U32_T numServices, service_t services[]);
+
+// Liu and Layland RM least upper bound, without the printing
+int lub_feasibility(U32_T numServices, service_t services[]);
+
+// edf.c - EDF (and LLF) processor demand test with QPA, D <= T or D > T
+int edf_feasibility(U32_T numServices, service_t services[]);
+
+// Largest WCET (SCHED_DEADLINE runtime) service idx can have with the set
+// still EDF feasible
+U64_T edf_max_wcet(U32_T numServices, service_t services[], U32_T idx);
+
+// taskset.c - CSV/JSON loader and UUniFast generator
+int load_service_set(char *path, service_t services[], U32_T maxServices);
+void uunifast_service_set(U32_T numServices, double utilization, U64_T minPeriod, U64_T maxPeriod,
+                          unsigned int *seed, service_t services[]);
+
+// Draw each D(i) uniformly from [max(C(i), minRatio*T(i)), T(i)] and reorder deadline monotonic
+void constrain_deadlines(U32_T numServices, service_t services[], double minRatio, unsigned int *seed);
+
+// batch.c - acceptance ratio vs utilization on all cores, nthreads 0 for one per CPU,
+// D/T drawn from [minDeadlineRatio, 1]
+void batch_feasibility(U32_T numServices, U32_T setsPerPoint, int nthreads, double minDeadlineRatio);
+
+#endif
@@ -45,10 +45,15 @@
 
 #include <math.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
 
-#define TRUE 1
-#define FALSE 0
-#define U32_T unsigned int
+#include "feasibility.h"
+
+#define BENCH_SETS (1000)
+#define BENCH_SERVICES (100)
+#define FILE_MAX_SERVICES (4096)
 
 // U=0.7333
 U32_T ex0_period[] = {2, 10, 15};
@@ -73,168 +78,281 @@ U32_T ex4_wcet[] = {1, 1, 4};
 int completion_time_feasibility(U32_T numServices, U32_T period[], U32_T wcet[], U32_T deadline[]);
 int scheduling_point_feasibility(U32_T numServices, U32_T period[], U32_T wcet[], U32_T deadline[]);
 int rate_monotonic_least_upper_bound(U32_T numServices, U32_T period[], U32_T wcet[], U32_T deadline[]);
+void fast_rta_examples(void);
+void fast_rta_benchmark(U32_T numSets, U32_T numServices);
 
 
-int main(void)
-{ 
-    int i;
-	U32_T numServices;
-    
-    printf("******** Completion Test Feasibility Example\n");
-   
-    printf("Ex-0 U=%4.2f\% (C1=1, C2=1, C3=2; T1=2, T2=10, T3=15; T=D): ",
-		   ((1.0/2.0)*100.0 + (1.0/10.0)*100.0 + (2.0/15.0)*100.0));
-	numServices = 3;
-    if(completion_time_feasibility(numServices, ex0_period, ex0_wcet, ex0_period) == TRUE)
-        printf("CT test FEASIBLE\n");
-    else
-        printf("CT test INFEASIBLE\n");
-
-    if(rate_monotonic_least_upper_bound(numServices, ex0_period, ex0_wcet, ex0_period) == TRUE)
-        printf("RM LUB FEASIBLE\n");
-    else
-        printf("RM LUB INFEASIBLE\n");
-    printf("\n");
+typedef struct
+{
+    char *name;
+    U32_T numServices;
+    U32_T *period;
+    U32_T *wcet;
+} example_t;
 
-    printf("Ex-1 U=%4.2f\% (C1=1, C2=1, C3=2; T1=2, T2=5, T3=7; T=D): ", 
-		   ((1.0/2.0)*100.0 + (1.0/5.0)*100.0 + (2.0/7.0)*100.0));
-	numServices = 3;
-    if(completion_time_feasibility(numServices, ex1_period, ex1_wcet, ex1_period) == TRUE)
-        printf("FEASIBLE\n");
-    else
-        printf("INFEASIBLE\n");
-
-    if(rate_monotonic_least_upper_bound(numServices, ex1_period, ex1_wcet, ex1_period) == TRUE)
-        printf("RM LUB FEASIBLE\n");
-    else
-        printf("RM LUB INFEASIBLE\n");
-    printf("\n");
+example_t examples[] =
+{
+    {"Ex-0", 3, ex0_period, ex0_wcet},
+    {"Ex-1", 3, ex1_period, ex1_wcet},
+    {"Ex-2", 4, ex2_period, ex2_wcet},
+    {"Ex-3", 3, ex3_period, ex3_wcet},
+    {"Ex-4", 3, ex4_period, ex4_wcet}
+};
 
-	
-    printf("Ex-2 U=%4.2f\% (C1=1, C2=1, C3=1, C4=2; T1=2, T2=5, T3=7, T4=13; T=D): ",
-		   ((1.0/2.0)*100.0 + (1.0/5.0)*100.0 + (1.0/7.0)*100.0 + (2.0/13.0)*100.0));
-	numServices = 4;
-    if(completion_time_feasibility(numServices, ex2_period, ex2_wcet, ex2_period) == TRUE)
-        printf("FEASIBLE\n");
-    else
-        printf("INFEASIBLE\n");
-
-    if(rate_monotonic_least_upper_bound(numServices, ex2_period, ex2_wcet, ex2_period) == TRUE)
-        printf("RM LUB FEASIBLE\n");
-    else
-        printf("RM LUB INFEASIBLE\n");
-    printf("\n");
+#define NUM_EXAMPLES (sizeof(examples)/sizeof(examples[0]))
 
 
-    printf("Ex-3 U=%4.2f\% (C1=1, C2=2, C3=3; T1=3, T2=5, T3=15; T=D): ",
-		   ((1.0/3.0)*100.0 + (2.0/5.0)*100.0 + (3.0/15.0)*100.0));
-	numServices = 3;
-    if(completion_time_feasibility(numServices, ex3_period, ex3_wcet, ex3_period) == TRUE)
-        printf("FEASIBLE\n");
-    else
-        printf("INFEASIBLE\n");
+// e.g. Ex-0 U=73.33% (C1=1, C2=1, C3=2; T1=2, T2=10, T3=15; T=D):
+//
+void print_example(example_t *ex)
+{
+    double utility_sum=0.0;
+    U32_T idx;
 
-    if(rate_monotonic_least_upper_bound(numServices, ex3_period, ex3_wcet, ex3_period) == TRUE)
-        printf("RM LUB FEASIBLE\n");
-    else
-        printf("RM LUB INFEASIBLE\n");
-    printf("\n");
+    for(idx=0; idx < ex->numServices; idx++)
+        utility_sum += ((double)ex->wcet[idx]/(double)ex->period[idx])*100.0;
 
-	
-    printf("Ex-4 U=%4.2f\% (C1=1, C2=1, C3=4; T1=2, T2=4, T3=16; T=D): ",
-		   ((1.0/2.0)*100.0 + (1.0/4.0)*100.0 + (4.0/16.0)*100.0));
-	numServices = 3;
-    if(completion_time_feasibility(numServices, ex4_period, ex4_wcet, ex4_period) == TRUE)
-        printf("FEASIBLE\n");
-    else
-        printf("INFEASIBLE\n");
-
-    if(rate_monotonic_least_upper_bound(numServices, ex4_period, ex4_wcet, ex4_period) == TRUE)
-        printf("RM LUB FEASIBLE\n");
-    else
-        printf("RM LUB INFEASIBLE\n");
-    printf("\n");
+    printf("%s U=%4.2f%% (", ex->name, utility_sum);
+
+    for(idx=0; idx < ex->numServices; idx++)
+        printf("C%u=%u%s", idx+1, ex->wcet[idx], (idx < ex->numServices-1) ? ", " : "; ");
+
+    for(idx=0; idx < ex->numServices; idx++)
+        printf("T%u=%u%s", idx+1, ex->period[idx], (idx < ex->numServices-1) ? ", " : "; T=D): ");
+}
+
+
+// Print the services loaded from a file and the decision of every test
+//
+int file_feasibility(char *path)
+{
+    service_t *services=malloc(sizeof(service_t)*FILE_MAX_SERVICES);
+    U64_T *response=malloc(sizeof(U64_T)*FILE_MAX_SERVICES);
+    int numServices, idx;
+
+    if(!services || !response || ((numServices=load_service_set(path, services, FILE_MAX_SERVICES)) < 0))
+        return -1;
+
+    printf("%s: %d services, U=%4.2f%%\n", path, numServices, service_utilization(numServices, services)*100.0);
+    printf("prio       period         wcet     deadline     response  EDF max wcet\n");
+
+    rta_feasibility(numServices, services, response);
+
+    for(idx=0; idx < numServices; idx++)
+        printf("%4u %12llu %12llu %12llu %12llu  %12llu%s\n", services[idx].priority, services[idx].period,
+               services[idx].wcet, services[idx].deadline, response[idx],
+               edf_max_wcet(numServices, services, idx), response[idx] ? "" : " MISS");
+
+    printf("CT test %s\n", rta_feasibility(numServices, services, NULL) ? "FEASIBLE" : "INFEASIBLE");
+    printf("SP test %s\n", rta_scheduling_point_feasibility(numServices, services) ? "FEASIBLE" : "INFEASIBLE");
+    printf("RM LUB %s\n", lub_feasibility(numServices, services) ? "FEASIBLE" : "INFEASIBLE");
+    printf("EDF/LLF %s\n", edf_feasibility(numServices, services) ? "FEASIBLE" : "INFEASIBLE");
 
+    free(services);
+    free(response);
+    return 0;
+}
+
+
+int main(int argc, char *argv[])
+{ 
+    int i, nthreads=0;
+	U32_T numServices, numSets=BENCH_SETS;
+    double minDeadlineRatio=1.0;
+
+    // feasibility_tests bench [sets] [services] - integer RTA throughput
+    if((argc >= 2) && (strcmp(argv[1], "bench") == 0))
+    {
+        numServices=BENCH_SERVICES;
+        if(argc >= 3) sscanf(argv[2], "%u", &numSets);
+        if(argc >= 4) sscanf(argv[3], "%u", &numServices);
+
+        fast_rta_benchmark(numSets, numServices);
+        return 0;
+    }
+
+    // feasibility_tests batch [services] [sets per point] [threads] [min D/T] - acceptance ratio vs U
+    if((argc >= 2) && (strcmp(argv[1], "batch") == 0))
+    {
+        numServices=BENCH_SERVICES;
+        if(argc >= 3) sscanf(argv[2], "%u", &numServices);
+        if(argc >= 4) sscanf(argv[3], "%u", &numSets);
+        if(argc >= 5) sscanf(argv[4], "%d", &nthreads);
+        if(argc >= 6) sscanf(argv[5], "%lf", &minDeadlineRatio);
+
+        batch_feasibility(numServices, numSets, nthreads, minDeadlineRatio);
+        return 0;
+    }
+
+    // feasibility_tests file.csv|file.json ... - service sets from files
+    if(argc >= 2)
+    {
+        for(i=1; i < argc; i++)
+            if(file_feasibility(argv[i]) < 0)
+                return -1;
+        return 0;
+    }
+
+    printf("******** Completion Test Feasibility Example\n");
+
+    for(i=0; i < NUM_EXAMPLES; i++)
+    {
+        print_example(&examples[i]);
+
+        numServices = examples[i].numServices;
+        // only Ex-0 has ever been labelled with the test
+        if(completion_time_feasibility(numServices, examples[i].period, examples[i].wcet, examples[i].period) == TRUE)
+            printf("%sFEASIBLE\n", (i == 0) ? "CT test " : "");
+        else
+            printf("%sINFEASIBLE\n", (i == 0) ? "CT test " : "");
+
+        if(rate_monotonic_least_upper_bound(numServices, examples[i].period, examples[i].wcet, examples[i].period) == TRUE)
+            printf("RM LUB FEASIBLE\n");
+        else
+            printf("RM LUB INFEASIBLE\n");
+        printf("\n");
+    }
 
 
     printf("\n\n");
     printf("******** Scheduling Point Feasibility Example\n");
 
-    printf("Ex-0 U=%4.2f\% (C1=1, C2=1, C3=2; T1=2, T2=10, T3=15; T=D): ",
-		   ((1.0/2.0)*100.0 + (1.0/10.0)*100.0 + (2.0/15.0)*100.0));
-	numServices = 3;
-    if(scheduling_point_feasibility(numServices, ex0_period, ex0_wcet, ex0_period) == TRUE)
-        printf("FEASIBLE\n");
-    else
-        printf("INFEASIBLE\n");
-
-    if(rate_monotonic_least_upper_bound(numServices, ex0_period, ex0_wcet, ex0_period) == TRUE)
-        printf("RM LUB FEASIBLE\n");
-    else
-        printf("RM LUB INFEASIBLE\n");
-    printf("\n");
+    for(i=0; i < NUM_EXAMPLES; i++)
+    {
+        print_example(&examples[i]);
 
+        numServices = examples[i].numServices;
+        if(scheduling_point_feasibility(numServices, examples[i].period, examples[i].wcet, examples[i].period) == TRUE)
+            printf("FEASIBLE\n");
+        else
+            printf("INFEASIBLE\n");
 
-    printf("Ex-1 U=%4.2f\% (C1=1, C2=1, C3=2; T1=2, T2=5, T3=7; T=D): ", 
-		   ((1.0/2.0)*100.0 + (1.0/5.0)*100.0 + (2.0/7.0)*100.0));
-	numServices = 3;
-    if(scheduling_point_feasibility(numServices, ex1_period, ex1_wcet, ex1_period) == TRUE)
-        printf("FEASIBLE\n");
-    else
-        printf("INFEASIBLE\n");
+        if(rate_monotonic_least_upper_bound(numServices, examples[i].period, examples[i].wcet, examples[i].period) == TRUE)
+            printf("RM LUB FEASIBLE\n");
+        else
+            printf("RM LUB INFEASIBLE\n");
+        printf("\n");
+    }
+
+    fast_rta_examples();
+}
 
-    if(rate_monotonic_least_upper_bound(numServices, ex1_period, ex1_wcet, ex1_period) == TRUE)
-        printf("RM LUB FEASIBLE\n");
-    else
-        printf("RM LUB INFEASIBLE\n");
-    printf("\n");
 
-	
-    printf("Ex-2 U=%4.2f\% (C1=1, C2=1, C3=1, C4=2; T1=2, T2=5, T3=7, T4=13; T=D): ",
-		   ((1.0/2.0)*100.0 + (1.0/5.0)*100.0 + (1.0/7.0)*100.0 + (2.0/13.0)*100.0));
-	numServices = 4;
-    if(scheduling_point_feasibility(numServices, ex2_period, ex2_wcet, ex2_period) == TRUE)
-        printf("FEASIBLE\n");
-    else
-        printf("INFEASIBLE\n");
-
-    if(rate_monotonic_least_upper_bound(numServices, ex2_period, ex2_wcet, ex2_period) == TRUE)
-        printf("RM LUB FEASIBLE\n");
-    else
-        printf("RM LUB INFEASIBLE\n");
+void print_fast_rta(char *name, U32_T numServices, U32_T period[], U32_T wcet[])
+{
+    service_t services[8];
+    U64_T response[8];
+    U32_T idx;
+    int feasible;
+
+    for(idx=0; idx < numServices; idx++)
+    {
+        services[idx].period=period[idx];
+        services[idx].wcet=wcet[idx];
+        services[idx].deadline=period[idx];
+        services[idx].priority=idx;
+    }
+
+    feasible=rta_feasibility(numServices, services, response);
+    printf("%s U=%4.2f%%: RTA %s, SP %s, EDF %s, R=", name, service_utilization(numServices, services)*100.0,
+           feasible ? "FEASIBLE" : "INFEASIBLE",
+           rta_scheduling_point_feasibility(numServices, services) ? "FEASIBLE" : "INFEASIBLE",
+           edf_feasibility(numServices, services) ? "FEASIBLE" : "INFEASIBLE");
+
+    for(idx=0; idx < numServices; idx++)
+        printf("%llu ", response[idx]);
     printf("\n");
+}
 
 
-    printf("Ex-3 U=%4.2f\% (C1=1, C2=2, C3=3; T1=3, T2=5, T3=15; T=D): ",
-		   ((1.0/3.0)*100.0 + (2.0/5.0)*100.0 + (3.0/15.0)*100.0));
-	numServices = 3;
-    if(scheduling_point_feasibility(numServices, ex3_period, ex3_wcet, ex3_period) == TRUE)
-        printf("FEASIBLE\n");
-    else
-        printf("INFEASIBLE\n");
+void fast_rta_examples(void)
+{
+    int i;
 
-    if(rate_monotonic_least_upper_bound(numServices, ex3_period, ex3_wcet, ex3_period) == TRUE)
-        printf("RM LUB FEASIBLE\n");
-    else
-        printf("RM LUB INFEASIBLE\n");
-    printf("\n");
+    printf("\n\n");
+    printf("******** Integer Response Time Analysis Example (R=0 past first miss)\n");
 
-	
-    printf("Ex-4 U=%4.2f\% (C1=1, C2=1, C3=4; T1=2, T2=4, T3=16; T=D): ",
-		   ((1.0/2.0)*100.0 + (1.0/4.0)*100.0 + (4.0/16.0)*100.0));
-	numServices = 3;
-    if(scheduling_point_feasibility(numServices, ex4_period, ex4_wcet, ex4_period) == TRUE)
-        printf("FEASIBLE\n");
-    else
-        printf("INFEASIBLE\n");
+    for(i=0; i < NUM_EXAMPLES; i++)
+        print_fast_rta(examples[i].name, examples[i].numServices, examples[i].period, examples[i].wcet);
+}
 
 
-    if(rate_monotonic_least_upper_bound(numServices, ex4_period, ex4_wcet, ex4_period) == TRUE)
-        printf("RM LUB FEASIBLE\n");
-    else
-        printf("RM LUB INFEASIBLE\n");
-    printf("\n");
+static double elapsed_secs(struct timespec *start, struct timespec *stop)
+{
+    return (double)(stop->tv_sec - start->tv_sec) + (double)(stop->tv_nsec - start->tv_nsec)/1000000000.0;
+}
 
+
+// Service sets per second for the textbook CT test and the integer tests,
+// with every decision cross-checked against the CT test
+//
+void fast_rta_benchmark(U32_T numSets, U32_T numServices)
+{
+    service_t *sets=malloc(sizeof(service_t)*numSets*numServices);
+    U32_T *period=malloc(sizeof(U32_T)*numSets*numServices);
+    U32_T *wcet=malloc(sizeof(U32_T)*numSets*numServices);
+    int *ctResult=malloc(sizeof(int)*numSets);
+    struct timespec start, stop;
+    U32_T set, idx, feasible, disagree;
+    unsigned int seed=1;
+    double utilization, secs;
+
+    if(!sets || !period || !wcet || !ctResult)
+    {
+        perror("malloc");
+        exit(-1);
+    }
+
+    printf("%u UUniFast sets of %u services per utilization, sets/sec\n", numSets, numServices);
+    printf("   U  feasible      CT test        RTA   sched pt  disagree\n");
+
+    for(utilization=0.70; utilization < 0.995; utilization+=0.05)
+    {
+        for(set=0; set < numSets; set++)
+        {
+            uunifast_service_set(numServices, utilization, 1000ULL, 1000000ULL, &seed, &sets[set*numServices]);
+
+            for(idx=0; idx < numServices; idx++)
+            {
+                period[set*numServices+idx]=sets[set*numServices+idx].period;
+                wcet[set*numServices+idx]=sets[set*numServices+idx].wcet;
+            }
+        }
+
+        printf("%4.2f", utilization);
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for(set=0, feasible=0; set < numSets; set++)
+        {
+            ctResult[set]=completion_time_feasibility(numServices, &period[set*numServices],
+                                                      &wcet[set*numServices], &period[set*numServices]);
+            feasible+=ctResult[set];
+        }
+        clock_gettime(CLOCK_MONOTONIC, &stop);
+        secs=elapsed_secs(&start, &stop);
+        printf(" %9u %12.0lf", feasible, numSets/secs);
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for(set=0, disagree=0; set < numSets; set++)
+            if(rta_feasibility(numServices, &sets[set*numServices], NULL) != ctResult[set])
+                disagree++;
+        clock_gettime(CLOCK_MONOTONIC, &stop);
+        secs=elapsed_secs(&start, &stop);
+        printf(" %10.0lf", numSets/secs);
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for(set=0; set < numSets; set++)
+            if(rta_scheduling_point_feasibility(numServices, &sets[set*numServices]) != ctResult[set])
+                disagree++;
+        clock_gettime(CLOCK_MONOTONIC, &stop);
+        secs=elapsed_secs(&start, &stop);
+        printf(" %10.0lf %9u\n", numSets/secs, disagree);
+    }
+
+    free(sets);
+    free(period);
+    free(wcet);
+    free(ctResult);
 }
 
 
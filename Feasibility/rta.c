@@ -0,0 +1,270 @@
+// Integer response time analysis for large fixed priority service sets
+//
+// completion_time_feasibility() and scheduling_point_feasibility() in
+// feasibility_tests.c use floating point ceil()/floor() in their inner loops
+// and scheduling_point_feasibility() visits every multiple of every higher
+// priority period, O(n^2 * Tmax/Tmin).  Both are fine for hand examples, but
+// far too slow to screen generated sets of 100+ services.
+//
+// The same exact tests here:
+//
+// 1) use only integer math, ceil(a/b) = (a + b - 1)/b, in 64 bits so periods
+//    in nsec do not overflow
+// 2) exit as soon as the answer is known - U > 1 is infeasible and, with D=T,
+//    the hyperbolic bound prod(U(i)+1) <= 2 (Bini, Buttazzo and Buttazzo,
+//    2003, tighter than the RM LUB) is feasible without any iteration; the
+//    analysis stops at the first service to miss its deadline.  U and the
+//    product are rounded, so sets within UTILITY_EPSILON of either bound,
+//    such as U = 1 exactly, are always left to the analysis
+// 3) start the completion time iteration for service i at R(i-1) + C(i),
+//    which is never above R(i) for services in priority order (Sjodin and
+//    Hansson, 1998), rather than at sum(C(j)), and stop it once R > D
+// 4) search the scheduling points in increasing order, jumping straight to
+//    the first point at or above the demand W(t) just computed.  W(t) is
+//    non-decreasing, so every point skipped over would also have failed, and
+//    only a handful of the n*D/T points are ever evaluated.
+//
+
+#include <math.h>
+#include <stdlib.h>
+
+#include "feasibility.h"
+
+
+static U64_T ceil_div(U64_T a, U64_T b)
+{
+    return (a + b - 1) / b;
+}
+
+
+double service_utilization(U32_T numServices, service_t services[])
+{
+    double utility_sum=0.0;
+    U32_T idx;
+
+    for(idx=0; idx < numServices; idx++)
+        utility_sum += (double)services[idx].wcet / (double)services[idx].period;
+
+    return utility_sum;
+}
+
+
+// the bound assumes D=T, so a constrained deadline is never accepted by it
+//
+int lub_feasibility(U32_T numServices, service_t services[])
+{
+    U32_T idx;
+
+    for(idx=0; idx < numServices; idx++)
+        if(services[idx].deadline < services[idx].period)
+            return FALSE;
+
+    return service_utilization(numServices, services) <=
+           (double)numServices * (pow(2.0, 1.0/(double)numServices) - 1.0);
+}
+
+
+// Both exact tests divide by every period and are exact for C <= D <= T
+// only, so anything else is rejected before any analysis
+//
+static int valid_services(U32_T numServices, service_t services[])
+{
+    U32_T idx;
+
+    for(idx=0; idx < numServices; idx++)
+        if((services[idx].period == 0) || (services[idx].deadline > services[idx].period) ||
+           (services[idx].wcet > services[idx].deadline))
+            return FALSE;
+
+    return TRUE;
+}
+
+
+// returns TRUE when the set is decided without analysis, and sets *feasible
+//
+static int quick_decision(U32_T numServices, service_t services[], int *feasible)
+{
+    double utility_sum=0.0, hyperbolic=1.0, u;
+    int implicit_deadlines=TRUE;
+    U32_T idx;
+
+    for(idx=0; idx < numServices; idx++)
+    {
+        u = (double)services[idx].wcet / (double)services[idx].period;
+        utility_sum += u;
+        hyperbolic *= (u + 1.0);
+
+        if(services[idx].deadline != services[idx].period)
+            implicit_deadlines=FALSE;
+    }
+
+    if(utility_sum > 1.0 + UTILITY_EPSILON)
+    {
+        *feasible=FALSE;
+        return TRUE;
+    }
+
+    // sufficient only for rate monotonic priorities, i.e. periods in order
+    if(implicit_deadlines && (hyperbolic <= 2.0 - UTILITY_EPSILON))
+    {
+        for(idx=1; idx < numServices; idx++)
+            if(services[idx].period < services[idx-1].period)
+                return FALSE;
+
+        *feasible=TRUE;
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+
+int rta_feasibility(U32_T numServices, service_t services[], U64_T response[])
+{
+    U64_T an=0, anext, prev=0;
+    U32_T i, j;
+    int feasible;
+
+    if(response != NULL)
+        for(i=0; i < numServices; i++)
+            response[i]=0;
+
+    if(!valid_services(numServices, services))
+        return FALSE;
+
+    if(response == NULL && quick_decision(numServices, services, &feasible))
+        return feasible;
+
+    for(i=0; i < numServices; i++)
+    {
+        // R(i) >= R(i-1) + C(i) for services in priority order
+        an = prev + services[i].wcet;
+
+        while(an <= services[i].deadline)
+        {
+            anext = services[i].wcet;
+
+            for(j=0; j < i; j++)
+                anext += ceil_div(an, services[j].period) * services[j].wcet;
+
+            if(anext == an)
+                break;
+
+            an = anext;
+        }
+
+        if(an > services[i].deadline)
+            return FALSE;
+
+        if(response != NULL)
+            response[i]=an;
+
+        prev=an;
+    }
+
+    return TRUE;
+}
+
+
+// Demand of services 0...i in [0, t]
+//
+static U64_T workload(U32_T i, service_t services[], U64_T t)
+{
+    U64_T demand=0;
+    U32_T j;
+
+    for(j=0; j <= i; j++)
+        demand += ceil_div(t, services[j].period) * services[j].wcet;
+
+    return demand;
+}
+
+
+// Smallest scheduling point of service i at or above t - a multiple of a
+// higher priority period up to D(i), or D(i) itself - 0 if there is none
+//
+static U64_T next_point(U32_T i, service_t services[], U64_T t)
+{
+    U64_T point, best=services[i].deadline;
+    U32_T k;
+
+    if(t > best)
+        return 0;
+
+    for(k=0; k < i; k++)
+    {
+        point = ceil_div(t, services[k].period) * services[k].period;
+
+        if(point < best)
+            best=point;
+    }
+
+    return best;
+}
+
+
+int rta_scheduling_point_feasibility(U32_T numServices, service_t services[])
+{
+    U64_T t, demand, lower=0;
+    U32_T i;
+    int feasible;
+
+    if(!valid_services(numServices, services))
+        return FALSE;
+
+    if(quick_decision(numServices, services, &feasible))
+        return feasible;
+
+    for(i=0; i < numServices; i++)
+    {
+        // no point below R(i) can succeed, and R(i) is at least both the
+        // demand of one job of each service and the bound on R(i-1) + C(i)
+        lower += services[i].wcet;
+        demand = workload(i, services, 1);
+        if(demand > lower) lower=demand;
+
+        t = next_point(i, services, lower);
+
+        while(t != 0)
+        {
+            demand = workload(i, services, t);
+
+            if(demand <= t)
+                break;
+
+            // every point in [t, demand) fails too, so R(i) >= demand
+            lower = demand;
+            t = next_point(i, services, demand);
+        }
+
+        if(t == 0)
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+
+static int compare_deadline(const void *a, const void *b)
+{
+    const service_t *sa=(const service_t *)a, *sb=(const service_t *)b;
+
+    if(sa->deadline != sb->deadline)
+        return (sa->deadline < sb->deadline) ? -1 : 1;
+
+    if(sa->period != sb->period)
+        return (sa->period < sb->period) ? -1 : 1;
+
+    return 0;
+}
+
+
+void deadline_monotonic_order(U32_T numServices, service_t services[])
+{
+    U32_T idx;
+
+    qsort(services, numServices, sizeof(service_t), compare_deadline);
+
+    for(idx=0; idx < numServices; idx++)
+        services[idx].priority=idx;
+}
@@ -0,0 +1,280 @@
+// Service sets from files and from the UUniFast generator
+//
+// Files are CSV or JSON, one service per line or object:
+//
+//   # period, wcet, deadline, priority
+//   period,wcet,deadline,priority
+//   2,1,2,0
+//   10,1,10,1
+//
+//   [ {"period": 2, "wcet": 1, "deadline": 2, "priority": 0}, ... ]
+//
+// deadline defaults to the period and must be no more than it - the fixed
+// priority tests are exact for D <= T only - and period and wcet must be
+// non-zero with wcet <= deadline.  priority is 0 for the highest, as the
+// index order of the tests; if no service gives one, priorities are assigned
+// deadline monotonic (rate monotonic when D=T).  A JSON file is a list of
+// flat objects, optionally inside a wrapper object, and CSV is chosen unless
+// the first non-blank character is '[' or '{'.
+//
+// UUniFast (Bini and Buttazzo, "Measuring the performance of schedulability
+// tests", Real-Time Systems 30, 2005) draws n utilizations uniformly from the
+// simplex sum(U(i)) = U, so acceptance ratios are not biased by the generator.
+//
+
+#include <ctype.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "feasibility.h"
+
+
+static int compare_priority(const void *a, const void *b)
+{
+    const service_t *sa=(const service_t *)a, *sb=(const service_t *)b;
+
+    return (sa->priority < sb->priority) ? -1 : (sa->priority > sb->priority);
+}
+
+
+// Value of "key": in the text between start and end, returns TRUE if found
+//
+static int json_field(char *start, char *end, char *key, U64_T *value)
+{
+    char pattern[32], *found, saved=*end;
+
+    snprintf(pattern, sizeof(pattern), "\"%s\"", key);
+
+    *end='\0';
+    found=strstr(start, pattern);
+    *end=saved;
+
+    if((found == NULL) || (found >= end))
+        return FALSE;
+
+    found+=strlen(pattern);
+    while((found < end) && (isspace((unsigned char)*found) || (*found == ':')))
+        found++;
+
+    *value=strtoull(found, NULL, 10);
+    return TRUE;
+}
+
+
+static int parse_json(char *text, service_t services[], U32_T maxServices, int *havePriority)
+{
+    char *start=text, *end;
+    U64_T value;
+    U32_T count=0;
+
+    while(((start=strchr(start, '{')) != NULL) && ((end=strchr(start, '}')) != NULL))
+    {
+        if(count == maxServices)
+        {
+            printf("more than %u services, rest ignored\n", maxServices);
+            break;
+        }
+
+        if(!json_field(start, end, "period", &services[count].period) ||
+           !json_field(start, end, "wcet", &services[count].wcet))
+        {
+            start=end+1;
+            continue;
+        }
+
+        if(!json_field(start, end, "deadline", &services[count].deadline))
+            services[count].deadline=services[count].period;
+
+        if(json_field(start, end, "priority", &value))
+        {
+            services[count].priority=value;
+            *havePriority=TRUE;
+        }
+        else
+            services[count].priority=count;
+
+        count++;
+        start=end+1;
+    }
+
+    return count;
+}
+
+
+static int parse_csv(char *text, service_t services[], U32_T maxServices, int *havePriority)
+{
+    char *line, *save=NULL;
+    unsigned long long field[4];
+    U32_T count=0;
+    int nfields;
+
+    for(line=strtok_r(text, "\n", &save); line != NULL; line=strtok_r(NULL, "\n", &save))
+    {
+        while(isspace((unsigned char)*line)) line++;
+
+        // blank, comment or header line
+        if((*line == '\0') || (*line == '#') || isalpha((unsigned char)*line))
+            continue;
+
+        nfields=sscanf(line, "%llu ,%llu ,%llu ,%llu", &field[0], &field[1], &field[2], &field[3]);
+        if(nfields < 2)
+        {
+            printf("bad service line: %s\n", line);
+            return -1;
+        }
+
+        if(count == maxServices)
+        {
+            printf("more than %u services, rest ignored\n", maxServices);
+            break;
+        }
+
+        services[count].period=field[0];
+        services[count].wcet=field[1];
+        services[count].deadline=(nfields >= 3) ? field[2] : field[0];
+        services[count].priority=(nfields >= 4) ? field[3] : count;
+        if(nfields >= 4) *havePriority=TRUE;
+
+        count++;
+    }
+
+    return count;
+}
+
+
+// returns FALSE, with a message, for a service the tests cannot take
+//
+static int valid_service(char *path, U32_T idx, service_t *service)
+{
+    char *problem=NULL;
+
+    if(service->period == 0)
+        problem="period is 0";
+    else if(service->wcet == 0)
+        problem="wcet is 0";
+    else if(service->deadline > service->period)
+        problem="deadline is greater than the period";
+    else if(service->wcet > service->deadline)
+        problem="wcet is greater than the deadline";
+
+    if(problem != NULL)
+    {
+        printf("%s: service %u (T=%llu, C=%llu, D=%llu) %s\n", path, idx,
+               service->period, service->wcet, service->deadline, problem);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+
+// returns the number of services loaded, in priority order, or -1
+//
+int load_service_set(char *path, service_t services[], U32_T maxServices)
+{
+    FILE *fp;
+    char *text, *first;
+    long size;
+    int count, idx, havePriority=FALSE;
+
+    if((fp=fopen(path, "r")) == NULL)
+    {
+        perror(path);
+        return -1;
+    }
+
+    fseek(fp, 0, SEEK_END);
+    size=ftell(fp);
+    rewind(fp);
+
+    if((text=malloc(size+1)) == NULL)
+    {
+        fclose(fp);
+        return -1;
+    }
+
+    size=fread(text, 1, size, fp);
+    text[size]='\0';
+    fclose(fp);
+
+    for(first=text; isspace((unsigned char)*first); first++);
+
+    if((*first == '[') || (*first == '{'))
+        count=parse_json(text, services, maxServices, &havePriority);
+    else
+        count=parse_csv(text, services, maxServices, &havePriority);
+
+    free(text);
+
+    if(count <= 0)
+    {
+        if(count == 0) printf("%s: no services\n", path);
+        return -1;
+    }
+
+    for(idx=0; idx < count; idx++)
+        if(!valid_service(path, idx, &services[idx]))
+            return -1;
+
+    if(havePriority)
+        qsort(services, count, sizeof(service_t), compare_priority);
+    else
+        deadline_monotonic_order(count, services);
+
+    return count;
+}
+
+
+// UUniFast set of total utilization U, periods log-uniform in [minPeriod,
+// maxPeriod], D=T, rate monotonic order.  seed is for rand_r() so threads
+// can each generate their own sets.
+//
+void uunifast_service_set(U32_T numServices, double utilization, U64_T minPeriod, U64_T maxPeriod,
+                          unsigned int *seed, service_t services[])
+{
+    double sumU=utilization, nextU, u;
+    U32_T idx;
+
+    for(idx=0; idx < numServices; idx++)
+    {
+        if(idx < numServices-1)
+        {
+            nextU = sumU * pow((double)rand_r(seed) / ((double)RAND_MAX + 1.0), 1.0 / (double)(numServices-idx-1));
+            u = sumU - nextU;
+            sumU = nextU;
+        }
+        else
+            u = sumU;
+
+        services[idx].period = (U64_T)((double)minPeriod *
+                               pow((double)maxPeriod / (double)minPeriod, (double)rand_r(seed) / (double)RAND_MAX));
+        services[idx].wcet = (U64_T)(u * (double)services[idx].period + 0.5);
+        if(services[idx].wcet == 0) services[idx].wcet=1;
+        services[idx].deadline = services[idx].period;
+    }
+
+    deadline_monotonic_order(numServices, services);
+}
+
+
+void constrain_deadlines(U32_T numServices, service_t services[], double minRatio, unsigned int *seed)
+{
+    double ratio;
+    U32_T idx;
+
+    if(minRatio >= 1.0)
+        return;
+
+    for(idx=0; idx < numServices; idx++)
+    {
+        ratio = minRatio + (1.0 - minRatio) * (double)rand_r(seed) / (double)RAND_MAX;
+        services[idx].deadline = (U64_T)(ratio * (double)services[idx].period);
+
+        if(services[idx].deadline < services[idx].wcet)
+            services[idx].deadline = services[idx].wcet;
+    }
+
+    deadline_monotonic_order(numServices, services);
+}
@@ -0,0 +1,511 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "raidlib.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define RAID_X86_KERNELS
+#endif
+
+
+// RAID-6 P+Q dual parity
+//
+// P is the plain XOR parity used for RAID-5.  Q is a Reed-Solomon syndrome
+// over GF(2^8) with the polynomial x^8+x^4+x^3+x^2+1 (0x11d) and generator 2:
+//
+//     Q = g^0*D0 ^ g^1*D1 ^ ... ^ g^(n-1)*D(n-1)
+//
+// which is computed by Horner's rule, Q = (((D(n-1))*2 ^ D(n-2))*2 ^ ...) ^ D0,
+// so encoding only ever multiplies by 2.  That is a shift and a conditional
+// XOR with 0x1d per byte and vectorizes directly.
+//
+// Rebuild of lost data needs multiplies by arbitrary constants.  The scalar
+// code uses a 256 entry row of the multiply table; the AVX2 code splits each
+// byte into nibbles and uses two 16 entry PSHUFB lookups.
+//
+// A NULL data pointer is treated as a block of zeros, which is how rebuild
+// computes the partial syndromes over the surviving chunks.
+//
+// Chunk numbering for raid6Recover() is 0...n-1 for data, n for P, n+1 for Q.
+//
+
+#define GF_POLY (0x11d)
+
+static unsigned char gfExp[512];
+static unsigned char gfLog[256];
+static unsigned char gfMulTab[256][256];
+static pthread_once_t gfTablesOnce=PTHREAD_ONCE_INIT;
+
+
+static void gfBuildTables(void)
+{
+    int idx, jdx, val=1;
+
+    for(idx=0; idx<255; idx++)
+    {
+        gfExp[idx]=gfExp[idx+255]=val;
+        gfLog[val]=idx;
+        val<<=1;
+        if(val & 0x100) val^=GF_POLY;
+    }
+    gfExp[510]=gfExp[511]=gfExp[0];
+
+    for(idx=0; idx<256; idx++)
+        for(jdx=0; jdx<256; jdx++)
+            gfMulTab[idx][jdx]=(idx && jdx) ? gfExp[gfLog[idx]+gfLog[jdx]] : 0;
+}
+
+
+// the tables are built once, on first use from whichever thread gets there
+static void gfInitTables(void)
+{
+    pthread_once(&gfTablesOnce, gfBuildTables);
+}
+
+
+static unsigned char gfInv(unsigned char a)
+{
+    return gfExp[255-gfLog[a]];
+}
+
+
+// Scalar kernels - 64 bits at a time for Q generation, table lookup for the
+// constant multiplies in rebuild
+//
+
+static inline uint64_t gfMul2x8(uint64_t w)
+{
+    uint64_t hi=w & 0x8080808080808080ULL;
+
+    return ((w << 1) & 0xfefefefefefefefeULL) ^ ((hi >> 7) * 0x1d);
+}
+
+
+static void genPQByte(unsigned char **data, int ndata, unsigned char *P, unsigned char *Q,
+                      size_t offset, size_t len)
+{
+    size_t idx;
+    int src;
+    unsigned char p, q, d;
+
+    for(idx=offset; idx<len; idx++)
+    {
+        p=q=0;
+
+        for(src=ndata-1; src>=0; src--)
+        {
+            d=data[src] ? data[src][idx] : 0;
+            p^=d;
+            q=gfMulTab[2][q]^d;
+        }
+
+        P[idx]=p;
+        Q[idx]=q;
+    }
+}
+
+
+static void genPQScalar(unsigned char **data, int ndata, unsigned char *P, unsigned char *Q, size_t len)
+{
+    size_t idx;
+    int src;
+    uint64_t p, q, d;
+
+    for(idx=0; idx+8 <= len; idx+=8)
+    {
+        p=q=0;
+
+        for(src=ndata-1; src>=0; src--)
+        {
+            q=gfMul2x8(q);
+            if(data[src] == NULL) continue;
+            memcpy(&d, &data[src][idx], 8);
+            p^=d;
+            q^=d;
+        }
+
+        memcpy(&P[idx], &p, 8);
+        memcpy(&Q[idx], &q, 8);
+    }
+
+    genPQByte(data, ndata, P, Q, idx, len);
+}
+
+
+// Dx = A*Pxy ^ B*Qxy, Dy = Pxy ^ Dx where Pxy = P^DX, Qxy = Q^DY and DX, DY
+// hold the partial P and Q syndromes on entry and the rebuilt data on return
+//
+static void recov2Byte(unsigned char *P, unsigned char *Q, unsigned char *DX, unsigned char *DY,
+                       unsigned char A, unsigned char B, size_t offset, size_t len)
+{
+    size_t idx;
+    unsigned char pxy, dx;
+
+    for(idx=offset; idx<len; idx++)
+    {
+        pxy=P[idx]^DX[idx];
+        dx=gfMulTab[A][pxy]^gfMulTab[B][Q[idx]^DY[idx]];
+        DX[idx]=dx;
+        DY[idx]=pxy^dx;
+    }
+}
+
+
+static void recov2Scalar(unsigned char *P, unsigned char *Q, unsigned char *DX, unsigned char *DY,
+                         unsigned char A, unsigned char B, size_t len)
+{
+    recov2Byte(P, Q, DX, DY, A, B, 0, len);
+}
+
+
+// DST = C*(SRC^DST)
+//
+static void mulBlockByte(unsigned char *SRC, unsigned char *DST, unsigned char C,
+                         size_t offset, size_t len)
+{
+    size_t idx;
+    unsigned char *row=gfMulTab[C];
+
+    for(idx=offset; idx<len; idx++)
+        DST[idx]=row[SRC[idx]^DST[idx]];
+}
+
+
+static void mulBlockScalar(unsigned char *SRC, unsigned char *DST, unsigned char C, size_t len)
+{
+    mulBlockByte(SRC, DST, C, 0, len);
+}
+
+
+// DST ^= C*SRC
+//
+static void mulXorByte(unsigned char *SRC, unsigned char *DST, unsigned char C,
+                       size_t offset, size_t len)
+{
+    size_t idx;
+    unsigned char *row=gfMulTab[C];
+
+    for(idx=offset; idx<len; idx++)
+        DST[idx]^=row[SRC[idx]];
+}
+
+
+static void mulXorScalar(unsigned char *SRC, unsigned char *DST, unsigned char C, size_t len)
+{
+    mulXorByte(SRC, DST, C, 0, len);
+}
+
+
+#ifdef RAID_X86_KERNELS
+
+__attribute__((target("sse2")))
+static void genPQSSE2(unsigned char **data, int ndata, unsigned char *P, unsigned char *Q, size_t len)
+{
+    size_t idx;
+    int src;
+    __m128i p, q, d, mask;
+    const __m128i poly=_mm_set1_epi8(0x1d), zero=_mm_setzero_si128();
+
+    for(idx=0; idx+16 <= len; idx+=16)
+    {
+        p=q=zero;
+
+        for(src=ndata-1; src>=0; src--)
+        {
+            // multiply by 2 - bytes with the top bit set are negative
+            mask=_mm_cmpgt_epi8(zero, q);
+            q=_mm_xor_si128(_mm_add_epi8(q, q), _mm_and_si128(mask, poly));
+
+            if(data[src] == NULL) continue;
+            d=_mm_loadu_si128((__m128i *)&data[src][idx]);
+            p=_mm_xor_si128(p, d);
+            q=_mm_xor_si128(q, d);
+        }
+
+        _mm_storeu_si128((__m128i *)&P[idx], p);
+        _mm_storeu_si128((__m128i *)&Q[idx], q);
+    }
+
+    genPQByte(data, ndata, P, Q, idx, len);
+}
+
+
+__attribute__((target("avx2")))
+static void genPQAVX2(unsigned char **data, int ndata, unsigned char *P, unsigned char *Q, size_t len)
+{
+    size_t idx;
+    int src;
+    __m256i p, q, d, mask;
+    const __m256i poly=_mm256_set1_epi8(0x1d), zero=_mm256_setzero_si256();
+
+    for(idx=0; idx+32 <= len; idx+=32)
+    {
+        p=q=zero;
+
+        for(src=ndata-1; src>=0; src--)
+        {
+            mask=_mm256_cmpgt_epi8(zero, q);
+            q=_mm256_xor_si256(_mm256_add_epi8(q, q), _mm256_and_si256(mask, poly));
+
+            if(data[src] == NULL) continue;
+            d=_mm256_loadu_si256((__m256i *)&data[src][idx]);
+            p=_mm256_xor_si256(p, d);
+            q=_mm256_xor_si256(q, d);
+        }
+
+        _mm256_storeu_si256((__m256i *)&P[idx], p);
+        _mm256_storeu_si256((__m256i *)&Q[idx], q);
+    }
+
+    _mm256_zeroupper();
+
+    genPQByte(data, ndata, P, Q, idx, len);
+}
+
+
+// Split-nibble multiply tables for constant C, repeated in both 128 bit lanes
+// because VPSHUFB does not cross lanes
+//
+__attribute__((target("avx2")))
+static void gfNibbleTables(unsigned char C, __m256i *lo, __m256i *hi)
+{
+    unsigned char tlo[16], thi[16];
+    int idx;
+
+    for(idx=0; idx<16; idx++)
+    {
+        tlo[idx]=gfMulTab[C][idx];
+        thi[idx]=gfMulTab[C][idx << 4];
+    }
+
+    *lo=_mm256_broadcastsi128_si256(_mm_loadu_si128((__m128i *)tlo));
+    *hi=_mm256_broadcastsi128_si256(_mm_loadu_si128((__m128i *)thi));
+}
+
+
+__attribute__((target("avx2")))
+static inline __m256i gfMulAVX2(__m256i x, __m256i lo, __m256i hi)
+{
+    const __m256i nibble=_mm256_set1_epi8(0x0f);
+
+    return _mm256_xor_si256(_mm256_shuffle_epi8(lo, _mm256_and_si256(x, nibble)),
+                            _mm256_shuffle_epi8(hi, _mm256_and_si256(_mm256_srli_epi64(x, 4), nibble)));
+}
+
+
+__attribute__((target("avx2")))
+static void recov2AVX2(unsigned char *P, unsigned char *Q, unsigned char *DX, unsigned char *DY,
+                       unsigned char A, unsigned char B, size_t len)
+{
+    size_t idx;
+    __m256i alo, ahi, blo, bhi, pxy, qxy, dx;
+
+    gfNibbleTables(A, &alo, &ahi);
+    gfNibbleTables(B, &blo, &bhi);
+
+    for(idx=0; idx+32 <= len; idx+=32)
+    {
+        pxy=_mm256_xor_si256(_mm256_loadu_si256((__m256i *)&P[idx]), _mm256_loadu_si256((__m256i *)&DX[idx]));
+        qxy=_mm256_xor_si256(_mm256_loadu_si256((__m256i *)&Q[idx]), _mm256_loadu_si256((__m256i *)&DY[idx]));
+        dx=_mm256_xor_si256(gfMulAVX2(pxy, alo, ahi), gfMulAVX2(qxy, blo, bhi));
+
+        _mm256_storeu_si256((__m256i *)&DX[idx], dx);
+        _mm256_storeu_si256((__m256i *)&DY[idx], _mm256_xor_si256(pxy, dx));
+    }
+
+    _mm256_zeroupper();
+
+    recov2Byte(P, Q, DX, DY, A, B, idx, len);
+}
+
+
+__attribute__((target("avx2")))
+static void mulBlockAVX2(unsigned char *SRC, unsigned char *DST, unsigned char C, size_t len)
+{
+    size_t idx;
+    __m256i clo, chi, x;
+
+    gfNibbleTables(C, &clo, &chi);
+
+    for(idx=0; idx+32 <= len; idx+=32)
+    {
+        x=_mm256_xor_si256(_mm256_loadu_si256((__m256i *)&SRC[idx]), _mm256_loadu_si256((__m256i *)&DST[idx]));
+        _mm256_storeu_si256((__m256i *)&DST[idx], gfMulAVX2(x, clo, chi));
+    }
+
+    _mm256_zeroupper();
+
+    mulBlockByte(SRC, DST, C, idx, len);
+}
+
+
+__attribute__((target("avx2")))
+static void mulXorAVX2(unsigned char *SRC, unsigned char *DST, unsigned char C, size_t len)
+{
+    size_t idx;
+    __m256i clo, chi, x;
+
+    gfNibbleTables(C, &clo, &chi);
+
+    for(idx=0; idx+32 <= len; idx+=32)
+    {
+        x=gfMulAVX2(_mm256_loadu_si256((__m256i *)&SRC[idx]), clo, chi);
+        _mm256_storeu_si256((__m256i *)&DST[idx], _mm256_xor_si256(x, _mm256_loadu_si256((__m256i *)&DST[idx])));
+    }
+
+    _mm256_zeroupper();
+
+    mulXorByte(SRC, DST, C, idx, len);
+}
+
+#endif
+
+
+typedef void (*genPQFunc_t)(unsigned char **data, int ndata, unsigned char *P, unsigned char *Q, size_t len);
+typedef void (*recov2Func_t)(unsigned char *P, unsigned char *Q, unsigned char *DX, unsigned char *DY,
+                             unsigned char A, unsigned char B, size_t len);
+typedef void (*mulBlockFunc_t)(unsigned char *SRC, unsigned char *DST, unsigned char C, size_t len);
+
+// Indexed by RAID_KERNEL_*, the widest Q code is AVX2 since AVX-512F alone has
+// no byte compare or shuffle, and SSE2 has no PSHUFB for the rebuild multiply
+//
+#ifdef RAID_X86_KERNELS
+static const genPQFunc_t genPQFuncs[RAID_KERNEL_COUNT] = {genPQScalar, genPQSSE2, genPQAVX2, genPQAVX2};
+static const recov2Func_t recov2Funcs[RAID_KERNEL_COUNT] = {recov2Scalar, recov2Scalar, recov2AVX2, recov2AVX2};
+static const mulBlockFunc_t mulBlockFuncs[RAID_KERNEL_COUNT] = {mulBlockScalar, mulBlockScalar, mulBlockAVX2, mulBlockAVX2};
+static const mulBlockFunc_t mulXorFuncs[RAID_KERNEL_COUNT] = {mulXorScalar, mulXorScalar, mulXorAVX2, mulXorAVX2};
+#else
+static const genPQFunc_t genPQFuncs[RAID_KERNEL_COUNT] = {genPQScalar, NULL, NULL, NULL};
+static const recov2Func_t recov2Funcs[RAID_KERNEL_COUNT] = {recov2Scalar, NULL, NULL, NULL};
+static const mulBlockFunc_t mulBlockFuncs[RAID_KERNEL_COUNT] = {mulBlockScalar, NULL, NULL, NULL};
+static const mulBlockFunc_t mulXorFuncs[RAID_KERNEL_COUNT] = {mulXorScalar, NULL, NULL, NULL};
+#endif
+
+
+// Compute P and Q over ndata blocks of len bytes with a specific kernel,
+// used by raid_perftest to compare them
+//
+int raid6GenPQKernel(int kernel, unsigned char **data, int ndata,
+                     unsigned char *P, unsigned char *Q, size_t len)
+{
+    if(!raidKernelSupported(kernel))
+        return ERROR;
+
+    gfInitTables();
+    (*genPQFuncs[kernel])(data, ndata, P, Q, len);
+
+    return OK;
+}
+
+
+void raid6GenPQ(unsigned char **data, int ndata, unsigned char *P, unsigned char *Q, size_t len)
+{
+    raid6GenPQKernel(raidSelectedKernel(), data, ndata, P, Q, len);
+}
+
+
+// Rebuild up to two lost chunks in place.  chunks[] holds ndata data blocks
+// then P then Q, each len bytes, and the blocks for failA and failB (-1 for
+// none) are overwritten with the recovered contents.
+//
+// returns OK or ERROR for bad chunk numbers
+//
+int raid6RecoverKernel(int kernel, unsigned char **chunks, int ndata, size_t len, int failA, int failB)
+{
+    unsigned char *data[RAID_MAX_DATA_CHUNKS];
+    unsigned char *P=chunks[ndata], *Q=chunks[ndata+1];
+    unsigned char A, B, gxy;
+    int tmp, idx;
+
+    if(!raidKernelSupported(kernel) || (ndata > RAID_MAX_DATA_CHUNKS))
+        return ERROR;
+
+    gfInitTables();
+
+    if(failA > failB)
+    {
+        tmp=failA; failA=failB; failB=tmp;
+    }
+
+    if((failA < -1) || (failB > ndata+1) || ((failA == failB) && (failA != -1)))
+        return ERROR;
+
+    // failA < failB from here, failA may be -1
+    if(failB < 0)
+        return OK;
+
+    for(idx=0; idx<ndata; idx++)
+        data[idx]=chunks[idx];
+
+    // P and/or Q lost with all the data intact - just re-encode
+    if(failA >= ndata || ((failA < 0) && (failB >= ndata)))
+    {
+        (*genPQFuncs[kernel])(data, ndata, P, Q, len);
+        return OK;
+    }
+
+    // one data chunk lost, with or without Q - rebuild it from P as RAID-5
+    // does, then re-encode in case Q went with it
+    if((failB < ndata && failA < 0) || (failB == ndata+1))
+    {
+        tmp=(failA < 0) ? failB : failA;
+        data[tmp]=P;
+        xorBlocksKernel(kernel, data, ndata, chunks[tmp], len);
+
+        if(failB == ndata+1)
+        {
+            data[tmp]=chunks[tmp];
+            (*genPQFuncs[kernel])(data, ndata, P, Q, len);
+        }
+        return OK;
+    }
+
+    // data chunk and P lost - Q' over the surviving data goes into the lost
+    // chunk, then Dx = g^-x * (Q ^ Q'), then re-encode P
+    if(failB == ndata)
+    {
+        data[failA]=NULL;
+        (*genPQFuncs[kernel])(data, ndata, P, chunks[failA], len);
+        (*mulBlockFuncs[kernel])(Q, chunks[failA], gfInv(gfExp[failA]), len);
+
+        data[failA]=chunks[failA];
+        xorBlocksKernel(kernel, data, ndata, P, len);
+        return OK;
+    }
+
+    // two data chunks x < y lost - partial syndromes P' and Q' go into the two
+    // lost chunks, then with Pxy = P^P' and Qxy = Q^Q',
+    //
+    //     Dx = g^y/(g^x^g^y) * Pxy ^ 1/(g^x^g^y) * Qxy,  Dy = Pxy ^ Dx
+    //
+    data[failA]=data[failB]=NULL;
+    (*genPQFuncs[kernel])(data, ndata, chunks[failA], chunks[failB], len);
+
+    gxy=gfInv(gfExp[failA]^gfExp[failB]);
+    A=gfMulTab[gfExp[failB]][gxy];
+    B=gxy;
+    (*recov2Funcs[kernel])(P, Q, chunks[failA], chunks[failB], A, B, len);
+
+    return OK;
+}
+
+
+int raid6Recover(unsigned char **chunks, int ndata, size_t len, int failA, int failB)
+{
+    return raid6RecoverKernel(raidSelectedKernel(), chunks, ndata, len, failA, failB);
+}
+
+
+// Fold a change to data chunk dataIdx into Q without reading the other data
+// chunks - delta is old data XOR new data, and Q ^= g^dataIdx * delta
+//
+void raid6UpdateQ(unsigned char *Q, unsigned char *delta, int dataIdx, size_t len)
+{
+    int kernel=raidSelectedKernel();
+
+    gfInitTables();
+    (*mulXorFuncs[kernel])(delta, Q, gfExp[dataIdx], len);
+}
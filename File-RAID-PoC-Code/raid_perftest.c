@@ -1,5 +1,212 @@
 #include "raidtest.h"
 
+// Size of each data block for the per-kernel throughput test, large enough
+// that loop overhead is negligible but small enough to stay in L2/L3
+#define KERNEL_TEST_BYTES (256*1024)
+#define KERNEL_TEST_BLOCKS (4)
+
+
+double elapsedSecs(struct timeval *StartTime, struct timeval *StopTime)
+{
+    return ((double)(StopTime->tv_sec - StartTime->tv_sec)) +
+           (((double)(StopTime->tv_usec - StartTime->tv_usec))/1000000.0);
+}
+
+
+// TEST CASE #2
+//
+// Runs the 4+1 XOR parity encode with each kernel variant this CPU supports
+// and reports data throughput in GB/s, so the speedup can be confirmed on each
+// host class.  Output of every kernel is checked against the scalar one.
+//
+void kernelPerfTest(int numTestIterations)
+{
+    unsigned char *blocks[KERNEL_TEST_BLOCKS];
+    unsigned char *parity, *checkParity;
+    struct timeval StartTime, StopTime;
+    int idx, kernel;
+    double secs, gbytes;
+
+    for(idx=0; idx<KERNEL_TEST_BLOCKS; idx++)
+    {
+        blocks[idx]=malloc(KERNEL_TEST_BYTES);
+        assert(blocks[idx] != NULL);
+        memset(blocks[idx], (idx+1)*17, KERNEL_TEST_BYTES);
+        memcpy(blocks[idx], TEST_RAID_STRING, SECTOR_SIZE);
+    }
+    parity=malloc(KERNEL_TEST_BYTES);
+    checkParity=malloc(KERNEL_TEST_BYTES);
+    assert((parity != NULL) && (checkParity != NULL));
+
+    xorBlocksKernel(RAID_KERNEL_SCALAR, blocks, KERNEL_TEST_BLOCKS, checkParity, KERNEL_TEST_BYTES);
+
+    printf("\nRAID Parity Kernel Throughput Test (%d x %d KB blocks, %d iterations)\n",
+           KERNEL_TEST_BLOCKS, KERNEL_TEST_BYTES/1024, numTestIterations);
+    printf("Auto-selected kernel is %s\n", raidKernelName(RAID_KERNEL_AUTO));
+
+    for(kernel=0; kernel<RAID_KERNEL_COUNT; kernel++)
+    {
+        if(!raidKernelSupported(kernel))
+        {
+            printf("%-8s not supported on this CPU\n", raidKernelName(kernel));
+            continue;
+        }
+
+        gettimeofday(&StartTime, 0);
+
+        for(idx=0; idx<numTestIterations; idx++)
+            xorBlocksKernel(kernel, blocks, KERNEL_TEST_BLOCKS, parity, KERNEL_TEST_BYTES);
+
+        gettimeofday(&StopTime, 0);
+
+        assert(memcmp(parity, checkParity, KERNEL_TEST_BYTES) == 0);
+
+        secs=elapsedSecs(&StartTime, &StopTime);
+        gbytes=((double)numTestIterations*KERNEL_TEST_BLOCKS*KERNEL_TEST_BYTES)/1.0e9;
+        printf("%-8s %lf GB/s of data encoded\n", raidKernelName(kernel), gbytes/secs);
+    }
+
+    for(idx=0; idx<KERNEL_TEST_BLOCKS; idx++) free(blocks[idx]);
+    free(parity);
+    free(checkParity);
+}
+
+
+// TEST CASE #3
+//
+// RAID-6 cost against plain XOR - for each kernel variant, time P only (XOR),
+// P+Q generation and rebuild of two lost data blocks, all over the same
+// KERNEL_TEST_BLOCKS data blocks.  Each rebuild is checked against the data.
+//
+void raid6PerfTest(int numTestIterations)
+{
+    unsigned char *chunks[KERNEL_TEST_BLOCKS+2], *saved[2];
+    struct timeval StartTime, StopTime;
+    int idx, kernel;
+    double gbytes, xorRate, pqRate, recovRate;
+
+    for(idx=0; idx<KERNEL_TEST_BLOCKS+2; idx++)
+    {
+        chunks[idx]=malloc(KERNEL_TEST_BYTES);
+        assert(chunks[idx] != NULL);
+        memset(chunks[idx], (idx+1)*37, KERNEL_TEST_BYTES);
+        if(idx < KERNEL_TEST_BLOCKS) memcpy(&chunks[idx][idx*SECTOR_SIZE], TEST_RAID_STRING, SECTOR_SIZE);
+    }
+    for(idx=0; idx<2; idx++)
+    {
+        saved[idx]=malloc(KERNEL_TEST_BYTES);
+        assert(saved[idx] != NULL);
+        memcpy(saved[idx], chunks[idx], KERNEL_TEST_BYTES);
+    }
+
+    gbytes=((double)numTestIterations*KERNEL_TEST_BLOCKS*KERNEL_TEST_BYTES)/1.0e9;
+
+    printf("\nRAID-6 P+Q Throughput Test (%d x %d KB blocks, %d iterations, GB/s of data)\n",
+           KERNEL_TEST_BLOCKS, KERNEL_TEST_BYTES/1024, numTestIterations);
+    printf("%-8s %12s %12s %12s\n", "kernel", "XOR P", "P+Q", "2 data lost");
+
+    for(kernel=0; kernel<RAID_KERNEL_COUNT; kernel++)
+    {
+        if(!raidKernelSupported(kernel))
+        {
+            printf("%-8s not supported on this CPU\n", raidKernelName(kernel));
+            continue;
+        }
+
+        gettimeofday(&StartTime, 0);
+        for(idx=0; idx<numTestIterations; idx++)
+            xorBlocksKernel(kernel, chunks, KERNEL_TEST_BLOCKS, chunks[KERNEL_TEST_BLOCKS], KERNEL_TEST_BYTES);
+        gettimeofday(&StopTime, 0);
+        xorRate=gbytes/elapsedSecs(&StartTime, &StopTime);
+
+        gettimeofday(&StartTime, 0);
+        for(idx=0; idx<numTestIterations; idx++)
+            raid6GenPQKernel(kernel, chunks, KERNEL_TEST_BLOCKS, chunks[KERNEL_TEST_BLOCKS],
+                             chunks[KERNEL_TEST_BLOCKS+1], KERNEL_TEST_BYTES);
+        gettimeofday(&StopTime, 0);
+        pqRate=gbytes/elapsedSecs(&StartTime, &StopTime);
+
+        // lose data blocks 0 and 1 every time
+        gettimeofday(&StartTime, 0);
+        for(idx=0; idx<numTestIterations; idx++)
+            raid6RecoverKernel(kernel, chunks, KERNEL_TEST_BLOCKS, KERNEL_TEST_BYTES, 0, 1);
+        gettimeofday(&StopTime, 0);
+        recovRate=gbytes/elapsedSecs(&StartTime, &StopTime);
+
+        assert(memcmp(chunks[0], saved[0], KERNEL_TEST_BYTES) == 0);
+        assert(memcmp(chunks[1], saved[1], KERNEL_TEST_BYTES) == 0);
+
+        printf("%-8s %12lf %12lf %12lf\n", raidKernelName(kernel), xorRate, pqRate, recovRate);
+    }
+
+    for(idx=0; idx<KERNEL_TEST_BLOCKS+2; idx++) free(chunks[idx]);
+    free(saved[0]);
+    free(saved[1]);
+}
+
+
+// TEST CASE #4
+//
+// Parallel parity scaling - encode a batch of 4+1 stripes with 64 KB chunks
+// numTestIterations times on 1...maxThreads pinned worker threads and report
+// GB/s and speedup over one thread.  Parity from every run is checked
+// against the single thread result.
+//
+#define THREAD_TEST_STRIPES (256)
+#define THREAD_TEST_CHUNK (64*1024)
+
+void threadPerfTest(int numTestIterations, int maxThreads)
+{
+    stripeGeom_t geom;
+    parityPool_t *pool;
+    unsigned char *stripes, *checkStripes;
+    struct timeval StartTime, StopTime;
+    size_t batchBytes;
+    int idx, nthreads;
+    double gbytes, rate, baseRate=0.0;
+
+    stripeGeomInit(&geom, 4, THREAD_TEST_CHUNK);
+    batchBytes=(size_t)THREAD_TEST_STRIPES*(geom.dataChunks+geom.parityChunks)*geom.chunkSize;
+
+    stripes=malloc(batchBytes);
+    checkStripes=malloc(batchBytes);
+    assert((stripes != NULL) && (checkStripes != NULL));
+
+    for(idx=0; idx < batchBytes; idx++)
+        stripes[idx]=TEST_RAID_STRING[idx % SECTOR_SIZE] ^ (idx >> 12);
+
+    stripeEncodeBatch(&geom, stripes, THREAD_TEST_STRIPES, 1);
+    memcpy(checkStripes, stripes, batchBytes);
+
+    gbytes=((double)numTestIterations*THREAD_TEST_STRIPES*geom.dataChunks*geom.chunkSize)/1.0e9;
+
+    printf("\nParallel Parity Scaling Test (%d stripes of 4 x %d KB, %d iterations, %s kernel)\n",
+           THREAD_TEST_STRIPES, THREAD_TEST_CHUNK/1024, numTestIterations, raidKernelName(RAID_KERNEL_AUTO));
+    printf("%8s %12s %10s\n", "threads", "GB/s", "speedup");
+
+    for(nthreads=1; nthreads <= maxThreads; nthreads++)
+    {
+        pool=parityPoolCreate(nthreads);
+        assert(pool != NULL);
+
+        gettimeofday(&StartTime, 0);
+        for(idx=0; idx<numTestIterations; idx++)
+            parityPoolEncode(pool, &geom, stripes, THREAD_TEST_STRIPES);
+        gettimeofday(&StopTime, 0);
+
+        parityPoolDestroy(pool);
+
+        assert(memcmp(stripes, checkStripes, batchBytes) == 0);
+
+        rate=gbytes/elapsedSecs(&StartTime, &StopTime);
+        if(nthreads == 1) baseRate=rate;
+
+        printf("%8d %12lf %10.2lf\n", nthreads, rate, rate/baseRate);
+    }
+
+    free(stripes);
+    free(checkStripes);
+}
 
 
 int main(int argc, char *argv[])
@@ -22,6 +229,30 @@ int main(int argc, char *argv[])
        	    printf("Will start %d test iterations\n", numTestIterations);
         }
 
+        // raid_perftest <iterations> kernels - compare all parity kernel variants
+        if((argc >= 3) && (strcmp(argv[2], "kernels") == 0))
+        {
+            kernelPerfTest(numTestIterations);
+            exit(0);
+        }
+
+        // raid_perftest <iterations> raid6 - P+Q encode and rebuild cost vs XOR
+        if((argc >= 3) && (strcmp(argv[2], "raid6") == 0))
+        {
+            raid6PerfTest(numTestIterations);
+            exit(0);
+        }
+
+        // raid_perftest <iterations> threads <max threads> - parity scaling table
+        if((argc >= 3) && (strcmp(argv[2], "threads") == 0))
+        {
+            int maxThreads=sysconf(_SC_NPROCESSORS_ONLN);
+
+            if(argc >= 4) sscanf(argv[3], "%d", &maxThreads);
+            threadPerfTest(numTestIterations, maxThreads);
+            exit(0);
+        }
+
 
         // Set all test buffers
 	for(idx=0;idx<MAX_LBAS;idx++)
@@ -0,0 +1,752 @@
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+
+#ifdef __NR_io_uring_setup
+#include <linux/io_uring.h>
+#define RAID_HAVE_URING
+#endif
+
+#include "raidlib.h"
+
+
+// Asynchronous stripe and restore engines
+//
+// The synchronous stripeFileGeom() reads one stripe, computes parity, then
+// writes each chunk file in turn, so the disks and the parity kernel are never
+// busy at the same time.  These engines keep up to depth stripes in flight in
+// a ring of stripe buffers, so while stripe k is being written to all of the
+// chunk files at once, stripe k+1 is having its parity computed and stripe
+// k+2 is being read.
+//
+// Two engines produce identical chunk files to the synchronous code:
+//
+// 1) io_uring - all reads and writes are submitted to one ring with pread/
+//    pwrite style offsets and the calling thread computes parity as each read
+//    completes.  Uses the raw system calls so no liburing is needed.
+//
+// 2) POSIX threads - used when io_uring is not available (older kernels or
+//    seccomp filtered), when the ring sets up but the kernel predates
+//    IORING_OP_READ/WRITE and fails them with -EINVAL, or when asked for.  One thread per chunk file does its I/O
+//    for every stripe in order, and the calling thread does the other side.
+//
+// Slot state for both engines
+//
+#define SLOT_FREE (0)
+#define SLOT_READING (1)
+#define SLOT_READ (2)
+#define SLOT_WRITING (3)
+
+typedef struct
+{
+    unsigned char *buffer;
+    unsigned char *chunks[RAID_MAX_DATA_CHUNKS+2];
+    long long stripe;
+    int state;
+    int pending;
+    size_t want;                              // input/output bytes for this stripe
+    size_t done[RAID_MAX_DATA_CHUNKS+2];      // bytes done per chunk, or [0] for input/output
+} asyncSlot_t;
+
+typedef struct
+{
+    stripeGeom_t *geom;
+    int nchunks;
+    int depth;
+    size_t stripeBytes;
+    long long nstripes;
+    long long fileLength;
+    int missingChunk, missingChunk2;
+    int fd[RAID_MAX_DATA_CHUNKS+2];
+    int fdfile;                               // input for stripe, output for restore
+    asyncSlot_t *slots;
+} asyncJob_t;
+
+
+static int asyncJobInit(asyncJob_t *job, stripeGeom_t *geom, int depth)
+{
+    int idx, chunk;
+
+    if(depth < 1) depth=RAID_ASYNC_DEPTH;
+
+    job->geom=geom;
+    job->nchunks=geom->dataChunks+geom->parityChunks;
+    job->depth=depth;
+    job->stripeBytes=(size_t)geom->dataChunks*geom->chunkSize;
+
+    if((job->slots=calloc(depth, sizeof(asyncSlot_t))) == NULL)
+        return ERROR;
+
+    // page aligned so the buffers could also be used with O_DIRECT
+    for(idx=0; idx<depth; idx++)
+    {
+        if(posix_memalign((void **)&job->slots[idx].buffer, 4096,
+                          (size_t)job->nchunks*geom->chunkSize) != 0)
+        {
+            while(idx-- > 0) free(job->slots[idx].buffer);
+            free(job->slots);
+            return ERROR;
+        }
+
+        for(chunk=0; chunk<job->nchunks; chunk++)
+            job->slots[idx].chunks[chunk]=&job->slots[idx].buffer[(size_t)chunk*geom->chunkSize];
+    }
+
+    return OK;
+}
+
+
+static void asyncJobFree(asyncJob_t *job)
+{
+    int idx;
+
+    for(idx=0; idx<job->depth; idx++)
+        free(job->slots[idx].buffer);
+
+    free(job->slots);
+}
+
+
+// Bytes of the input file held by a stripe - all but the last are full
+//
+static size_t asyncStripeBytes(asyncJob_t *job, long long stripe)
+{
+    long long remaining=job->fileLength-stripe*(long long)job->stripeBytes;
+
+    return (remaining < (long long)job->stripeBytes) ? (size_t)remaining : job->stripeBytes;
+}
+
+
+#ifdef RAID_HAVE_URING
+
+// Minimal io_uring wrapper over the raw system calls
+//
+typedef struct
+{
+    int fd;
+    unsigned *sqHead, *sqTail, *sqMask, *sqArray;
+    unsigned *cqHead, *cqTail, *cqMask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    void *sqRing, *cqRing;
+    size_t sqRingLen, cqRingLen, sqesLen;
+    unsigned entries;
+    unsigned toSubmit;
+    unsigned inflight;                        // queued and not yet reaped
+} uring_t;
+
+
+static int uringInit(uring_t *ring, unsigned entries)
+{
+    struct io_uring_params params;
+
+    memset(&params, 0, sizeof(params));
+    memset(ring, 0, sizeof(uring_t));
+
+    if((ring->fd=syscall(__NR_io_uring_setup, entries, &params)) < 0)
+        return ERROR;
+
+    ring->entries=params.sq_entries;
+    ring->sqRingLen=params.sq_off.array + params.sq_entries*sizeof(unsigned);
+    ring->cqRingLen=params.cq_off.cqes + params.cq_entries*sizeof(struct io_uring_cqe);
+    ring->sqesLen=params.sq_entries*sizeof(struct io_uring_sqe);
+
+    ring->sqRing=mmap(NULL, ring->sqRingLen, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      ring->fd, IORING_OFF_SQ_RING);
+    ring->cqRing=mmap(NULL, ring->cqRingLen, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      ring->fd, IORING_OFF_CQ_RING);
+    ring->sqes=mmap(NULL, ring->sqesLen, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                    ring->fd, IORING_OFF_SQES);
+
+    if((ring->sqRing == MAP_FAILED) || (ring->cqRing == MAP_FAILED) || (ring->sqes == MAP_FAILED))
+    {
+        if(ring->sqRing != MAP_FAILED) munmap(ring->sqRing, ring->sqRingLen);
+        if(ring->cqRing != MAP_FAILED) munmap(ring->cqRing, ring->cqRingLen);
+        if(ring->sqes != MAP_FAILED) munmap(ring->sqes, ring->sqesLen);
+        close(ring->fd);
+        return ERROR;
+    }
+
+    ring->sqHead=(unsigned *)((char *)ring->sqRing + params.sq_off.head);
+    ring->sqTail=(unsigned *)((char *)ring->sqRing + params.sq_off.tail);
+    ring->sqMask=(unsigned *)((char *)ring->sqRing + params.sq_off.ring_mask);
+    ring->sqArray=(unsigned *)((char *)ring->sqRing + params.sq_off.array);
+    ring->cqHead=(unsigned *)((char *)ring->cqRing + params.cq_off.head);
+    ring->cqTail=(unsigned *)((char *)ring->cqRing + params.cq_off.tail);
+    ring->cqMask=(unsigned *)((char *)ring->cqRing + params.cq_off.ring_mask);
+    ring->cqes=(struct io_uring_cqe *)((char *)ring->cqRing + params.cq_off.cqes);
+
+    return OK;
+}
+
+
+static void uringExit(uring_t *ring)
+{
+    munmap(ring->sqes, ring->sqesLen);
+    munmap(ring->cqRing, ring->cqRingLen);
+    munmap(ring->sqRing, ring->sqRingLen);
+    close(ring->fd);
+}
+
+
+// Queue a read or write, the ring is sized so it never fills between submits
+//
+static void uringQueue(uring_t *ring, int opcode, int fd, unsigned char *buffer,
+                       size_t len, long long offset, unsigned long long userData)
+{
+    unsigned tail=*ring->sqTail, index=tail & *ring->sqMask;
+    struct io_uring_sqe *sqe=&ring->sqes[index];
+
+    memset(sqe, 0, sizeof(struct io_uring_sqe));
+    sqe->opcode=opcode;
+    sqe->fd=fd;
+    sqe->addr=(unsigned long long)(uintptr_t)buffer;
+    sqe->len=len;
+    sqe->off=offset;
+    sqe->user_data=userData;
+
+    ring->sqArray[index]=index;
+    __atomic_store_n(ring->sqTail, tail+1, __ATOMIC_RELEASE);
+    ring->toSubmit++;
+    ring->inflight++;
+}
+
+
+// Submit everything queued and wait for at least one completion
+//
+static int uringSubmitWait(uring_t *ring)
+{
+    int rc;
+
+    do
+    {
+        rc=syscall(__NR_io_uring_enter, ring->fd, ring->toSubmit, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+    }
+    while((rc < 0) && (errno == EINTR));
+
+    if(rc < 0)
+    {
+        perror("io_uring_enter");
+        return ERROR;
+    }
+
+    ring->toSubmit-=rc;
+
+    return OK;
+}
+
+
+// user_data carries the slot and the chunk file, CHUNK_FILE for input/output
+//
+#define CHUNK_FILE (63)
+#define URING_DATA(slot, chunk) ((((unsigned long long)(slot)) << 6) | (chunk))
+
+
+static void uringQueueChunk(uring_t *ring, asyncJob_t *job, int slotIdx, int chunk, int opcode)
+{
+    asyncSlot_t *slot=&job->slots[slotIdx];
+    size_t done=slot->done[chunk];
+
+    uringQueue(ring, opcode, job->fd[chunk], slot->chunks[chunk]+done,
+               job->geom->chunkSize-done, slot->stripe*job->geom->chunkSize+done,
+               URING_DATA(slotIdx, chunk));
+}
+
+
+static void uringQueueFile(uring_t *ring, asyncJob_t *job, int slotIdx, int opcode)
+{
+    asyncSlot_t *slot=&job->slots[slotIdx];
+    size_t done=slot->done[0];
+
+    uringQueue(ring, opcode, job->fdfile, slot->buffer+done, slot->want-done,
+               slot->stripe*(long long)job->stripeBytes+done, URING_DATA(slotIdx, CHUNK_FILE));
+}
+
+
+// Shared completion loop for both directions.  Stripe: read input -> encode ->
+// write all chunks.  Restore: read all chunks -> rebuild -> write output.
+//
+// returns OK, ERROR, or URING_UNAVAILABLE if the ring could not be set up or
+// the kernel rejects the read/write opcodes, with errno set to why.  Every
+// transfer is at an explicit offset, so the job can simply be rerun.
+//
+#define URING_UNAVAILABLE (-2)
+
+static int uringRun(asyncJob_t *job, int restore)
+{
+    uring_t ring;
+    struct io_uring_cqe *cqe;
+    asyncSlot_t *slot;
+    long long nextStripe=0, finished=0;
+    unsigned head;
+    int idx, chunk, slotIdx, res, rc=OK, unsupported=0;
+
+    if(uringInit(&ring, job->depth*job->nchunks) == ERROR)
+        return URING_UNAVAILABLE;
+
+    while((finished < job->nstripes) && (rc == OK))
+    {
+        // start the first stage of any free slots
+        for(idx=0; (idx < job->depth) && (nextStripe < job->nstripes); idx++)
+        {
+            slot=&job->slots[idx];
+            if(slot->state != SLOT_FREE) continue;
+
+            slot->stripe=nextStripe++;
+            slot->want=asyncStripeBytes(job, slot->stripe);
+            memset(slot->done, 0, sizeof(slot->done));
+            slot->state=SLOT_READING;
+
+            if(restore)
+            {
+                for(chunk=0, slot->pending=0; chunk<job->nchunks; chunk++)
+                {
+                    if(job->fd[chunk] < 0) continue;
+                    uringQueueChunk(&ring, job, idx, chunk, IORING_OP_READ);
+                    slot->pending++;
+                }
+            }
+            else
+            {
+                if(slot->want < job->stripeBytes)
+                    memset(&slot->buffer[slot->want], 0, job->stripeBytes-slot->want);
+                uringQueueFile(&ring, job, idx, IORING_OP_READ);
+                slot->pending=1;
+            }
+        }
+
+        if(uringSubmitWait(&ring) == ERROR)
+        {
+            rc=ERROR;
+            break;
+        }
+
+        // reap every completion that is ready
+        head=*ring.cqHead;
+        while(head != __atomic_load_n(ring.cqTail, __ATOMIC_ACQUIRE))
+        {
+            cqe=&ring.cqes[head & *ring.cqMask];
+            slotIdx=cqe->user_data >> 6;
+            chunk=cqe->user_data & 0x3f;
+            res=cqe->res;
+            head++;
+            ring.inflight--;
+
+            if(rc == ERROR) continue;
+
+            slot=&job->slots[slotIdx];
+
+            // IORING_OP_READ/WRITE are 5.6 and later, before that -EINVAL
+            if((res == -EINVAL) || (res == -EOPNOTSUPP))
+            {
+                unsupported=-res;
+                rc=ERROR;
+                continue;
+            }
+
+            if(res <= 0)
+            {
+                printf("async %s: %s\n", (slot->state == SLOT_READING) ? "read" : "write",
+                       (res < 0) ? strerror(-res) : "unexpected end of file");
+                rc=ERROR;
+                continue;
+            }
+
+            // resubmit the rest of a short transfer
+            if(chunk == CHUNK_FILE)
+            {
+                slot->done[0]+=res;
+                if(slot->done[0] < slot->want)
+                {
+                    uringQueueFile(&ring, job, slotIdx, (slot->state == SLOT_READING) ? IORING_OP_READ : IORING_OP_WRITE);
+                    continue;
+                }
+            }
+            else
+            {
+                slot->done[chunk]+=res;
+                if(slot->done[chunk] < job->geom->chunkSize)
+                {
+                    uringQueueChunk(&ring, job, slotIdx, chunk, (slot->state == SLOT_READING) ? IORING_OP_READ : IORING_OP_WRITE);
+                    continue;
+                }
+            }
+
+            if(--slot->pending > 0) continue;
+
+            if(slot->state == SLOT_WRITING)
+            {
+                slot->state=SLOT_FREE;
+                finished++;
+                continue;
+            }
+
+            // all reads in for this stripe - compute and start the writes
+            memset(slot->done, 0, sizeof(slot->done));
+            slot->state=SLOT_WRITING;
+
+            if(restore)
+            {
+                stripeRebuild(job->geom, slot->chunks, job->missingChunk, job->missingChunk2);
+                uringQueueFile(&ring, job, slotIdx, IORING_OP_WRITE);
+                slot->pending=1;
+            }
+            else
+            {
+                stripeEncode(job->geom, slot->chunks);
+                for(idx=0; idx<job->nchunks; idx++)
+                    uringQueueChunk(&ring, job, slotIdx, idx, IORING_OP_WRITE);
+                slot->pending=job->nchunks;
+            }
+        }
+        __atomic_store_n(ring.cqHead, head, __ATOMIC_RELEASE);
+    }
+
+    // on error wait out anything still in flight, the buffers belong to it
+    while((rc == ERROR) && (ring.inflight > 0) && (uringSubmitWait(&ring) == OK))
+    {
+        head=*ring.cqHead;
+        while(head != __atomic_load_n(ring.cqTail, __ATOMIC_ACQUIRE))
+        {
+            head++;
+            ring.inflight--;
+        }
+        __atomic_store_n(ring.cqHead, head, __ATOMIC_RELEASE);
+    }
+
+    uringExit(&ring);
+
+    if(unsupported)
+    {
+        errno=unsupported;
+        return URING_UNAVAILABLE;
+    }
+
+    return rc;
+}
+
+#endif
+
+
+// Thread engine - one I/O thread per chunk file, and the calling thread does
+// the input side of a stripe or the output side of a restore.  A slot is
+// handed between them by its state, all under one mutex since each hand off
+// covers a whole stripe of I/O.
+//
+typedef struct
+{
+    asyncJob_t *job;
+    int chunk;
+    int restore;
+    pthread_mutex_t *lock;
+    pthread_cond_t *cond;
+    int *abort;
+} asyncWorker_t;
+
+
+static void *asyncChunkThread(void *arg)
+{
+    asyncWorker_t *worker=(asyncWorker_t *)arg;
+    asyncJob_t *job=worker->job;
+    asyncSlot_t *slot;
+    int waitState=worker->restore ? SLOT_READING : SLOT_WRITING;
+    long long stripe;
+    ssize_t rc;
+
+    for(stripe=0; stripe<job->nstripes; stripe++)
+    {
+        slot=&job->slots[stripe % job->depth];
+
+        pthread_mutex_lock(worker->lock);
+        while(!(*worker->abort) && !((slot->state == waitState) && (slot->stripe == stripe)))
+            pthread_cond_wait(worker->cond, worker->lock);
+        pthread_mutex_unlock(worker->lock);
+
+        if(*worker->abort) break;
+
+        if(worker->restore)
+            rc=pread(job->fd[worker->chunk], slot->chunks[worker->chunk], job->geom->chunkSize,
+                     stripe*job->geom->chunkSize);
+        else
+            rc=pwrite(job->fd[worker->chunk], slot->chunks[worker->chunk], job->geom->chunkSize,
+                      stripe*job->geom->chunkSize);
+
+        pthread_mutex_lock(worker->lock);
+        if(rc != job->geom->chunkSize)
+        {
+            printf("async chunk %d: %s\n", worker->chunk+1, (rc < 0) ? strerror(errno) : "short transfer");
+            *worker->abort=TRUE;
+        }
+        else if(--slot->pending == 0)
+        {
+            slot->state=worker->restore ? SLOT_READ : SLOT_FREE;
+        }
+        pthread_cond_broadcast(worker->cond);
+        pthread_mutex_unlock(worker->lock);
+    }
+
+    return NULL;
+}
+
+
+static int threadsRun(asyncJob_t *job, int restore)
+{
+    pthread_t threads[RAID_MAX_DATA_CHUNKS+2];
+    asyncWorker_t workers[RAID_MAX_DATA_CHUNKS+2];
+    pthread_mutex_t lock=PTHREAD_MUTEX_INITIALIZER;
+    pthread_cond_t cond=PTHREAD_COND_INITIALIZER;
+    asyncSlot_t *slot;
+    long long stripe, issued=0;
+    int chunk, started, abort=FALSE, npresent=0, rc;
+    size_t bytes;
+
+    for(chunk=0; chunk<job->nchunks; chunk++)
+    {
+        if(job->fd[chunk] < 0) continue;
+
+        workers[chunk].job=job;
+        workers[chunk].chunk=chunk;
+        workers[chunk].restore=restore;
+        workers[chunk].lock=&lock;
+        workers[chunk].cond=&cond;
+        workers[chunk].abort=&abort;
+
+        // without every chunk thread the job cannot finish, stop the others
+        if((rc=pthread_create(&threads[chunk], NULL, asyncChunkThread, &workers[chunk])) != 0)
+        {
+            printf("async chunk %d: pthread_create: %s\n", chunk+1, strerror(rc));
+            abort=TRUE;
+            break;
+        }
+        npresent++;
+    }
+    started=chunk;
+
+    for(stripe=0; stripe<job->nstripes; stripe++)
+    {
+        slot=&job->slots[stripe % job->depth];
+
+        if(restore)
+        {
+            // hand out chunk reads up to depth stripes ahead, then wait for
+            // this stripe to be read in
+            pthread_mutex_lock(&lock);
+            while((issued < job->nstripes) && (issued-stripe < job->depth))
+            {
+                job->slots[issued % job->depth].stripe=issued;
+                job->slots[issued % job->depth].pending=npresent;
+                job->slots[issued % job->depth].state=SLOT_READING;
+                issued++;
+            }
+            pthread_cond_broadcast(&cond);
+
+            while(!abort && (slot->state != SLOT_READ))
+                pthread_cond_wait(&cond, &lock);
+            pthread_mutex_unlock(&lock);
+
+            if(abort) break;
+
+            stripeRebuild(job->geom, slot->chunks, job->missingChunk, job->missingChunk2);
+
+            bytes=asyncStripeBytes(job, stripe);
+            if(pwrite(job->fdfile, slot->buffer, bytes, stripe*(long long)job->stripeBytes) != bytes)
+            {
+                perror("async write");
+                break;
+            }
+
+            pthread_mutex_lock(&lock);
+            slot->state=SLOT_FREE;
+            pthread_mutex_unlock(&lock);
+        }
+        else
+        {
+            // wait for the writes from depth stripes ago to drain
+            pthread_mutex_lock(&lock);
+            while(!abort && (slot->state != SLOT_FREE))
+                pthread_cond_wait(&cond, &lock);
+            pthread_mutex_unlock(&lock);
+
+            if(abort) break;
+
+            bytes=asyncStripeBytes(job, stripe);
+            if(readFully(job->fdfile, slot->buffer, bytes) != bytes)
+            {
+                printf("async read: short input\n");
+                break;
+            }
+            if(bytes < job->stripeBytes)
+                memset(&slot->buffer[bytes], 0, job->stripeBytes-bytes);
+
+            stripeEncode(job->geom, slot->chunks);
+
+            pthread_mutex_lock(&lock);
+            slot->stripe=stripe;
+            slot->pending=job->nchunks;
+            slot->state=SLOT_WRITING;
+            pthread_cond_broadcast(&cond);
+            pthread_mutex_unlock(&lock);
+        }
+    }
+
+    // let the chunk threads finish what was handed out, or stop them early
+    pthread_mutex_lock(&lock);
+    if(stripe < job->nstripes) abort=TRUE;
+    pthread_cond_broadcast(&cond);
+    pthread_mutex_unlock(&lock);
+
+    for(chunk=0; chunk<started; chunk++)
+        if(job->fd[chunk] >= 0) pthread_join(threads[chunk], NULL);
+
+    return abort ? ERROR : OK;
+}
+
+
+static int asyncRun(asyncJob_t *job, int engine, int restore)
+{
+#ifdef RAID_HAVE_URING
+    int rc, idx;
+
+    if(engine != RAID_ASYNC_THREADS)
+    {
+        // only fall back if the ring could not be set up or do reads and
+        // writes at all, not on a real I/O error
+        if((rc=uringRun(job, restore)) != URING_UNAVAILABLE)
+            return rc;
+
+        if(engine == RAID_ASYNC_URING)
+        {
+            perror("io_uring");
+            return ERROR;
+        }
+
+        // start over, anything already transferred is simply done again
+        for(idx=0; idx<job->depth; idx++)
+        {
+            job->slots[idx].state=SLOT_FREE;
+            job->slots[idx].pending=0;
+        }
+    }
+#else
+    if(engine == RAID_ASYNC_URING)
+    {
+        printf("async: io_uring not supported by this build\n");
+        return ERROR;
+    }
+#endif
+
+    return threadsRun(job, restore);
+}
+
+
+// returns bytes striped or ERROR code
+//
+// engine = RAID_ASYNC_AUTO for io_uring with thread fallback, or
+//          RAID_ASYNC_URING / RAID_ASYNC_THREADS to force one
+// depth  = stripes in flight, 0 for RAID_ASYNC_DEPTH
+//
+long long stripeFileAsync(stripeGeom_t *geom, char *inputFileName, int engine, int depth)
+{
+    asyncJob_t job;
+    struct stat st;
+    int rc;
+
+    memset(&job, 0, sizeof(job));
+
+    if((job.fdfile=open(inputFileName, O_RDONLY)) < 0)
+    {
+        perror(inputFileName);
+        return ERROR;
+    }
+
+    if(fstat(job.fdfile, &st) < 0)
+    {
+        perror(inputFileName);
+        close(job.fdfile);
+        return ERROR;
+    }
+    job.fileLength=st.st_size;
+
+    if(asyncJobInit(&job, geom, depth) == ERROR)
+    {
+        close(job.fdfile);
+        return ERROR;
+    }
+
+    job.nstripes=(job.fileLength+job.stripeBytes-1)/job.stripeBytes;
+
+    if(openChunks(geom, job.fd, O_RDWR | O_CREAT | O_TRUNC, 0, 0) == ERROR)
+    {
+        asyncJobFree(&job);
+        close(job.fdfile);
+        return ERROR;
+    }
+
+    rc=asyncRun(&job, engine, FALSE);
+
+    asyncJobFree(&job);
+    close(job.fdfile);
+    closeChunks(geom, job.fd);
+
+    return((rc == OK) ? job.fileLength : ERROR);
+}
+
+
+// returns bytes restored or ERROR code, missing chunks as restoreFileGeom2()
+//
+long long restoreFileAsync(stripeGeom_t *geom, char *outputFileName, long long fileLength,
+                           int missingChunk, int missingChunk2, int engine, int depth)
+{
+    asyncJob_t job;
+    int rc;
+
+    memset(&job, 0, sizeof(job));
+
+    if(stripeCheckMissing(geom, &missingChunk, &missingChunk2) == ERROR)
+        return ERROR;
+
+    if((job.fdfile=open(outputFileName, O_WRONLY | O_CREAT | O_TRUNC, 00644)) < 0)
+    {
+        perror(outputFileName);
+        return ERROR;
+    }
+
+    if(asyncJobInit(&job, geom, depth) == ERROR)
+    {
+        close(job.fdfile);
+        return ERROR;
+    }
+
+    job.fileLength=fileLength;
+    job.nstripes=(fileLength+job.stripeBytes-1)/job.stripeBytes;
+    job.missingChunk=missingChunk;
+    job.missingChunk2=missingChunk2;
+
+    if(openChunks(geom, job.fd, O_RDONLY, missingChunk, missingChunk2) == ERROR)
+    {
+        asyncJobFree(&job);
+        close(job.fdfile);
+        return ERROR;
+    }
+
+    if(missingChunk)
+        printf("will rebuild chunk %d\n", missingChunk);
+    if(missingChunk2)
+        printf("will rebuild chunk %d\n", missingChunk2);
+
+    rc=asyncRun(&job, engine, TRUE);
+
+    asyncJobFree(&job);
+    close(job.fdfile);
+    closeChunks(geom, job.fd);
+
+    return((rc == OK) ? fileLength : ERROR);
+}
@@ -0,0 +1,290 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "raidlib.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define RAID_X86_KERNELS
+#endif
+
+
+// XOR parity kernels
+//
+// All RAID-5 parity and rebuild work reduces to the same operation:
+//
+//     dst = src[0] ^ src[1] ^ ... ^ src[nsrcs-1]
+//
+// so each variant below implements just that, and xorLBA()/rebuildLBA() call
+// whichever one was selected at startup.  The variants differ only in how wide
+// a word they XOR at a time.  Buffers do not need to be aligned, and any tail
+// shorter than the vector width is finished with the scalar code.
+//
+// The x86 vector variants are compiled with per-function target attributes so
+// that the rest of the library can still be built for a baseline CPU and the
+// right one is picked by CPUID at run time rather than at compile time.
+//
+
+static void xorBlocksByte(unsigned char **srcs, int nsrcs, unsigned char *dst,
+                          size_t offset, size_t len)
+{
+    size_t idx;
+    int src;
+    unsigned char parity;
+
+    for(idx=offset; idx<len; idx++)
+    {
+        parity=srcs[0][idx];
+
+        for(src=1; src<nsrcs; src++)
+            parity^=srcs[src][idx];
+
+        dst[idx]=parity;
+    }
+}
+
+
+// Portable fallback - 64 bits at a time, unrolled by 4 so the compiler can keep
+// the loads in flight.  memcpy() is used to load and store so unaligned buffers
+// are legal on every architecture; it compiles to plain moves.
+//
+static void xorBlocksScalar(unsigned char **srcs, int nsrcs, unsigned char *dst, size_t len)
+{
+    size_t idx;
+    int src;
+    uint64_t p0, p1, p2, p3, w0, w1, w2, w3;
+
+    for(idx=0; idx+32 <= len; idx+=32)
+    {
+        memcpy(&p0, &srcs[0][idx], 8);
+        memcpy(&p1, &srcs[0][idx+8], 8);
+        memcpy(&p2, &srcs[0][idx+16], 8);
+        memcpy(&p3, &srcs[0][idx+24], 8);
+
+        for(src=1; src<nsrcs; src++)
+        {
+            memcpy(&w0, &srcs[src][idx], 8);
+            memcpy(&w1, &srcs[src][idx+8], 8);
+            memcpy(&w2, &srcs[src][idx+16], 8);
+            memcpy(&w3, &srcs[src][idx+24], 8);
+            p0^=w0; p1^=w1; p2^=w2; p3^=w3;
+        }
+
+        memcpy(&dst[idx], &p0, 8);
+        memcpy(&dst[idx+8], &p1, 8);
+        memcpy(&dst[idx+16], &p2, 8);
+        memcpy(&dst[idx+24], &p3, 8);
+    }
+
+    xorBlocksByte(srcs, nsrcs, dst, idx, len);
+}
+
+
+#ifdef RAID_X86_KERNELS
+
+__attribute__((target("sse2")))
+static void xorBlocksSSE2(unsigned char **srcs, int nsrcs, unsigned char *dst, size_t len)
+{
+    size_t idx;
+    int src;
+    __m128i p0, p1;
+
+    for(idx=0; idx+32 <= len; idx+=32)
+    {
+        p0=_mm_loadu_si128((__m128i *)&srcs[0][idx]);
+        p1=_mm_loadu_si128((__m128i *)&srcs[0][idx+16]);
+
+        for(src=1; src<nsrcs; src++)
+        {
+            p0=_mm_xor_si128(p0, _mm_loadu_si128((__m128i *)&srcs[src][idx]));
+            p1=_mm_xor_si128(p1, _mm_loadu_si128((__m128i *)&srcs[src][idx+16]));
+        }
+
+        _mm_storeu_si128((__m128i *)&dst[idx], p0);
+        _mm_storeu_si128((__m128i *)&dst[idx+16], p1);
+    }
+
+    xorBlocksByte(srcs, nsrcs, dst, idx, len);
+}
+
+
+__attribute__((target("avx2")))
+static void xorBlocksAVX2(unsigned char **srcs, int nsrcs, unsigned char *dst, size_t len)
+{
+    size_t idx;
+    int src;
+    __m256i p0, p1;
+
+    for(idx=0; idx+64 <= len; idx+=64)
+    {
+        p0=_mm256_loadu_si256((__m256i *)&srcs[0][idx]);
+        p1=_mm256_loadu_si256((__m256i *)&srcs[0][idx+32]);
+
+        for(src=1; src<nsrcs; src++)
+        {
+            p0=_mm256_xor_si256(p0, _mm256_loadu_si256((__m256i *)&srcs[src][idx]));
+            p1=_mm256_xor_si256(p1, _mm256_loadu_si256((__m256i *)&srcs[src][idx+32]));
+        }
+
+        _mm256_storeu_si256((__m256i *)&dst[idx], p0);
+        _mm256_storeu_si256((__m256i *)&dst[idx+32], p1);
+    }
+
+    // avoid the AVX to SSE transition penalty in whatever runs next
+    _mm256_zeroupper();
+
+    xorBlocksByte(srcs, nsrcs, dst, idx, len);
+}
+
+
+__attribute__((target("avx512f")))
+static void xorBlocksAVX512(unsigned char **srcs, int nsrcs, unsigned char *dst, size_t len)
+{
+    size_t idx;
+    int src;
+    __m512i p0, p1;
+
+    for(idx=0; idx+128 <= len; idx+=128)
+    {
+        p0=_mm512_loadu_si512((void *)&srcs[0][idx]);
+        p1=_mm512_loadu_si512((void *)&srcs[0][idx+64]);
+
+        for(src=1; src<nsrcs; src++)
+        {
+            p0=_mm512_xor_si512(p0, _mm512_loadu_si512((void *)&srcs[src][idx]));
+            p1=_mm512_xor_si512(p1, _mm512_loadu_si512((void *)&srcs[src][idx+64]));
+        }
+
+        _mm512_storeu_si512((void *)&dst[idx], p0);
+        _mm512_storeu_si512((void *)&dst[idx+64], p1);
+    }
+
+    _mm256_zeroupper();
+
+    xorBlocksByte(srcs, nsrcs, dst, idx, len);
+}
+
+#endif
+
+
+typedef void (*xorBlocksFunc_t)(unsigned char **srcs, int nsrcs, unsigned char *dst, size_t len);
+
+static const char *kernelNames[RAID_KERNEL_COUNT] = {"scalar", "sse2", "avx2", "avx512"};
+
+static const xorBlocksFunc_t kernelFuncs[RAID_KERNEL_COUNT] =
+{
+    xorBlocksScalar,
+#ifdef RAID_X86_KERNELS
+    xorBlocksSSE2,
+    xorBlocksAVX2,
+    xorBlocksAVX512
+#else
+    NULL, NULL, NULL
+#endif
+};
+
+// RAID_KERNEL_AUTO until the first call resolves it
+static int selectedKernel=RAID_KERNEL_AUTO;
+static xorBlocksFunc_t selectedFunc=NULL;
+static pthread_once_t autoSelectOnce=PTHREAD_ONCE_INIT;
+
+
+int raidKernelSupported(int kernel)
+{
+    if((kernel < 0) || (kernel >= RAID_KERNEL_COUNT) || (kernelFuncs[kernel] == NULL))
+        return FALSE;
+
+#ifdef RAID_X86_KERNELS
+    __builtin_cpu_init();
+
+    switch(kernel)
+    {
+        case RAID_KERNEL_SSE2:
+            return __builtin_cpu_supports("sse2") ? TRUE : FALSE;
+        case RAID_KERNEL_AVX2:
+            return __builtin_cpu_supports("avx2") ? TRUE : FALSE;
+        case RAID_KERNEL_AVX512:
+            return __builtin_cpu_supports("avx512f") ? TRUE : FALSE;
+        default:
+            break;
+    }
+#endif
+
+    return TRUE;
+}
+
+
+const char *raidKernelName(int kernel)
+{
+    if(kernel == RAID_KERNEL_AUTO)
+        kernel=raidSelectedKernel();
+
+    if((kernel < 0) || (kernel >= RAID_KERNEL_COUNT))
+        return "unknown";
+
+    return kernelNames[kernel];
+}
+
+
+// Select a parity kernel by number, or RAID_KERNEL_AUTO for the widest one
+// this CPU supports.  Returns the kernel selected or ERROR if the requested
+// one cannot run here, in which case the previous selection is kept.
+//
+int raidSelectKernel(int kernel)
+{
+    if(kernel == RAID_KERNEL_AUTO)
+    {
+        for(kernel=RAID_KERNEL_COUNT-1; kernel > RAID_KERNEL_SCALAR; kernel--)
+            if(raidKernelSupported(kernel)) break;
+    }
+    else if(!raidKernelSupported(kernel))
+    {
+        return ERROR;
+    }
+
+    selectedKernel=kernel;
+    selectedFunc=kernelFuncs[kernel];
+
+    return kernel;
+}
+
+
+// first use with no explicit selection - may be on several threads at once
+static void autoSelectKernel(void)
+{
+    if(selectedFunc == NULL)
+        raidSelectKernel(RAID_KERNEL_AUTO);
+}
+
+
+int raidSelectedKernel(void)
+{
+    pthread_once(&autoSelectOnce, autoSelectKernel);
+
+    return selectedKernel;
+}
+
+
+void xorBlocks(unsigned char **srcs, int nsrcs, unsigned char *dst, size_t len)
+{
+    if(selectedFunc == NULL)
+        pthread_once(&autoSelectOnce, autoSelectKernel);
+
+    (*selectedFunc)(srcs, nsrcs, dst, len);
+}
+
+
+// Run one specific kernel, bypassing the selection - used by raid_perftest to
+// compare all the variants on the same host
+//
+int xorBlocksKernel(int kernel, unsigned char **srcs, int nsrcs, unsigned char *dst, size_t len)
+{
+    if(!raidKernelSupported(kernel))
+        return ERROR;
+
+    (*kernelFuncs[kernel])(srcs, nsrcs, dst, len);
+
+    return OK;
+}
@@ -37,10 +37,9 @@ void xorLBA(unsigned char *LBA1,
 	    unsigned char *LBA4,
 	    unsigned char *PLBA)
 {
-    int idx;
+    unsigned char *LBAs[4]={LBA1, LBA2, LBA3, LBA4};
 
-    for(idx=0; idx<SECTOR_SIZE; idx++)
-        *(PLBA+idx)=(*(LBA1+idx))^(*(LBA2+idx))^(*(LBA3+idx))^(*(LBA4+idx));
+    xorBlocks(LBAs, 4, PLBA, SECTOR_SIZE);
 }
 
 
@@ -56,18 +55,12 @@ void rebuildLBA(unsigned char *LBA1,
 	        unsigned char *PLBA,
 	        unsigned char *RLBA)
 {
-    int idx;
-    unsigned char checkParity;
-
-    for(idx=0; idx<SECTOR_SIZE; idx++)
-    {
-        // Parity check word is simply XOR of remaining good LBAs
-        checkParity=(*(LBA1+idx))^(*(LBA2+idx))^(*(LBA3+idx));
+    // Parity check word is simply XOR of remaining good LBAs, and the rebuilt
+    // LBA is the XOR of that with the original parity, which is the same
+    // operation as encoding with the parity LBA in place of the lost one
+    unsigned char *LBAs[4]={LBA1, LBA2, LBA3, PLBA};
 
-        // Rebuilt LBA is simply XOR of original parity and parity check word
-        // which will preserve original parity computed over the 4 LBAs
-        *(RLBA+idx) =(*(PLBA+idx))^(checkParity);
-    }
+    xorBlocks(LBAs, 4, RLBA, SECTOR_SIZE);
 }
 
 
@@ -89,446 +82,405 @@ int checkEquivLBA(unsigned char *LBA1,
 }
 
 
-// returns bytes written or ERROR code
-// 
-int stripeFile(char *inputFileName, int offsetSectors)
+// Stripe geometry
+//
+// A striped set is N data chunk files plus one XOR parity chunk file, and for
+// RAID-6 a second Q parity file.  Each stripe is chunkSize bytes from every
+// file, so one stripe holds N*chunkSize bytes of the input and costs N+1 (or
+// N+2) write() calls no matter how large chunkSize is.  Chunks are numbered
+// 1...N for data, N+1 for XOR parity and N+2 for Q in restore calls, which
+// matches the original 4+1 numbering with 5 = XOR.
+//
+// returns OK or ERROR for an out of range geometry
+//
+int stripeGeomInit(stripeGeom_t *geom, int dataChunks, int chunkSize)
+{
+    if((dataChunks < RAID_MIN_DATA_CHUNKS) || (dataChunks > RAID_MAX_DATA_CHUNKS))
+    {
+        printf("stripeGeomInit: %d data chunks not in %d...%d\n", dataChunks,
+               RAID_MIN_DATA_CHUNKS, RAID_MAX_DATA_CHUNKS);
+        return ERROR;
+    }
+
+    if((chunkSize < RAID_MIN_CHUNK_SIZE) || (chunkSize > RAID_MAX_CHUNK_SIZE) ||
+       (chunkSize % SECTOR_SIZE))
+    {
+        printf("stripeGeomInit: chunk size %d not a multiple of %d in %d...%d\n", chunkSize,
+               SECTOR_SIZE, RAID_MIN_CHUNK_SIZE, RAID_MAX_CHUNK_SIZE);
+        return ERROR;
+    }
+
+    geom->dataChunks=dataChunks;
+    geom->parityChunks=1;
+    geom->chunkSize=chunkSize;
+
+    return OK;
+}
+
+
+// RAID_LEVEL_5 for XOR parity only, RAID_LEVEL_6 to add the Q parity chunk so
+// any two chunks can be lost
+//
+int stripeGeomSetLevel(stripeGeom_t *geom, int raidLevel)
+{
+    if(raidLevel == RAID_LEVEL_5)
+        geom->parityChunks=1;
+    else if(raidLevel == RAID_LEVEL_6)
+        geom->parityChunks=2;
+    else
+        return ERROR;
+
+    return OK;
+}
+
+
+// The original 4 data + 1 XOR layout with 512 byte chunks, below the minimum
+// chunk size for new sets but kept so stripeFile()/restoreFile() still read
+// and write the same chunk files as before
+//
+static void stripeGeomLegacy(stripeGeom_t *geom)
+{
+    geom->dataChunks=4;
+    geom->parityChunks=1;
+    geom->chunkSize=SECTOR_SIZE;
+}
+
+
+// chunk = 1...N for data, N+1 for XOR parity, N+2 for Q parity
+//
+void stripeChunkName(stripeGeom_t *geom, int chunk, char *name, size_t nameLen)
 {
-    int fd[5], idx;
-    FILE *fdin;
-    unsigned char stripe[5*512];
-    int offset=0, bread=0, btoread=(4*512), bwritten=0, btowrite=(512), sectorCnt=0, byteCnt=0;
+    if(chunk == geom->dataChunks+1)
+        snprintf(name, nameLen, "StripeChunkXOR.bin");
+    else if(chunk == geom->dataChunks+2)
+        snprintf(name, nameLen, "StripeChunkQ.bin");
+    else
+        snprintf(name, nameLen, "StripeChunk%d.bin", chunk);
+}
 
-    fdin = fopen(inputFileName, "r");
-    fd[0] = open("StripeChunk1.bin", O_RDWR | O_CREAT, 00644);
-    fd[1] = open("StripeChunk2.bin", O_RDWR | O_CREAT, 00644);
-    fd[2] = open("StripeChunk3.bin", O_RDWR | O_CREAT, 00644);
-    fd[3] = open("StripeChunk4.bin", O_RDWR | O_CREAT, 00644);
-    fd[4] = open("StripeChunkXOR.bin", O_RDWR | O_CREAT, 00644);
 
+// read()/write() can return short counts, so loop until done, end of file or
+// an error; returns bytes transferred or ERROR
+//
+ssize_t readFully(int fd, unsigned char *buffer, size_t len)
+{
+    size_t offset=0;
+    ssize_t bread;
 
-    do
+    while(offset < len)
     {
+        bread=read(fd, &buffer[offset], len-offset);
+        if(bread < 0) { perror("read"); return ERROR; }
+        if(bread == 0) break;
+        offset+=bread;
+    }
 
-        // read a stripe or to end of file
-        offset=0, bread=0, btoread=(4*512);
-        do
-        {
-            bread=fread(&stripe[offset], 1, btoread, fdin); 
-            offset+=bread;
-            btoread=(4*512)-bread;
-        }
-        while (!(feof(fdin)) && (btoread > 0));
+    return offset;
+}
 
 
-        if((offset < (4*512)) && (feof(fdin)))
-        {
-            printf("hit end of file\n");
-            bzero(&stripe[offset], btoread);
-            byteCnt+=offset;
-        }
-        else
-        {
-            //printf("read full stripe\n");
-            assert(offset == (4*512));
-            byteCnt+=(4*512);
-        };
-
-        // computer xor code for stripe
-        //
-        xorLBA(PTR_CAST &stripe[0],
-               PTR_CAST &stripe[512],
-               PTR_CAST &stripe[1024],
-               PTR_CAST &stripe[1536],
-               PTR_CAST &stripe[2048]);
-
-
-        // write out the stripe + xor code
-        //
-        offset=0, bwritten=0, btowrite=(512);
-        do
-        {
-            bwritten=write(fd[0], &stripe[offset], 512); 
-            offset+=bwritten;
-            btowrite=(512)-bwritten;
-        }
-        while (btowrite > 0);
+ssize_t writeFully(int fd, unsigned char *buffer, size_t len)
+{
+    size_t offset=0;
+    ssize_t bwritten;
 
-        offset=512, bwritten=0, btowrite=(512);
-        do
-        {
-            bwritten=write(fd[1], &stripe[offset], 512); 
-            offset+=bwritten;
-            btowrite=(512)-bwritten;
-        }
-        while (btowrite > 0);
+    while(offset < len)
+    {
+        bwritten=write(fd, &buffer[offset], len-offset);
+        if(bwritten < 0) { perror("write"); return ERROR; }
+        offset+=bwritten;
+    }
+
+    return offset;
+}
+
+
+// Open all the chunk files, skipping skipChunk and skipChunk2 (0 for none),
+// fd is -1 for the skipped ones.  returns OK or ERROR with nothing left open.
+//
+int openChunks(stripeGeom_t *geom, int *fd, int flags, int skipChunk, int skipChunk2)
+{
+    char name[64];
+    int idx;
+
+    for(idx=0; idx < geom->dataChunks+geom->parityChunks; idx++)
+    {
+        fd[idx]=-1;
+
+        if((idx+1 == skipChunk) || (idx+1 == skipChunk2)) continue;
 
-        offset=1024, bwritten=0, btowrite=(512);
-        do
+        stripeChunkName(geom, idx+1, name, sizeof(name));
+
+        if((fd[idx]=open(name, flags, 00644)) < 0)
         {
-            bwritten=write(fd[2], &stripe[offset], 512); 
-            offset+=bwritten;
-            btowrite=(512)-bwritten;
+            perror(name);
+            while(idx-- > 0) if(fd[idx] >= 0) close(fd[idx]);
+            return ERROR;
         }
-        while (btowrite > 0);
+    }
+
+    return OK;
+}
+
+
+void closeChunks(stripeGeom_t *geom, int *fd)
+{
+    int idx;
+
+    for(idx=0; idx < geom->dataChunks+geom->parityChunks; idx++)
+        if(fd[idx] >= 0) close(fd[idx]);
+}
+
+
+// Compute the parity chunks of one stripe from its data chunks, chunks[] is
+// data 0...N-1 then XOR parity then Q parity for RAID-6
+//
+void stripeEncode(stripeGeom_t *geom, unsigned char **chunks)
+{
+    if(geom->parityChunks == 2)
+        raid6GenPQ(chunks, geom->dataChunks, chunks[geom->dataChunks],
+                   chunks[geom->dataChunks+1], geom->chunkSize);
+    else
+        xorBlocks(chunks, geom->dataChunks, chunks[geom->dataChunks], geom->chunkSize);
+}
+
+
+// Rebuild the lost data chunks of one stripe in place.  Parity is not part of
+// the restored file, so only a lost data chunk needs any work, and a lost Q
+// chunk is not regenerated.  The surviving chunks are only read, except that
+// a lost P chunk buffer is used as scratch.  Missing chunks are numbered
+// 1...N+2 as for restore, 0 for none.
+//
+void stripeRebuild(stripeGeom_t *geom, unsigned char **chunks, int missingChunk, int missingChunk2)
+{
+    unsigned char *srcs[RAID_MAX_DATA_CHUNKS+1];
+    int idx, nsrcs;
+
+    if(geom->parityChunks == 2)
+    {
+        if(missingChunk == geom->dataChunks+2) missingChunk=0;
+        if(missingChunk2 == geom->dataChunks+2) missingChunk2=0;
+
+        if(((missingChunk > 0) && (missingChunk <= geom->dataChunks)) ||
+           ((missingChunk2 > 0) && (missingChunk2 <= geom->dataChunks)))
+            raid6Recover(chunks, geom->dataChunks, geom->chunkSize, missingChunk-1, missingChunk2-1);
+    }
+    else if((missingChunk > 0) && (missingChunk <= geom->dataChunks))
+    {
+        // for RAID-5 the missing chunk is the XOR of every other chunk, parity included
+        for(idx=0, nsrcs=0; idx <= geom->dataChunks; idx++)
+            if(idx+1 != missingChunk) srcs[nsrcs++]=chunks[idx];
+
+        xorBlocks(srcs, nsrcs, chunks[missingChunk-1], geom->chunkSize);
+    }
+}
+
 
-        offset=1536, bwritten=0, btowrite=(512);
-        do
+// Validate the missing chunk numbers for a restore, moving a lone second one
+// into the first.  returns OK or ERROR if the set can't be restored.
+//
+int stripeCheckMissing(stripeGeom_t *geom, int *missingChunk, int *missingChunk2)
+{
+    int nchunks=geom->dataChunks+geom->parityChunks;
+
+    if(*missingChunk == 0)
+    {
+        *missingChunk=*missingChunk2;
+        *missingChunk2=0;
+    }
+
+    if((*missingChunk < 0) || (*missingChunk > nchunks) ||
+       (*missingChunk2 < 0) || (*missingChunk2 > nchunks) ||
+       (*missingChunk2 && ((geom->parityChunks < 2) || (*missingChunk2 == *missingChunk))))
+    {
+        printf("restoreFileGeom: can't restore chunks %d and %d in %d+%d set\n",
+               *missingChunk, *missingChunk2, geom->dataChunks, geom->parityChunks);
+        return ERROR;
+    }
+
+    return OK;
+}
+
+
+// returns bytes striped or ERROR code
+//
+long long stripeFileGeom(stripeGeom_t *geom, char *inputFileName)
+{
+    int fd[RAID_MAX_DATA_CHUNKS+2], fdin, idx, nchunks=geom->dataChunks+geom->parityChunks;
+    unsigned char *stripe, *chunks[RAID_MAX_DATA_CHUNKS+2];
+    size_t stripeBytes=(size_t)geom->dataChunks*geom->chunkSize;
+    ssize_t bread;
+    long long byteCnt=0;
+
+    if((fdin=open(inputFileName, O_RDONLY)) < 0)
+    {
+        perror(inputFileName);
+        return ERROR;
+    }
+
+    if(openChunks(geom, fd, O_RDWR | O_CREAT | O_TRUNC, 0, 0) == ERROR)
+    {
+        close(fdin);
+        return ERROR;
+    }
+
+    // data chunks followed by parity, contiguous so one read fills the stripe
+    stripe=malloc((size_t)nchunks*geom->chunkSize);
+    assert(stripe != NULL);
+
+    for(idx=0; idx < nchunks; idx++)
+        chunks[idx]=&stripe[(size_t)idx*geom->chunkSize];
+
+    while((bread=readFully(fdin, stripe, stripeBytes)) > 0)
+    {
+        if(bread < stripeBytes)
         {
-            bwritten=write(fd[3], &stripe[offset], 512); 
-            offset+=bwritten;
-            btowrite=(512)-bwritten;
+            printf("hit end of file\n");
+            bzero(&stripe[bread], stripeBytes-bread);
         }
-        while (btowrite > 0);
 
-        offset=2048, bwritten=0, btowrite=(512);
-        do
+        byteCnt+=bread;
+
+        // compute xor code, and Q code for RAID-6, for stripe
+        stripeEncode(geom, chunks);
+
+        // write out the stripe + parity
+        for(idx=0; idx < nchunks; idx++)
         {
-            bwritten=write(fd[4], &stripe[offset], 512); 
-            offset+=bwritten;
-            btowrite=(512)-bwritten;
+            if(writeFully(fd[idx], chunks[idx], geom->chunkSize) == ERROR)
+            {
+                byteCnt=ERROR;
+                goto done;
+            }
         }
-        while (btowrite > 0);
-
-        sectorCnt+=4;
 
+        if(bread < stripeBytes) break;
     }
-    while (!(feof(fdin)));
 
-    fclose(fdin);
-    for(idx=0; idx < 5; idx++) close(fd[idx]);
+    if(bread < 0) byteCnt=ERROR;
+
+done:
+    free(stripe);
+    close(fdin);
+    closeChunks(geom, fd);
 
     return(byteCnt);
 }
 
 
-// returns bytes read or ERROR code
-// 
-// missingChunk = 0 for no missing
-//              = 1 ... 4 for missing data chunk
-//              = 5 for missing XOR chunk
+// returns bytes restored or ERROR code
 //
-// Ugly repeated code needs to be refactored, but works for now.
+// missingChunk = 0 for no missing
+//              = 1 ... N for missing data chunk
+//              = N+1 for missing XOR chunk
 //
-int restoreFile(char *outputFileName, int offsetSectors, int fileLength, int missingChunk)
+long long restoreFileGeom(stripeGeom_t *geom, char *outputFileName, long long fileLength, int missingChunk)
 {
-    int fd[5], idx;
-    FILE *fdout;
-    unsigned char stripe[5*512];
-    int offset=0, bread=0, btoread=(4*512), bwritten=0, btowrite=(512), sectorCnt=fileLength/512;
-    int stripeCnt=fileLength/(4*512);
-    int lastStripeBytes = fileLength % (4*512);
+    return restoreFileGeom2(geom, outputFileName, fileLength, missingChunk, 0);
+}
 
-    fdout = fopen(outputFileName, "w");
 
-    fd[0] = open("StripeChunk1.bin", O_RDWR | O_CREAT, 00644);
-    fd[1] = open("StripeChunk2.bin", O_RDWR | O_CREAT, 00644);
-    fd[2] = open("StripeChunk3.bin", O_RDWR | O_CREAT, 00644);
-    fd[3] = open("StripeChunk4.bin", O_RDWR | O_CREAT, 00644);
-    fd[4] = open("StripeChunkXOR.bin", O_RDWR | O_CREAT, 00644);
+// As restoreFileGeom() with up to two missing chunks for a RAID-6 set,
+// N+2 is the Q chunk
+//
+long long restoreFileGeom2(stripeGeom_t *geom, char *outputFileName, long long fileLength,
+                           int missingChunk, int missingChunk2)
+{
+    int fd[RAID_MAX_DATA_CHUNKS+2], fdout, idx, rc=OK;
+    int nchunks=geom->dataChunks+geom->parityChunks;
+    unsigned char *stripe, *chunks[RAID_MAX_DATA_CHUNKS+2];
+    size_t stripeBytes=(size_t)geom->dataChunks*geom->chunkSize, btowrite;
+    long long remaining=fileLength;
 
+    if(stripeCheckMissing(geom, &missingChunk, &missingChunk2) == ERROR)
+        return ERROR;
 
-    for(idx=0; idx < stripeCnt; idx++)
+    if((fdout=open(outputFileName, O_WRONLY | O_CREAT | O_TRUNC, 00644)) < 0)
     {
-        // read in the stripe + xor code
-
-        if(missingChunk == 1)
-	{
-		printf("will rebuild chunk 1\n");
-	}
-	else
-	{
-            offset=0, bread=0, btoread=(512);
-            do
-            {
-                bread=read(fd[0], &stripe[offset], 512); 
-                offset+=bread;
-                btoread=(512)-bread;
-            }
-            while (btoread > 0);
-	}
-
-
-        if(missingChunk == 2)
-	{
-		printf("will rebuild chunk 2\n");
-	}
-	else
-	{
-            offset=512, bread=0, btoread=(512);
-            do
-            {
-                bread=read(fd[1], &stripe[offset], 512); 
-                offset+=bread;
-                btoread=(512)-bread;
-            }
-            while (btoread > 0);
-	}
-
-
-        if(missingChunk == 3)
-	{
-		printf("will rebuild chunk 3\n");
-	}
-	else
-	{
-            offset=1024, bread=0, btoread=(512);
-            do
-            {
-                bread=read(fd[2], &stripe[offset], 512); 
-                offset+=bread;
-                btoread=(512)-bread;
-            }
-            while (btoread > 0);
-	}
-
-        if(missingChunk == 4)
-	{
-		printf("will rebuild chunk 4\n");
-	}
-	else
-	{
-            offset=1536, bread=0, btoread=(512);
-            do
-            {
-                bread=read(fd[3], &stripe[offset], 512); 
-                offset+=bread;
-                btoread=(512)-bread;
-            }
-            while (btoread > 0);
-	}
-
-        if(missingChunk == 5)
-	{
-		printf("will rebuild chunk 5\n");
-	}
-	else
-	{
-            offset=2048, bread=0, btoread=(512);
-            do
-            {
-                bread=read(fd[4], &stripe[offset], 512); 
-                offset+=bread;
-                btoread=(512)-bread;
-            }
-            while (btoread > 0);
-	}
-
-        // OPTION - check XOR here or re-compute it
-        //
-	if(missingChunk == 1)
-	{
-		rebuildLBA( PTR_CAST &stripe[512], 
-			    PTR_CAST &stripe[1024], 
-			    PTR_CAST &stripe[1536], 
-			    PTR_CAST &stripe[2048], 
-			    PTR_CAST &stripe[0]);
-	}
-
-	if(missingChunk == 2)
-	{
-		rebuildLBA( PTR_CAST &stripe[0], 
-		  	    PTR_CAST &stripe[1024], 
-			    PTR_CAST &stripe[1536], 
-			    PTR_CAST &stripe[2048], 
-			    PTR_CAST &stripe[512]);
-	}
-	if(missingChunk == 3)
-	{
-		rebuildLBA(
-			   PTR_CAST &stripe[0],
-		           PTR_CAST &stripe[512],
-		           PTR_CAST &stripe[1536],
-		           PTR_CAST &stripe[2048],
-		           PTR_CAST &stripe[1024]
-			  );
-	}
-	if(missingChunk == 4)
-	{
-		rebuildLBA(
-			   PTR_CAST &stripe[0],
-		           PTR_CAST &stripe[512],
-		           PTR_CAST &stripe[1024],
-		           PTR_CAST &stripe[2048],
-		           PTR_CAST &stripe[1536]
-			  );
-	}
-	if(missingChunk == 5)
-	{
-		rebuildLBA(
-			   PTR_CAST &stripe[0],
-		           PTR_CAST &stripe[512],
-		           PTR_CAST &stripe[1024],
-		           PTR_CAST &stripe[1536],
-		           PTR_CAST &stripe[2048]
-			  );
-	}
-	
-
-       // write a full stripe
-        offset=0, bwritten=0, btowrite=(4*512);
-
-        do
-        {
-            bwritten=fwrite(&stripe[offset], 1, btowrite, fdout); 
-            offset+=bwritten;
-            btowrite=(4*512)-bwritten;
-        }
-        while ((btowrite > 0));
+        perror(outputFileName);
+        return ERROR;
+    }
 
+    if(openChunks(geom, fd, O_RDONLY, missingChunk, missingChunk2) == ERROR)
+    {
+        close(fdout);
+        return ERROR;
     }
 
+    stripe=malloc((size_t)nchunks*geom->chunkSize);
+    assert(stripe != NULL);
 
-    if(lastStripeBytes)
+    for(idx=0; idx < nchunks; idx++)
+        chunks[idx]=&stripe[(size_t)idx*geom->chunkSize];
+
+    if(missingChunk)
+        printf("will rebuild chunk %d\n", missingChunk);
+    if(missingChunk2)
+        printf("will rebuild chunk %d\n", missingChunk2);
+
+    while(remaining > 0)
     {
-        // read in the parital stripe + xor code
-        //
-        if(missingChunk == 1)
-	{
-		printf("will rebuild chunk 1\n");
-	}
-	else
-	{
-            offset=0, bread=0, btoread=(512);
-            do
-            {
-                bread=read(fd[0], &stripe[offset], 512); 
-                offset+=bread;
-                btoread=(512)-bread;
-            }
-            while (btoread > 0);
-	}
-
-        if(missingChunk == 2)
-	{
-		printf("will rebuild chunk 2\n");
-	}
-	else
-	{
-            offset=512, bread=0, btoread=(512);
-            do
-            {
-                bread=read(fd[1], &stripe[offset], 512); 
-                offset+=bread;
-                btoread=(512)-bread;
-            }
-            while (btoread > 0);
-	}
-
-        if(missingChunk == 3)
-	{
-		printf("will rebuild chunk 3\n");
-	}
-	else
-	{
-            offset=1024, bread=0, btoread=(512);
-            do
-            {
-                bread=read(fd[2], &stripe[offset], 512); 
-                offset+=bread;
-                btoread=(512)-bread;
-            }
-            while (btoread > 0);
-	}
-
-        if(missingChunk == 4)
-	{
-		printf("will rebuild chunk 4\n");
-	}
-	else
-	{
-            offset=1536, bread=0, btoread=(512);
-            do
-            {
-                bread=read(fd[3], &stripe[offset], 512); 
-                offset+=bread;
-                btoread=(512)-bread;
-            }
-            while (btoread > 0);
-	}
-
-
-        if(missingChunk == 5)
-	{
-		printf("will rebuild chunk 5\n");
-	}
-	else
-	{
-            offset=2048, bread=0, btoread=(512);
-            do
+        // read in the stripe + parity
+        for(idx=0; idx < nchunks; idx++)
+        {
+            if(fd[idx] < 0) continue;
+
+            if(readFully(fd[idx], chunks[idx], geom->chunkSize) != geom->chunkSize)
             {
-                bread=read(fd[4], &stripe[offset], 512); 
-                offset+=bread;
-                btoread=(512)-bread;
+                printf("restoreFileGeom: short chunk %d\n", idx+1);
+                rc=ERROR;
+                goto done;
             }
-            while (btoread > 0);
-	}
-
-        // OPTION - check XOR here
-        //
-	if(missingChunk == 1)
-	{
-		rebuildLBA( PTR_CAST &stripe[512], 
-			    PTR_CAST &stripe[1024], 
-			    PTR_CAST &stripe[1536], 
-			    PTR_CAST &stripe[2048], 
-			    PTR_CAST &stripe[0]);
-	}
-
-	if(missingChunk == 2)
-	{
-		rebuildLBA( PTR_CAST &stripe[0], 
-		  	    PTR_CAST &stripe[1024], 
-			    PTR_CAST &stripe[1536], 
-			    PTR_CAST &stripe[2048], 
-			    PTR_CAST &stripe[512]);
-	}
-	if(missingChunk == 3)
-	{
-		rebuildLBA(
-			   PTR_CAST &stripe[0],
-		           PTR_CAST &stripe[512],
-		           PTR_CAST &stripe[1536],
-		           PTR_CAST &stripe[2048],
-		           PTR_CAST &stripe[1024]
-			  );
-	}
-	if(missingChunk == 4)
-	{
-		rebuildLBA(
-			   PTR_CAST &stripe[0],
-		           PTR_CAST &stripe[512],
-		           PTR_CAST &stripe[1024],
-		           PTR_CAST &stripe[2048],
-		           PTR_CAST &stripe[1536]
-			  );
-	}
-	if(missingChunk == 5)
-	{
-		rebuildLBA(
-			   PTR_CAST &stripe[0],
-		           PTR_CAST &stripe[512],
-		           PTR_CAST &stripe[1024],
-		           PTR_CAST &stripe[1536],
-		           PTR_CAST &stripe[2048]
-			  );
-	}
-
-       // write a partial stripe
-        offset=0, bwritten=0, btowrite=(lastStripeBytes);
-
-        do
+        }
+
+        stripeRebuild(geom, chunks, missingChunk, missingChunk2);
+
+        // write a full or final partial stripe
+        btowrite=(remaining < stripeBytes) ? remaining : stripeBytes;
+
+        if(writeFully(fdout, stripe, btowrite) == ERROR)
         {
-            bwritten=fwrite(&stripe[offset], 1, btowrite, fdout); 
-            offset+=bwritten;
-            btowrite=lastStripeBytes-bwritten;
+            rc=ERROR;
+            goto done;
         }
-        while ((btowrite > 0));
+
+        remaining-=btowrite;
     }
 
+done:
+    free(stripe);
+    close(fdout);
+    closeChunks(geom, fd);
+
+    return((rc == OK) ? fileLength : ERROR);
+}
+
+
+// returns bytes written or ERROR code
+//
+// Original 4+1 interface with 512 byte chunks, offsetSectors is not used.
+//
+int stripeFile(char *inputFileName, int offsetSectors)
+{
+    stripeGeom_t geom;
 
-    fclose(fdout);
-    for(idx=0; idx < 5; idx++) close(fd[idx]);
+    stripeGeomLegacy(&geom);
 
-    return(fileLength);
+    return((int)stripeFileGeom(&geom, inputFileName));
 }
 
+
+// returns bytes read or ERROR code
+//
+// missingChunk = 0 for no missing
+//              = 1 ... 4 for missing data chunk
+//              = 5 for missing XOR chunk
+//
+int restoreFile(char *outputFileName, int offsetSectors, int fileLength, int missingChunk)
+{
+    stripeGeom_t geom;
+
+    stripeGeomLegacy(&geom);
+
+    return((int)restoreFileGeom(&geom, outputFileName, fileLength, missingChunk));
+}
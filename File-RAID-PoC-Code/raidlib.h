@@ -2,6 +2,8 @@
 #define RAIDLIB_H
 
 #include <unistd.h>
+#include <stddef.h>
+#include <pthread.h>
 
 #define OK (0)
 #define ERROR (-1)
@@ -10,6 +12,30 @@
 
 #define SECTOR_SIZE (512)
 
+// Parity kernel variants, selected at startup from CPUID
+#define RAID_KERNEL_AUTO (-1)
+#define RAID_KERNEL_SCALAR (0)
+#define RAID_KERNEL_SSE2 (1)
+#define RAID_KERNEL_AVX2 (2)
+#define RAID_KERNEL_AVX512 (3)
+#define RAID_KERNEL_COUNT (4)
+
+// Stripe geometry limits for stripeGeomInit()
+#define RAID_MIN_DATA_CHUNKS (3)
+#define RAID_MAX_DATA_CHUNKS (32)
+#define RAID_MIN_CHUNK_SIZE (4*1024)
+#define RAID_MAX_CHUNK_SIZE (1024*1024)
+
+#define RAID_LEVEL_5 (5)
+#define RAID_LEVEL_6 (6)
+
+typedef struct
+{
+    int dataChunks;   // data chunk files per stripe
+    int parityChunks; // 1 for RAID-5 (P), 2 for RAID-6 (P+Q)
+    int chunkSize;    // bytes per chunk file per stripe
+} stripeGeom_t;
+
 void xorLBA(unsigned char *LBA1,
 	    unsigned char *LBA2,
 	    unsigned char *LBA3,
@@ -23,9 +49,106 @@ void rebuildLBA(unsigned char *LBA1,
 	        unsigned char *RLBA);
 
 
+// raidkern.c - dst = XOR of all nsrcs source blocks of len bytes
+void xorBlocks(unsigned char **srcs, int nsrcs, unsigned char *dst, size_t len);
+int xorBlocksKernel(int kernel, unsigned char **srcs, int nsrcs, unsigned char *dst, size_t len);
+int raidSelectKernel(int kernel);
+int raidSelectedKernel(void);
+int raidKernelSupported(int kernel);
+const char *raidKernelName(int kernel);
+
+
+// raid6.c - P+Q over GF(2^8), chunks are data 0...n-1, then P, then Q
+void raid6GenPQ(unsigned char **data, int ndata, unsigned char *P, unsigned char *Q, size_t len);
+int raid6GenPQKernel(int kernel, unsigned char **data, int ndata,
+                     unsigned char *P, unsigned char *Q, size_t len);
+int raid6Recover(unsigned char **chunks, int ndata, size_t len, int failA, int failB);
+int raid6RecoverKernel(int kernel, unsigned char **chunks, int ndata, size_t len, int failA, int failB);
+void raid6UpdateQ(unsigned char *Q, unsigned char *delta, int dataIdx, size_t len);
+
+
 int checkEquivLBA(unsigned char *LBA1,
 		  unsigned char *LBA2);
 
+ssize_t readFully(int fd, unsigned char *buffer, size_t len);
+ssize_t writeFully(int fd, unsigned char *buffer, size_t len);
+
+int stripeGeomInit(stripeGeom_t *geom, int dataChunks, int chunkSize);
+int stripeGeomSetLevel(stripeGeom_t *geom, int raidLevel);
+void stripeChunkName(stripeGeom_t *geom, int chunk, char *name, size_t nameLen);
+int openChunks(stripeGeom_t *geom, int *fd, int flags, int skipChunk, int skipChunk2);
+void closeChunks(stripeGeom_t *geom, int *fd);
+void stripeEncode(stripeGeom_t *geom, unsigned char **chunks);
+void stripeRebuild(stripeGeom_t *geom, unsigned char **chunks, int missingChunk, int missingChunk2);
+int stripeCheckMissing(stripeGeom_t *geom, int *missingChunk, int *missingChunk2);
+long long stripeFileGeom(stripeGeom_t *geom, char *inputFileName);
+long long restoreFileGeom(stripeGeom_t *geom, char *outputFileName, long long fileLength, int missingChunk);
+long long restoreFileGeom2(stripeGeom_t *geom, char *outputFileName, long long fileLength,
+                           int missingChunk, int missingChunk2);
+
+// raidpool.c - parity for batches of contiguous stripes on pinned worker threads
+typedef struct parityPool parityPool_t;
+
+parityPool_t *parityPoolCreate(int nthreads);
+void parityPoolDestroy(parityPool_t *pool);
+int parityPoolThreads(parityPool_t *pool);
+void parityPoolEncode(parityPool_t *pool, stripeGeom_t *geom, unsigned char *stripes, long long nstripes);
+int stripeEncodeBatch(stripeGeom_t *geom, unsigned char *stripes, long long nstripes, int nthreads);
+
+// raidasync.c - stripes kept in flight with io_uring or a chunk I/O thread pool
+#define RAID_ASYNC_AUTO (0)
+#define RAID_ASYNC_URING (1)
+#define RAID_ASYNC_THREADS (2)
+#define RAID_ASYNC_DEPTH (8)
+
+long long stripeFileAsync(stripeGeom_t *geom, char *inputFileName, int engine, int depth);
+long long restoreFileAsync(stripeGeom_t *geom, char *outputFileName, long long fileLength,
+                           int missingChunk, int missingChunk2, int engine, int depth);
+
+// raidmmap.c - input, chunk files and output memory mapped, no stripe buffers
+long long stripeFileMmap(stripeGeom_t *geom, char *inputFileName);
+long long restoreFileMmap(stripeGeom_t *geom, char *outputFileName, long long fileLength,
+                          int missingChunk, int missingChunk2);
+
+// raidupdate.c - read-modify-write of part of an existing striped set
+long long updateRange(stripeGeom_t *geom, long long fileLength, long long offset, size_t len,
+                      unsigned char *data);
+
+// raidscrub.c - background parity verification, rate limited and low priority
+#define SCRUB_MAX_REPORT (64)
+
+typedef struct
+{
+    double maxMBps;          // read rate cap, 0 for none
+    int idle;                // TRUE for SCHED_IDLE and idle I/O priority
+    int niceValue;           // otherwise nice value for the scrub thread, 0 to leave
+    int verbose;             // print each mismatching stripe
+} scrubConfig_t;
+
+typedef struct
+{
+    long long stripes;
+    long long bytes;
+    long long mismatches;
+    long long mismatchStripes[SCRUB_MAX_REPORT];
+    double secs;
+} scrubReport_t;
+
+typedef struct
+{
+    stripeGeom_t geom;
+    scrubConfig_t config;
+    scrubReport_t report;
+    pthread_t thread;
+    volatile int stop;
+    int rc;
+} scrubJob_t;
+
+int scrubSet(stripeGeom_t *geom, scrubConfig_t *config, scrubReport_t *report, volatile int *stop);
+int scrubStart(scrubJob_t *job);
+void scrubStop(scrubJob_t *job);
+int scrubWait(scrubJob_t *job);
+
 int stripeFile(char *inputFileName, int offsetSectors);
 int restoreFile(char *outputFileName, int offsetSectors, int fileLength, int missingChunk);
 
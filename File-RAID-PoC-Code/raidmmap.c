@@ -0,0 +1,282 @@
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "raidlib.h"
+
+
+// Memory mapped stripe and restore
+//
+// The input, every chunk file and the output are mapped, and the parity and
+// rebuild kernels run straight over the mapped pages, so there are no stack
+// or heap stripe buffers and no read()/write() calls per chunk.  Striping
+// copies each data chunk once from the input mapping to its chunk file
+// mapping and XORs the parity directly from the input pages.  Restore copies
+// each surviving data chunk once to the output mapping and rebuilds a lost one
+// directly into the output pages.
+//
+// All mappings get MADV_SEQUENTIAL so the kernel reads ahead aggressively and
+// drops pages behind us.  Only the final partial stripe goes through a bounce
+// buffer, since the input or output ends part way through it.
+//
+// Needs the whole of each file in the address space, so this is for 64 bit
+// hosts when files are larger than a few hundred MB.
+//
+
+static unsigned char *mapFile(int fd, size_t len, int prot)
+{
+    unsigned char *map;
+
+    if(len == 0)
+        return NULL;
+
+    map=mmap(NULL, len, prot, MAP_SHARED, fd, 0);
+    if(map == MAP_FAILED)
+    {
+        perror("mmap");
+        return MAP_FAILED;
+    }
+
+    madvise(map, len, MADV_SEQUENTIAL);
+
+    return map;
+}
+
+
+static void unmapChunks(unsigned char **maps, int nchunks, size_t len)
+{
+    int idx;
+
+    for(idx=0; idx<nchunks; idx++)
+        if((maps[idx] != NULL) && (maps[idx] != MAP_FAILED))
+            munmap(maps[idx], len);
+}
+
+
+// returns bytes striped or ERROR code
+//
+long long stripeFileMmap(stripeGeom_t *geom, char *inputFileName)
+{
+    int fd[RAID_MAX_DATA_CHUNKS+2], fdin, idx, rc=OK;
+    int nchunks=geom->dataChunks+geom->parityChunks;
+    unsigned char *input, *maps[RAID_MAX_DATA_CHUNKS+2], *srcs[RAID_MAX_DATA_CHUNKS+2];
+    unsigned char *bounce=NULL;
+    size_t stripeBytes=(size_t)geom->dataChunks*geom->chunkSize, chunkOffset, chunkFileLen;
+    long long fileLength, nstripes, stripe;
+    struct stat st;
+
+    if((fdin=open(inputFileName, O_RDONLY)) < 0)
+    {
+        perror(inputFileName);
+        return ERROR;
+    }
+
+    if(fstat(fdin, &st) < 0)
+    {
+        perror(inputFileName);
+        close(fdin);
+        return ERROR;
+    }
+    fileLength=st.st_size;
+    nstripes=(fileLength+stripeBytes-1)/stripeBytes;
+    chunkFileLen=(size_t)nstripes*geom->chunkSize;
+
+    if(openChunks(geom, fd, O_RDWR | O_CREAT | O_TRUNC, 0, 0) == ERROR)
+    {
+        close(fdin);
+        return ERROR;
+    }
+
+    memset(maps, 0, sizeof(maps));
+    input=mapFile(fdin, fileLength, PROT_READ);
+    if(input == MAP_FAILED) rc=ERROR;
+
+    for(idx=0; (idx<nchunks) && (rc == OK); idx++)
+    {
+        if(ftruncate(fd[idx], chunkFileLen) < 0)
+        {
+            perror("ftruncate");
+            rc=ERROR;
+        }
+        else if((maps[idx]=mapFile(fd[idx], chunkFileLen, PROT_READ | PROT_WRITE)) == MAP_FAILED)
+        {
+            rc=ERROR;
+        }
+    }
+
+    for(stripe=0; (stripe<nstripes) && (rc == OK); stripe++)
+    {
+        chunkOffset=(size_t)stripe*geom->chunkSize;
+
+        if((stripe+1)*(long long)stripeBytes <= fileLength)
+        {
+            for(idx=0; idx<geom->dataChunks; idx++)
+                srcs[idx]=&input[stripe*stripeBytes + (size_t)idx*geom->chunkSize];
+        }
+        else
+        {
+            // last partial stripe, zero padded as the synchronous path does
+            printf("hit end of file\n");
+            if((bounce=calloc(1, stripeBytes)) == NULL)
+            {
+                perror("stripeFileMmap");
+                rc=ERROR;
+                break;
+            }
+            memcpy(bounce, &input[stripe*stripeBytes], fileLength-stripe*stripeBytes);
+
+            for(idx=0; idx<geom->dataChunks; idx++)
+                srcs[idx]=&bounce[(size_t)idx*geom->chunkSize];
+        }
+
+        for(idx=0; idx<geom->dataChunks; idx++)
+            memcpy(&maps[idx][chunkOffset], srcs[idx], geom->chunkSize);
+
+        if(geom->parityChunks == 2)
+            raid6GenPQ(srcs, geom->dataChunks, &maps[geom->dataChunks][chunkOffset],
+                       &maps[geom->dataChunks+1][chunkOffset], geom->chunkSize);
+        else
+            xorBlocks(srcs, geom->dataChunks, &maps[geom->dataChunks][chunkOffset], geom->chunkSize);
+    }
+
+    free(bounce);
+    unmapChunks(maps, nchunks, chunkFileLen);
+    if((input != NULL) && (input != MAP_FAILED)) munmap(input, fileLength);
+    close(fdin);
+    closeChunks(geom, fd);
+
+    return((rc == OK) ? fileLength : ERROR);
+}
+
+
+// returns bytes restored or ERROR code, missing chunks as restoreFileGeom2()
+//
+long long restoreFileMmap(stripeGeom_t *geom, char *outputFileName, long long fileLength,
+                          int missingChunk, int missingChunk2)
+{
+    int fd[RAID_MAX_DATA_CHUNKS+2], fdout, idx, rc=OK;
+    int nchunks=geom->dataChunks+geom->parityChunks;
+    unsigned char *output=NULL, *maps[RAID_MAX_DATA_CHUNKS+2], *chunks[RAID_MAX_DATA_CHUNKS+2];
+    unsigned char *scratch, *bounce;
+    size_t stripeBytes=(size_t)geom->dataChunks*geom->chunkSize, chunkOffset, chunkFileLen;
+    long long nstripes, stripe, lastBytes;
+    struct stat st;
+
+    if(stripeCheckMissing(geom, &missingChunk, &missingChunk2) == ERROR)
+        return ERROR;
+
+    nstripes=(fileLength+stripeBytes-1)/stripeBytes;
+    chunkFileLen=(size_t)nstripes*geom->chunkSize;
+
+    if((fdout=open(outputFileName, O_RDWR | O_CREAT | O_TRUNC, 00644)) < 0)
+    {
+        perror(outputFileName);
+        return ERROR;
+    }
+
+    if(openChunks(geom, fd, O_RDONLY, missingChunk, missingChunk2) == ERROR)
+    {
+        close(fdout);
+        return ERROR;
+    }
+
+    // scratch for lost parity chunks, a bounce stripe for the partial one
+    scratch=malloc((size_t)2*geom->chunkSize);
+    bounce=malloc((size_t)nchunks*geom->chunkSize);
+
+    if((scratch == NULL) || (bounce == NULL))
+    {
+        perror("restoreFileMmap");
+        rc=ERROR;
+    }
+
+    memset(maps, 0, sizeof(maps));
+    for(idx=0; (idx<nchunks) && (rc == OK); idx++)
+    {
+        if(fd[idx] < 0) continue;
+
+        if(fstat(fd[idx], &st) < 0)
+        {
+            perror("restoreFileMmap");
+            rc=ERROR;
+        }
+        else if(st.st_size < chunkFileLen)
+        {
+            printf("restoreFileMmap: short chunk %d\n", idx+1);
+            rc=ERROR;
+        }
+        else if((maps[idx]=mapFile(fd[idx], chunkFileLen, PROT_READ)) == MAP_FAILED)
+        {
+            rc=ERROR;
+        }
+    }
+
+    if((rc == OK) && (ftruncate(fdout, fileLength) < 0))
+    {
+        perror("ftruncate");
+        rc=ERROR;
+    }
+
+    if((rc == OK) && ((output=mapFile(fdout, fileLength, PROT_READ | PROT_WRITE)) == MAP_FAILED))
+        rc=ERROR;
+
+    if(missingChunk)
+        printf("will rebuild chunk %d\n", missingChunk);
+    if(missingChunk2)
+        printf("will rebuild chunk %d\n", missingChunk2);
+
+    for(stripe=0; (stripe<nstripes) && (rc == OK); stripe++)
+    {
+        chunkOffset=(size_t)stripe*geom->chunkSize;
+        lastBytes=fileLength-stripe*(long long)stripeBytes;
+
+        for(idx=0; idx<nchunks; idx++)
+        {
+            if(lastBytes < stripeBytes)
+            {
+                // partial stripe - rebuild in the bounce buffer
+                chunks[idx]=&bounce[(size_t)idx*geom->chunkSize];
+                if(maps[idx] != NULL)
+                    memcpy(chunks[idx], &maps[idx][chunkOffset], geom->chunkSize);
+            }
+            else if(maps[idx] != NULL)
+            {
+                chunks[idx]=&maps[idx][chunkOffset];
+            }
+            else if(idx < geom->dataChunks)
+            {
+                // lost data is rebuilt straight into the output pages
+                chunks[idx]=&output[stripe*stripeBytes + (size_t)idx*geom->chunkSize];
+            }
+            else
+            {
+                chunks[idx]=&scratch[(size_t)(idx-geom->dataChunks)*geom->chunkSize];
+            }
+        }
+
+        stripeRebuild(geom, chunks, missingChunk, missingChunk2);
+
+        if(lastBytes < stripeBytes)
+        {
+            memcpy(&output[stripe*stripeBytes], bounce, lastBytes);
+            break;
+        }
+
+        for(idx=0; idx<geom->dataChunks; idx++)
+            if(maps[idx] != NULL)
+                memcpy(&output[stripe*stripeBytes + (size_t)idx*geom->chunkSize], chunks[idx], geom->chunkSize);
+    }
+
+    free(scratch);
+    free(bounce);
+    unmapChunks(maps, nchunks, chunkFileLen);
+    if((output != NULL) && (output != MAP_FAILED)) munmap(output, fileLength);
+    close(fdout);
+    closeChunks(geom, fd);
+
+    return((rc == OK) ? fileLength : ERROR);
+}
@@ -0,0 +1,252 @@
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "raidlib.h"
+
+
+// Parallel parity for batches of stripes
+//
+// A pool of worker threads, each pinned to its own CPU with the same
+// pthread_attr_setaffinity_np() approach as the simplethread-affinity
+// example, so a worker keeps its cache and the scheduler does not stack two
+// of them on one core.  Each batch is split into one contiguous range of
+// stripes per worker, so there is no sharing between workers beyond the
+// start and finish hand off.
+//
+// Stripes in a batch are laid out back to back, each one the data chunks
+// followed by the parity chunk(s), as stripeEncode() expects.
+//
+
+struct parityPool
+{
+    int nthreads;
+    pthread_t *threads;
+    pthread_mutex_t lock;
+    pthread_cond_t start;
+    pthread_cond_t done;
+
+    // current batch, guarded by lock
+    unsigned long generation;
+    int running;
+    int shutdown;
+    stripeGeom_t *geom;
+    unsigned char *stripes;
+    long long nstripes;
+};
+
+typedef struct
+{
+    parityPool_t *pool;
+    int threadIdx;
+} parityWorker_t;
+
+
+static void encodeRange(stripeGeom_t *geom, unsigned char *stripes, long long first, long long last)
+{
+    unsigned char *chunks[RAID_MAX_DATA_CHUNKS+2];
+    size_t stripeSize=(size_t)(geom->dataChunks+geom->parityChunks)*geom->chunkSize;
+    long long stripe;
+    int chunk;
+
+    for(stripe=first; stripe<last; stripe++)
+    {
+        for(chunk=0; chunk < geom->dataChunks+geom->parityChunks; chunk++)
+            chunks[chunk]=&stripes[stripe*stripeSize + (size_t)chunk*geom->chunkSize];
+
+        stripeEncode(geom, chunks);
+    }
+}
+
+
+static void *parityWorkerThread(void *threadp)
+{
+    parityWorker_t *worker=(parityWorker_t *)threadp;
+    parityPool_t *pool=worker->pool;
+    unsigned long seen=0;
+    long long first, last;
+
+    while(1)
+    {
+        pthread_mutex_lock(&pool->lock);
+        while(!pool->shutdown && (pool->generation == seen))
+            pthread_cond_wait(&pool->start, &pool->lock);
+
+        if(pool->shutdown)
+        {
+            pthread_mutex_unlock(&pool->lock);
+            break;
+        }
+
+        seen=pool->generation;
+        first=(pool->nstripes*worker->threadIdx)/pool->nthreads;
+        last=(pool->nstripes*(worker->threadIdx+1))/pool->nthreads;
+        pthread_mutex_unlock(&pool->lock);
+
+        encodeRange(pool->geom, pool->stripes, first, last);
+
+        pthread_mutex_lock(&pool->lock);
+        if(--pool->running == 0)
+            pthread_cond_signal(&pool->done);
+        pthread_mutex_unlock(&pool->lock);
+    }
+
+    free(worker);
+
+    return NULL;
+}
+
+
+// Create a pool of nthreads workers, 0 for one per CPU this process may
+// run on.  Worker i is pinned to the i-th of those CPUs, modulo their number,
+// so the pool works under taskset or a cgroup cpuset.
+//
+parityPool_t *parityPoolCreate(int nthreads)
+{
+    parityPool_t *pool;
+    parityWorker_t *worker;
+    pthread_attr_t attr;
+    cpu_set_t allowed, cpuset;
+    int cpus[CPU_SETSIZE];
+    int idx, rc, cpu, numCPUs=0;
+
+    if(sched_getaffinity(0, sizeof(cpu_set_t), &allowed) == 0)
+    {
+        for(cpu=0; cpu<CPU_SETSIZE; cpu++)
+            if(CPU_ISSET(cpu, &allowed))
+                cpus[numCPUs++]=cpu;
+    }
+
+    // no affinity to go on, take every online CPU
+    if(numCPUs == 0)
+    {
+        numCPUs=sysconf(_SC_NPROCESSORS_ONLN);
+        if(numCPUs < 1) numCPUs=1;
+        if(numCPUs > CPU_SETSIZE) numCPUs=CPU_SETSIZE;
+
+        for(cpu=0; cpu<numCPUs; cpu++)
+            cpus[cpu]=cpu;
+    }
+
+    if(nthreads < 1) nthreads=numCPUs;
+
+    if((pool=calloc(1, sizeof(parityPool_t))) == NULL)
+        return NULL;
+
+    if((pool->threads=calloc(nthreads, sizeof(pthread_t))) == NULL)
+    {
+        free(pool);
+        return NULL;
+    }
+
+    pool->nthreads=nthreads;
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->start, NULL);
+    pthread_cond_init(&pool->done, NULL);
+
+    for(idx=0; idx<nthreads; idx++)
+    {
+        if((worker=malloc(sizeof(parityWorker_t))) == NULL)
+        {
+            perror("parityPoolCreate");
+            pool->nthreads=idx;
+            parityPoolDestroy(pool);
+            return NULL;
+        }
+
+        worker->pool=pool;
+        worker->threadIdx=idx;
+
+        pthread_attr_init(&attr);
+        CPU_ZERO(&cpuset);
+        CPU_SET(cpus[idx % numCPUs], &cpuset);
+        pthread_attr_setaffinity_np(&attr, sizeof(cpu_set_t), &cpuset);
+
+        if((rc=pthread_create(&pool->threads[idx], &attr, parityWorkerThread, worker)) != 0)
+        {
+            fprintf(stderr, "pthread_create: %s\n", strerror(rc));
+            free(worker);
+            pool->nthreads=idx;
+            pthread_attr_destroy(&attr);
+            parityPoolDestroy(pool);
+            return NULL;
+        }
+
+        pthread_attr_destroy(&attr);
+    }
+
+    return pool;
+}
+
+
+void parityPoolDestroy(parityPool_t *pool)
+{
+    int idx;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->shutdown=TRUE;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+
+    for(idx=0; idx<pool->nthreads; idx++)
+        pthread_join(pool->threads[idx], NULL);
+
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->start);
+    pthread_cond_destroy(&pool->done);
+    free(pool->threads);
+    free(pool);
+}
+
+
+int parityPoolThreads(parityPool_t *pool)
+{
+    return pool->nthreads;
+}
+
+
+// Compute the parity of nstripes contiguous stripes on all the workers and
+// wait for them to finish.  Only one batch runs at a time on a pool.
+//
+void parityPoolEncode(parityPool_t *pool, stripeGeom_t *geom, unsigned char *stripes, long long nstripes)
+{
+    pthread_mutex_lock(&pool->lock);
+
+    pool->geom=geom;
+    pool->stripes=stripes;
+    pool->nstripes=nstripes;
+    pool->running=pool->nthreads;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->start);
+
+    while(pool->running > 0)
+        pthread_cond_wait(&pool->done, &pool->lock);
+
+    pthread_mutex_unlock(&pool->lock);
+}
+
+
+// One-shot batch on nthreads threads, for callers that don't keep a pool
+//
+int stripeEncodeBatch(stripeGeom_t *geom, unsigned char *stripes, long long nstripes, int nthreads)
+{
+    parityPool_t *pool;
+
+    if(nthreads == 1)
+    {
+        encodeRange(geom, stripes, 0, nstripes);
+        return OK;
+    }
+
+    if((pool=parityPoolCreate(nthreads)) == NULL)
+        return ERROR;
+
+    parityPoolEncode(pool, geom, stripes, nstripes);
+    parityPoolDestroy(pool);
+
+    return OK;
+}
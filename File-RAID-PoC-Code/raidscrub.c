@@ -0,0 +1,232 @@
+#define _GNU_SOURCE
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <assert.h>
+
+#include "raidlib.h"
+
+
+// Background parity scrub
+//
+// Streams every chunk file of a striped set, recomputes the parity of each
+// stripe with the same kernels used to write it and compares against the
+// stored parity, so latent errors are found while the set can still be
+// rebuilt.  Mismatching stripes are counted and the first SCRUB_MAX_REPORT
+// are listed in the report.
+//
+// So that a scrub can run alongside production load it can:
+//
+// 1) cap its own read rate in MB/s - after each stripe it sleeps until the
+//    time that many bytes should have taken at the cap
+// 2) drop to SCHED_IDLE with the idle I/O priority class, so it only gets
+//    CPU and disk time nothing else wants, or just raise its nice value
+//
+// Both apply only to the scrubbing thread, so scrubStart() can run it in the
+// background of a real-time process without changing the other threads.
+//
+
+#define IOPRIO_CLASS_SHIFT (13)
+#define IOPRIO_CLASS_IDLE (3)
+#define IOPRIO_WHO_PROCESS (1)
+
+
+static double monotonicSecs(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (double)now.tv_sec + (double)now.tv_nsec/1000000000.0;
+}
+
+
+static void scrubSetPriority(scrubConfig_t *config)
+{
+    struct sched_param param;
+    pid_t tid=syscall(SYS_gettid);
+
+    if(config->idle)
+    {
+        memset(&param, 0, sizeof(param));
+        if(pthread_setschedparam(pthread_self(), SCHED_IDLE, &param) != 0)
+            printf("scrub: could not set SCHED_IDLE\n");
+
+#ifdef SYS_ioprio_set
+        if(syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, tid, IOPRIO_CLASS_IDLE << IOPRIO_CLASS_SHIFT) < 0)
+            perror("scrub: ioprio_set");
+#endif
+    }
+    else if(config->niceValue)
+    {
+        // on Linux nice is per thread when given a thread id
+        if(setpriority(PRIO_PROCESS, tid, config->niceValue) < 0)
+            perror("scrub: setpriority");
+    }
+}
+
+
+// Sleep off any time we are ahead of the rate cap
+//
+static void scrubThrottle(scrubConfig_t *config, double startSecs, long long bytes)
+{
+    struct timespec delay;
+    double ahead;
+
+    if(config->maxMBps <= 0.0)
+        return;
+
+    ahead=((double)bytes/(config->maxMBps*1.0e6)) - (monotonicSecs()-startSecs);
+
+    if(ahead > 0.0)
+    {
+        delay.tv_sec=(time_t)ahead;
+        delay.tv_nsec=(long)((ahead-(double)delay.tv_sec)*1000000000.0);
+        while((nanosleep(&delay, &delay) < 0) && (errno == EINTR));
+    }
+}
+
+
+// returns number of mismatching stripes or ERROR, with details in report
+//
+// stop, if not NULL, is polled between stripes to end the scrub early
+//
+int scrubSet(stripeGeom_t *geom, scrubConfig_t *config, scrubReport_t *report, volatile int *stop)
+{
+    int fd[RAID_MAX_DATA_CHUNKS+2], idx, parity, rc=OK;
+    int nchunks=geom->dataChunks+geom->parityChunks;
+    unsigned char *stripe, *check, *chunks[RAID_MAX_DATA_CHUNKS+2];
+    long long nstripes, stripeIdx;
+    double startSecs;
+    struct stat st;
+
+    memset(report, 0, sizeof(scrubReport_t));
+
+    if(openChunks(geom, fd, O_RDONLY, 0, 0) == ERROR)
+        return ERROR;
+
+    scrubSetPriority(config);
+
+    if(fstat(fd[0], &st) < 0)
+    {
+        perror("scrubSet");
+        closeChunks(geom, fd);
+        return ERROR;
+    }
+    nstripes=st.st_size/geom->chunkSize;
+
+    // data + stored parity, then the recomputed parity after it
+    stripe=malloc((size_t)(nchunks+geom->parityChunks)*geom->chunkSize);
+    assert(stripe != NULL);
+
+    for(idx=0; idx<nchunks; idx++)
+        chunks[idx]=&stripe[(size_t)idx*geom->chunkSize];
+    check=&stripe[(size_t)nchunks*geom->chunkSize];
+
+    startSecs=monotonicSecs();
+
+    for(stripeIdx=0; (stripeIdx < nstripes) && (rc == OK); stripeIdx++)
+    {
+        if((stop != NULL) && *stop)
+            break;
+
+        for(idx=0; idx<nchunks; idx++)
+        {
+            if(readFully(fd[idx], chunks[idx], geom->chunkSize) != geom->chunkSize)
+            {
+                printf("scrub: short chunk %d at stripe %lld\n", idx+1, stripeIdx);
+                rc=ERROR;
+                break;
+            }
+        }
+        if(rc == ERROR) break;
+
+        // recompute parity into the check area by pointing the parity slots at it
+        for(parity=0; parity<geom->parityChunks; parity++)
+            chunks[geom->dataChunks+parity]=&check[(size_t)parity*geom->chunkSize];
+
+        stripeEncode(geom, chunks);
+
+        for(parity=0; parity<geom->parityChunks; parity++)
+            chunks[geom->dataChunks+parity]=&stripe[(size_t)(geom->dataChunks+parity)*geom->chunkSize];
+
+        for(parity=0; parity<geom->parityChunks; parity++)
+        {
+            if(memcmp(chunks[geom->dataChunks+parity], &check[(size_t)parity*geom->chunkSize], geom->chunkSize) != 0)
+            {
+                if(config->verbose)
+                    printf("scrub: stripe %lld %s parity mismatch\n", stripeIdx, (parity == 0) ? "XOR" : "Q");
+
+                if(report->mismatches < SCRUB_MAX_REPORT)
+                    report->mismatchStripes[report->mismatches]=stripeIdx;
+                report->mismatches++;
+                break;
+            }
+        }
+
+        report->stripes++;
+        report->bytes+=(long long)nchunks*geom->chunkSize;
+
+        scrubThrottle(config, startSecs, report->bytes);
+    }
+
+    report->secs=monotonicSecs()-startSecs;
+
+    free(stripe);
+    closeChunks(geom, fd);
+
+    return (rc == OK) ? (int)report->mismatches : ERROR;
+}
+
+
+static void *scrubThread(void *arg)
+{
+    scrubJob_t *job=(scrubJob_t *)arg;
+
+    job->rc=scrubSet(&job->geom, &job->config, &job->report, &job->stop);
+
+    return NULL;
+}
+
+
+// Run scrubSet() on its own thread, job must stay valid until scrubWait()
+//
+int scrubStart(scrubJob_t *job)
+{
+    job->stop=FALSE;
+    job->rc=OK;
+
+    if(pthread_create(&job->thread, NULL, scrubThread, job) != 0)
+    {
+        perror("scrubStart");
+        return ERROR;
+    }
+
+    return OK;
+}
+
+
+void scrubStop(scrubJob_t *job)
+{
+    job->stop=TRUE;
+}
+
+
+// returns the scrubSet() result
+//
+int scrubWait(scrubJob_t *job)
+{
+    pthread_join(job->thread, NULL);
+
+    return job->rc;
+}
@@ -181,6 +181,102 @@ int main(int argc, char *argv[])
         //
         // END TEST CASE #2
 
+
+        // TEST CASE #3
+        //
+        // RAID-6 - compute P+Q over the 4 test LBAs, then lose every possible
+        // pair of the 6 chunks and verify both are rebuilt.
+        //
+        printf("TEST CASE 3 (RAID-6 P+Q double rebuild):\n");
+        {
+            unsigned char chunk[6][SECTOR_SIZE], saved[6][SECTOR_SIZE];
+            unsigned char *chunks[6];
+            int failA, failB;
+
+            memcpy(chunk[0], &testLBA1[1], SECTOR_SIZE);
+            memcpy(chunk[1], &testLBA2[2], SECTOR_SIZE);
+            memcpy(chunk[2], &testLBA3[3], SECTOR_SIZE);
+            memcpy(chunk[3], &testLBA4[4], SECTOR_SIZE);
+            for(idx=0; idx < 6; idx++) chunks[idx]=chunk[idx];
+
+            raid6GenPQ(chunks, 4, chunks[4], chunks[5], SECTOR_SIZE);
+            memcpy(saved, chunk, sizeof(chunk));
+
+            for(failA=0; failA < 6; failA++)
+            {
+                for(failB=failA+1; failB < 6; failB++)
+                {
+                    memset(chunk[failA], 0xff, SECTOR_SIZE);
+                    memset(chunk[failB], 0xff, SECTOR_SIZE);
+
+                    rc=raid6Recover(chunks, 4, SECTOR_SIZE, failA, failB);
+                    assert(rc == OK);
+                    assert(memcmp(chunk, saved, sizeof(chunk)) == 0);
+                    printf("%d+%d ", failA+1, failB+1);
+                }
+            }
+            printf("\n");
+        }
+        //
+        // END TEST CASE #3
+
+
+        // TEST CASE #4
+        //
+        // Incremental update - stripe a file built from the test LBAs as a
+        // 3+2 RAID-6 set, apply updateRange() at unaligned offsets that span
+        // chunk and stripe boundaries, then lose two data chunks and check the
+        // restored file matches the updated data.
+        //
+        printf("TEST CASE 4 (read-modify-write parity update):\n");
+        {
+            stripeGeom_t geom;
+            unsigned char *expected, *restored;
+            long long fileLength=20*RAID_MIN_CHUNK_SIZE+100, offset;
+            size_t len;
+            FILE *fp;
+
+            expected=malloc(fileLength);
+            restored=malloc(fileLength);
+            assert((expected != NULL) && (restored != NULL));
+            for(offset=0; offset < fileLength; offset++)
+                expected[offset]=testLBA1[(offset/SECTOR_SIZE) % MAX_LBAS][offset % SECTOR_SIZE] ^ (offset >> 9);
+
+            fp=fopen("UpdateTest.bin", "w");
+            assert(fwrite(expected, 1, fileLength, fp) == fileLength);
+            fclose(fp);
+
+            stripeGeomInit(&geom, 3, RAID_MIN_CHUNK_SIZE);
+            stripeGeomSetLevel(&geom, RAID_LEVEL_6);
+            assert(stripeFileGeom(&geom, "UpdateTest.bin") == fileLength);
+
+            for(idx=0; idx < 50; idx++)
+            {
+                offset=(idx*7919LL) % (fileLength-1);
+                len=(idx*3*RAID_MIN_CHUNK_SIZE/7) % (fileLength-offset) + 1;
+                memset(&expected[offset], idx+1, len);
+                assert(updateRange(&geom, fileLength, offset, len, &expected[offset]) == len);
+            }
+
+            // past the end of the original file, into the last stripe's padding
+            assert(updateRange(&geom, fileLength, fileLength-10, 20, expected) == ERROR);
+
+            unlink("StripeChunk1.bin");
+            unlink("StripeChunk3.bin");
+            assert(restoreFileGeom2(&geom, "UpdateTest.NEW", fileLength, 1, 3) == fileLength);
+
+            fp=fopen("UpdateTest.NEW", "r");
+            assert(fread(restored, 1, fileLength, fp) == fileLength);
+            fclose(fp);
+            assert(memcmp(restored, expected, fileLength) == 0);
+            printf("%d updates verified after double rebuild\n", idx);
+
+            free(expected);
+            free(restored);
+        }
+        //
+        // END TEST CASE #4
+
         printf("FINISHED\n");
 
         
@@ -0,0 +1,218 @@
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "raidlib.h"
+
+
+// Incremental read-modify-write update of a striped set
+//
+// Rewrites len bytes of the original file at offset without touching the rest
+// of the set.  Parity is linear, so for each changed data chunk range
+//
+//     delta = old data ^ new data
+//     P'    = P ^ delta
+//     Q'    = Q ^ g^i * delta          (RAID-6, data chunk i)
+//
+// and only the changed data bytes and the same byte range of the parity
+// chunks are read and written - O(changed bytes), not O(file).  When several
+// data chunks of one stripe change, their deltas are folded together so the
+// parity range of that stripe is read and written once.
+//
+// Like any RAID-5/6 small write this is not atomic - a crash between the data
+// and parity writes leaves that stripe inconsistent until it is re-striped
+// or scrubbed.
+//
+
+static int preadFully(int fd, unsigned char *buffer, size_t len, long long offset)
+{
+    size_t done=0;
+    ssize_t rc;
+
+    while(done < len)
+    {
+        rc=pread(fd, &buffer[done], len-done, offset+done);
+
+        if(rc < 0)
+        {
+            perror("updateRange read");
+            return ERROR;
+        }
+
+        if(rc == 0)
+        {
+            printf("updateRange: chunk file ends at %lld\n", offset+(long long)done);
+            return ERROR;
+        }
+
+        done+=rc;
+    }
+
+    return OK;
+}
+
+
+static int pwriteFully(int fd, unsigned char *buffer, size_t len, long long offset)
+{
+    size_t done=0;
+    ssize_t rc;
+
+    while(done < len)
+    {
+        rc=pwrite(fd, &buffer[done], len-done, offset+done);
+
+        if(rc < 0)
+        {
+            perror("updateRange write");
+            return ERROR;
+        }
+
+        done+=rc;
+    }
+
+    return OK;
+}
+
+
+// Apply the accumulated parity deltas for bytes [lo, hi) of one stripe
+//
+static int updateParity(stripeGeom_t *geom, int *fd, long long stripe, size_t lo, size_t hi,
+                        unsigned char *pdelta, unsigned char *qdelta, unsigned char *old)
+{
+    unsigned char *srcs[2];
+    long long chunkOffset=stripe*geom->chunkSize+lo;
+    int parity;
+
+    for(parity=0; parity<geom->parityChunks; parity++)
+    {
+        if(preadFully(fd[geom->dataChunks+parity], old, hi-lo, chunkOffset) == ERROR)
+            return ERROR;
+
+        srcs[0]=old;
+        srcs[1]=(parity == 0) ? &pdelta[lo] : &qdelta[lo];
+        xorBlocks(srcs, 2, old, hi-lo);
+
+        if(pwriteFully(fd[geom->dataChunks+parity], old, hi-lo, chunkOffset) == ERROR)
+            return ERROR;
+    }
+
+    return OK;
+}
+
+
+// returns bytes updated or ERROR code
+//
+// The range must lie within the fileLength bytes of the original file, as
+// passed to restoreFileGeom(), so nothing is written to the zero padding of
+// the last stripe and the file never grows.
+//
+long long updateRange(stripeGeom_t *geom, long long fileLength, long long offset, size_t len,
+                      unsigned char *data)
+{
+    int fd[RAID_MAX_DATA_CHUNKS+2], chunk, rc=OK;
+    unsigned char *old, *delta, *pdelta, *qdelta, *srcs[2];
+    size_t stripeBytes=(size_t)geom->dataChunks*geom->chunkSize, inStripe, inChunk, seg;
+    size_t lo=0, hi=0, done=0;
+    long long stripe, curStripe=-1, capacity;
+    struct stat st;
+
+    if((offset < 0) || (len > (size_t)fileLength) || (offset > fileLength-(long long)len))
+    {
+        printf("updateRange: %lld+%zu outside the original %lld bytes\n", offset, len, fileLength);
+        return ERROR;
+    }
+
+    if(openChunks(geom, fd, O_RDWR, 0, 0) == ERROR)
+        return ERROR;
+
+    if(fstat(fd[0], &st) < 0)
+    {
+        perror("updateRange fstat");
+        closeChunks(geom, fd);
+        return ERROR;
+    }
+
+    capacity=(st.st_size/geom->chunkSize)*(long long)stripeBytes;
+
+    if(fileLength > capacity)
+    {
+        printf("updateRange: original %lld bytes beyond striped set of %lld bytes\n", fileLength, capacity);
+        closeChunks(geom, fd);
+        return ERROR;
+    }
+
+    old=malloc(geom->chunkSize);
+    delta=malloc(geom->chunkSize);
+    pdelta=malloc(geom->chunkSize);
+    qdelta=malloc(geom->chunkSize);
+    assert((old != NULL) && (delta != NULL) && (pdelta != NULL) && (qdelta != NULL));
+
+    while((done < len) && (rc == OK))
+    {
+        stripe=(offset+done)/stripeBytes;
+        inStripe=(offset+done)%stripeBytes;
+        chunk=inStripe/geom->chunkSize;
+        inChunk=inStripe%geom->chunkSize;
+        seg=geom->chunkSize-inChunk;
+        if(seg > len-done) seg=len-done;
+
+        // moved on to a new stripe - settle the parity of the last one
+        if(stripe != curStripe)
+        {
+            if(curStripe >= 0)
+                rc=updateParity(geom, fd, curStripe, lo, hi, pdelta, qdelta, old);
+
+            memset(pdelta, 0, geom->chunkSize);
+            memset(qdelta, 0, geom->chunkSize);
+            lo=inChunk;
+            hi=inChunk+seg;
+            curStripe=stripe;
+        }
+
+        if(inChunk < lo) lo=inChunk;
+        if(inChunk+seg > hi) hi=inChunk+seg;
+
+        // delta = old ^ new, then write the new data
+        if((rc == OK) &&
+           (preadFully(fd[chunk], old, seg, stripe*geom->chunkSize+inChunk) == ERROR))
+            rc=ERROR;
+
+        if(rc == OK)
+        {
+            srcs[0]=old;
+            srcs[1]=&data[done];
+            xorBlocks(srcs, 2, delta, seg);
+
+            srcs[0]=&pdelta[inChunk];
+            srcs[1]=delta;
+            xorBlocks(srcs, 2, &pdelta[inChunk], seg);
+
+            if(geom->parityChunks == 2)
+                raid6UpdateQ(&qdelta[inChunk], delta, chunk, seg);
+
+            if(pwriteFully(fd[chunk], &data[done], seg, stripe*geom->chunkSize+inChunk) == ERROR)
+                rc=ERROR;
+        }
+
+        if(rc == OK) done+=seg;
+    }
+
+    if((rc == OK) && (curStripe >= 0))
+        rc=updateParity(geom, fd, curStripe, lo, hi, pdelta, qdelta, old);
+
+    // the failing read or write has said why
+    if(rc == ERROR)
+        printf("updateRange: stopped after %zu of %zu bytes\n", done, len);
+
+    free(old);
+    free(delta);
+    free(pdelta);
+    free(qdelta);
+    closeChunks(geom, fd);
+
+    return((rc == OK) ? (long long)len : ERROR);
+}
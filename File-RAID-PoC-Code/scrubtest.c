@@ -0,0 +1,66 @@
+#include <sys/time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "raidlib.h"
+
+
+// Scrub the chunk files left by stripetest with the same geometry, in the
+// background of this process, and list any stripes whose parity is wrong
+//
+int main(int argc, char *argv[])
+{
+    scrubJob_t job;
+    int dataChunks, chunkSize, raidLevel=RAID_LEVEL_5, idx, rc;
+
+    if(argc < 3)
+    {
+        printf("useage: scrubtest <data chunks> <chunk bytes> [raid level 5|6] [MB/s cap] [idle|nice <n>]\n");
+        exit(-1);
+    }
+
+    memset(&job, 0, sizeof(job));
+
+    sscanf(argv[1], "%d", &dataChunks);
+    sscanf(argv[2], "%d", &chunkSize);
+    if(argc >= 4) sscanf(argv[3], "%d", &raidLevel);
+    if(argc >= 5) sscanf(argv[4], "%lf", &job.config.maxMBps);
+
+    if(argc >= 6)
+    {
+        if(strcmp(argv[5], "idle") == 0) job.config.idle=TRUE;
+        else if((strcmp(argv[5], "nice") == 0) && (argc >= 7)) sscanf(argv[6], "%d", &job.config.niceValue);
+    }
+
+    job.config.verbose=TRUE;
+
+    if((stripeGeomInit(&job.geom, dataChunks, chunkSize) == ERROR) ||
+       (stripeGeomSetLevel(&job.geom, raidLevel) == ERROR))
+        exit(-1);
+
+    printf("scrubbing %d+%d set of %d byte chunks, cap %.1lf MB/s%s\n",
+           job.geom.dataChunks, job.geom.parityChunks, job.geom.chunkSize, job.config.maxMBps,
+           job.config.idle ? ", SCHED_IDLE" : "");
+
+    if(scrubStart(&job) == ERROR)
+        exit(-1);
+
+    rc=scrubWait(&job);
+
+    if(rc == ERROR)
+    {
+        printf("scrub failed\n");
+        exit(-1);
+    }
+
+    printf("scrubbed %lld stripes, %lld bytes in %lf secs (%lf MB/s), %lld mismatched\n",
+           job.report.stripes, job.report.bytes, job.report.secs,
+           (job.report.secs > 0.0) ? ((double)job.report.bytes/1.0e6)/job.report.secs : 0.0,
+           job.report.mismatches);
+
+    for(idx=0; (idx < job.report.mismatches) && (idx < SCRUB_MAX_REPORT); idx++)
+        printf("stripe %lld\n", job.report.mismatchStripes[idx]);
+
+    return (rc == 0) ? 0 : 1;
+}
@@ -1,20 +1,82 @@
+#include <sys/time.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "raidlib.h"
 
+
+double elapsedSecs(struct timeval *StartTime, struct timeval *StopTime)
+{
+    return ((double)(StopTime->tv_sec - StartTime->tv_sec)) +
+           (((double)(StopTime->tv_usec - StartTime->tv_usec))/1000000.0);
+}
+
+
+// Non-interactive timing of the synchronous path against the async and mmap engines
+// on the same file, restoring chunkToRebuild (0 for none) each time
+//
+void compareEngines(stripeGeom_t *geom, char *inputFile, char *outputFile, int chunkToRebuild)
+{
+    char *names[4]={"sync", "io_uring", "threads", "mmap"};
+    int engines[4]={0, RAID_ASYNC_URING, RAID_ASYNC_THREADS, 0};
+    struct timeval StartTime, StopTime;
+    long long bytesWritten, bytesRestored;
+    double stripeSecs, restoreSecs;
+    int idx;
+
+    printf("%-10s %12s %12s %12s %12s\n", "engine", "stripe s", "MB/s", "restore s", "MB/s");
+
+    for(idx=0; idx<4; idx++)
+    {
+        gettimeofday(&StartTime, 0);
+        if(idx == 0)
+            bytesWritten=stripeFileGeom(geom, inputFile);
+        else if(idx == 3)
+            bytesWritten=stripeFileMmap(geom, inputFile);
+        else
+            bytesWritten=stripeFileAsync(geom, inputFile, engines[idx], 0);
+        gettimeofday(&StopTime, 0);
+        stripeSecs=elapsedSecs(&StartTime, &StopTime);
+
+        if(bytesWritten == ERROR)
+        {
+            printf("%-10s failed\n", names[idx]);
+            continue;
+        }
+
+        gettimeofday(&StartTime, 0);
+        if(idx == 0)
+            bytesRestored=restoreFileGeom(geom, outputFile, bytesWritten, chunkToRebuild);
+        else if(idx == 3)
+            bytesRestored=restoreFileMmap(geom, outputFile, bytesWritten, chunkToRebuild, 0);
+        else
+            bytesRestored=restoreFileAsync(geom, outputFile, bytesWritten, chunkToRebuild, 0, engines[idx], 0);
+        gettimeofday(&StopTime, 0);
+        restoreSecs=elapsedSecs(&StartTime, &StopTime);
+
+        printf("%-10s %12lf %12lf %12lf %12lf%s\n", names[idx],
+               stripeSecs, ((double)bytesWritten/1.0e6)/stripeSecs,
+               restoreSecs, ((double)bytesWritten/1.0e6)/restoreSecs,
+               (bytesRestored == ERROR) ? " RESTORE FAILED" : "");
+    }
+}
+
+
 int main(int argc, char *argv[])
 {
-    int bytesWritten, bytesRestored;
+    long long bytesWritten, bytesRestored;
     char rc;
+    stripeGeom_t geom;
+    int dataChunks=4, chunkSize=0, raidLevel=RAID_LEVEL_5, parityChunks=1, engine=-1, useMmap=FALSE;
 
     // For testing, if no data is lost (erased), then the zero default
     // indicates that no data chunk was lost.
-    int chunkToRebuild=0;
+    int chunkToRebuild=0, chunkToRebuild2=0;
 
     if(argc < 3)
     {
-        printf("useage: stripetest inputfile outputfile <sector to restore>\n");
+        printf("useage: stripetest inputfile outputfile <sector to restore> <data chunks> <chunk bytes> <raid level 5|6> <sync|async|threads|mmap|compare>\n");
         exit(-1);
     }
     
@@ -23,33 +85,94 @@ int main(int argc, char *argv[])
 	sscanf(argv[3], "%d", &chunkToRebuild);
         printf("chunk to restore = %d\n", chunkToRebuild);
     }
-  
-    // What is the meaning of the "0" argument here? 
-    // This is an offset in sectors that is not actually used at all in raidlib.c, so we might
-    // want to depricate this argument.
-    bytesWritten=stripeFile(argv[1], 0); 
 
-    printf("%s input file was written as 4 data chunks + 1 XOR parity on 5 devices 1...5\n", argv[1]);
+    // With no geometry given use the original 4+1 set with 512 byte chunks,
+    // otherwise N data chunks of the given size (4 KiB ... 1 MiB)
+    if(argc >= 5)
+    {
+        sscanf(argv[4], "%d", &dataChunks);
+        chunkSize=RAID_MIN_CHUNK_SIZE;
+        if(argc >= 6) sscanf(argv[5], "%d", &chunkSize);
+        if(argc >= 7) sscanf(argv[6], "%d", &raidLevel);
+
+        if((stripeGeomInit(&geom, dataChunks, chunkSize) == ERROR) ||
+           (stripeGeomSetLevel(&geom, raidLevel) == ERROR))
+            exit(-1);
+
+        // async uses io_uring if it can, threads forces the thread engine
+        if(argc >= 8)
+        {
+            if(strcmp(argv[7], "async") == 0) engine=RAID_ASYNC_AUTO;
+            else if(strcmp(argv[7], "threads") == 0) engine=RAID_ASYNC_THREADS;
+            else if(strcmp(argv[7], "mmap") == 0) useMmap=TRUE;
+            else if(strcmp(argv[7], "compare") == 0)
+            {
+                compareEngines(&geom, argv[1], argv[2], chunkToRebuild);
+                exit(0);
+            }
+        }
+
+        parityChunks=geom.parityChunks;
+
+        if(engine >= 0)
+            bytesWritten=stripeFileAsync(&geom, argv[1], engine, 0);
+        else if(useMmap)
+            bytesWritten=stripeFileMmap(&geom, argv[1]);
+        else
+            bytesWritten=stripeFileGeom(&geom, argv[1]);
+    }
+    else
+    {
+        // What is the meaning of the "0" argument here? 
+        // This is an offset in sectors that is not actually used at all in raidlib.c, so we might
+        // want to depricate this argument.
+        bytesWritten=stripeFile(argv[1], 0); 
+    }
+
+    if(bytesWritten == ERROR)
+    {
+        printf("striping %s failed\n", argv[1]);
+        exit(-1);
+    }
+
+    printf("%s input file was written as %d data chunks + %s parity on %d devices 1...%d\n",
+           argv[1], dataChunks, (parityChunks == 2) ? "XOR and Q" : "1 XOR",
+           dataChunks+parityChunks, dataChunks+parityChunks);
 
     printf("Enter chunk you have erased or 0 for none:");
     fscanf(stdin, "%d", &chunkToRebuild);
     printf("Got %d\n", chunkToRebuild);
 
+    if((parityChunks == 2) && (chunkToRebuild > 0))
+    {
+        printf("Enter second chunk you have erased or 0 for none:");
+        fscanf(stdin, "%d", &chunkToRebuild2);
+        printf("Got %d\n", chunkToRebuild2);
+    }
+
     if(chunkToRebuild > 0)
     {
-        printf("Will rebuild StripeChunk%1d.bin\n", chunkToRebuild);
+        printf("Will rebuild chunk %d\n", chunkToRebuild);
         printf("working on restoring file ...\n");
-
-        // What is the meaning of the "0" argument here? 
-        bytesRestored=restoreFile(argv[2], 0, bytesWritten, chunkToRebuild); 
     }
     else
     {
         printf("Nothing erased, so nothing to restore\n");
-        // What is the meaning of the first "0" argument and the second zero here? 
-        bytesRestored=restoreFile(argv[2], 0, bytesWritten, 0); 
     }
 
+    if(engine >= 0)
+        bytesRestored=restoreFileAsync(&geom, argv[2], bytesWritten, chunkToRebuild, chunkToRebuild2, engine, 0);
+    else if(useMmap)
+        bytesRestored=restoreFileMmap(&geom, argv[2], bytesWritten, chunkToRebuild, chunkToRebuild2);
+    else if(chunkSize)
+        bytesRestored=restoreFileGeom2(&geom, argv[2], bytesWritten, chunkToRebuild, chunkToRebuild2);
+    else
+        // What is the meaning of the first "0" argument here? 
+        bytesRestored=restoreFile(argv[2], 0, bytesWritten, chunkToRebuild); 
+
+    if(bytesRestored == ERROR)
+        printf("restoring %s failed\n", argv[2]);
+
     printf("FINISHED\n");
         
 }
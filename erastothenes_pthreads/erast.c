@@ -1,10 +1,15 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <pthread.h>
 #include <sys/types.h>
 #include <unistd.h>
 #include <sched.h>
 #include <semaphore.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #define NUM_THREADS 4  // NOTE THAT THIS MUST BE DIVISIBLE BY 2!
 #define NUM_LOCKS (4*NUM_THREADS)
@@ -31,10 +36,14 @@ struct sched_param fifo_param;
 #define SCHED_POLICY SCHED_RR
 
 
-#define THREAD_GRID_INVALIDATE
+#define SEGMENTED_SIEVE
+//#define THREAD_GRID_INVALIDATE
 //#define SEQUENTIAL_INVALIDATE
 //#define SEQUENTIAL_GRID_INVALIDATE
 
+// only print the primes themselves for small ranges
+#define PRINT_MAX (4000000ULL)
+
 //unsigned char isprime[(MAX/(CODE_LENGTH))+1];
 unsigned char *isprime;
 sem_t updateIsPrime[NUM_LOCKS];
@@ -82,6 +91,510 @@ void set_scheduler(void)
 }
 
 
+#if defined(SEGMENTED_SIEVE)
+
+// Segmented, lock free sieve with wheel-30 packing
+//
+// Only numbers coprime to 2, 3 and 5 can be prime above 5, and there are 8
+// of them in every 30: 1, 7, 11, 13, 17, 19, 23, 29.  So isprime[] holds one
+// byte per 30 numbers, byte b bit k being 30*b + wheelResidue[k] - 3.75x
+// smaller than one bit per number.
+//
+// For a sieving prime p the multiples p*q with q coprime to 30 fall into 8
+// progressions, one per residue of q, each of which is a fixed bit in every
+// p-th byte.  So a block of bytes can be sieved on its own knowing only where
+// each progression first lands, and the bitmap is cut into SEGMENT_BYTES
+// segments that fit in the L1 data cache.  A fixed pool of worker threads
+// claims segments with an atomic counter and each segment belongs to exactly
+// one worker, so no bit is ever shared and no locking is needed.
+//
+#define WHEEL (30ULL)
+#define SEGMENT_BYTES (32*1024ULL)
+
+typedef struct
+{
+    unsigned long long int p;
+    unsigned long long int start[8];
+    unsigned char mask[8];
+} sievePrimeType;
+
+static const unsigned char wheelResidue[8] = {1, 7, 11, 13, 17, 19, 23, 29};
+static unsigned char residueBit[WHEEL];
+
+// Sieve file and query index
+//
+// A finished bitmap can be saved with its index and mapped read only by
+// later runs instead of sieving again.  blockCount[b] is the number of primes
+// in isprime[] before byte b*INDEX_BLOCK_BYTES, so counting up to any n is one
+// index lookup plus a popcount of at most one block.
+//
+#define INDEX_BLOCK_BYTES (4096ULL)
+#define SIEVE_MAGIC "ERAST30"
+
+typedef struct
+{
+    char magic[8];
+    unsigned long long int max;
+    unsigned long long int bytes;
+    unsigned long long int blockBytes;
+    unsigned long long int numBlocks;
+    unsigned long long int reserved[3];
+} sieveFileHeaderType;
+
+static unsigned long long int *blockCount;
+static unsigned long long int numBlocks;
+static unsigned char maskUpTo[WHEEL];
+
+static sievePrimeType *sievePrimes;
+static unsigned int numSievePrimes;
+static unsigned long long int sieveMax=MAX;
+static unsigned long long int sieveBytes;
+static unsigned long long int numSegments;
+static unsigned long long int nextSegment;
+
+
+int chk_isprime(unsigned long long int i)
+{
+    if(i < 7)
+        return((i == 2) || (i == 3) || (i == 5));
+
+    return((isprime[i/WHEEL] & residueBit[i%WHEEL]) != 0);
+}
+
+
+// Sieve bytes [lowByte, highByte) of isprime[], owned by the calling worker
+//
+void sieve_segment(unsigned long long int lowByte, unsigned long long int highByte)
+{
+    unsigned long long int b, p;
+    unsigned int idx, k;
+
+    memset(&isprime[lowByte], 0xFF, highByte-lowByte);
+
+    for(idx=0; idx < numSievePrimes; idx++)
+    {
+        p=sievePrimes[idx].p;
+
+        // first multiple to strike is p*p, so no larger prime reaches here
+        if((p*p)/WHEEL >= highByte) break;
+
+        for(k=0; k < 8; k++)
+        {
+            b=sievePrimes[idx].start[k];
+            if(b >= highByte) continue;
+            if(b < lowByte) b += ((lowByte-b+p-1)/p)*p;
+
+            for(; b < highByte; b+=p)
+                isprime[b] &= ~(sievePrimes[idx].mask[k]);
+        }
+    }
+}
+
+
+void *sieve_worker(void *threadptr)
+{
+    unsigned long long int seg, high;
+
+    while((seg=__atomic_fetch_add(&nextSegment, 1, __ATOMIC_RELAXED)) < numSegments)
+    {
+        high=(seg+1)*SEGMENT_BYTES;
+        if(high > sieveBytes) high=sieveBytes;
+
+        sieve_segment(seg*SEGMENT_BYTES, high);
+    }
+
+    return((void *)0);
+}
+
+
+void init_wheel(void)
+{
+    unsigned int k, r;
+
+    for(k=0; k < 8; k++)
+        residueBit[wheelResidue[k]]=(1<<k);
+
+    // bits for residues <= r
+    for(r=0; r < WHEEL; r++)
+        maskUpTo[r]=(r == 0) ? residueBit[0] : (maskUpTo[r-1] | residueBit[r]);
+}
+
+
+// Find the sieving primes up to sqrt(max) with a small plain sieve, and where
+// each of their 8 progressions starts
+//
+void init_sieve_primes(unsigned long long int max)
+{
+    unsigned long long int root=1, p, q, n, j;
+    unsigned char *small;
+    unsigned int k;
+
+    init_wheel();
+
+    while((root+1)*(root+1) <= max) root++;
+
+    if(((small=calloc(root+1, 1)) == NULL) ||
+       ((sievePrimes=malloc((root/2+1)*sizeof(sievePrimeType))) == NULL))
+    {
+        perror("malloc");
+        exit(-1);
+    }
+    numSievePrimes=0;
+
+    for(p=2; p <= root; p++)
+    {
+        if(small[p]) continue;
+        for(j=p*p; j <= root; j+=p) small[j]=1;
+
+        if(p < 7) continue;
+
+        sievePrimes[numSievePrimes].p=p;
+        for(k=0; k < 8; k++)
+        {
+            // smallest q >= p in this residue class
+            q=p-(p%WHEEL)+wheelResidue[k];
+            if(q < p) q+=WHEEL;
+
+            n=p*q;
+            sievePrimes[numSievePrimes].start[k]=n/WHEEL;
+            sievePrimes[numSievePrimes].mask[k]=residueBit[n%WHEEL];
+        }
+        numSievePrimes++;
+    }
+
+    free(small);
+}
+
+
+static unsigned long long int popcount_bytes(unsigned long long int first, unsigned long long int last)
+{
+    unsigned long long int cnt=0, idx, word;
+
+    for(idx=first; idx+8 <= last; idx+=8)
+    {
+        memcpy(&word, &isprime[idx], sizeof(word));
+        cnt+=__builtin_popcountll(word);
+    }
+    for(; idx < last; idx++)
+        cnt+=__builtin_popcount(isprime[idx]);
+
+    return(cnt);
+}
+
+
+// Build blockCount[] for a freshly sieved bitmap, returning the number of
+// primes in it
+//
+unsigned long long int build_block_index(void)
+{
+    unsigned long long int blk, high;
+
+    numBlocks=(sieveBytes+INDEX_BLOCK_BYTES-1)/INDEX_BLOCK_BYTES;
+    if((blockCount=malloc((numBlocks+1)*sizeof(unsigned long long int))) == NULL)
+    {
+        perror("malloc");
+        exit(-1);
+    }
+
+    blockCount[0]=0;
+    for(blk=0; blk < numBlocks; blk++)
+    {
+        high=(blk+1)*INDEX_BLOCK_BYTES;
+        if(high > sieveBytes) high=sieveBytes;
+        blockCount[blk+1]=blockCount[blk]+popcount_bytes(blk*INDEX_BLOCK_BYTES, high);
+    }
+
+    return(blockCount[numBlocks]);
+}
+
+
+// Returns the number of primes in [0..max]
+//
+unsigned long long int segmented_sieve(unsigned long long int max, int nthreads)
+{
+    pthread_t *workers;
+    unsigned long long int cnt;
+    unsigned int k;
+    int thread_idx, rc;
+
+    sieveMax=max;
+    sieveBytes=max/WHEEL+1;
+    numSegments=(sieveBytes+SEGMENT_BYTES-1)/SEGMENT_BYTES;
+    nextSegment=0;
+
+    // cache line aligned so neighbouring segments never share a line, and
+    // left for each worker to first touch the segments it sieves
+    if(posix_memalign((void **)&isprime, 64, sieveBytes) != 0)
+    {
+        perror("posix_memalign");
+        exit(-1);
+    }
+
+    init_sieve_primes(max);
+    printf("%d threads, %u sieving primes, %llu segments of %llu bytes\n",
+           nthreads, numSievePrimes, numSegments, SEGMENT_BYTES);
+
+    if((workers=malloc(nthreads*sizeof(pthread_t))) == NULL)
+    {
+        perror("malloc");
+        exit(-1);
+    }
+
+    for(thread_idx=0; thread_idx < nthreads; thread_idx++)
+    {
+        if((rc=pthread_create(&workers[thread_idx], (void *)0, sieve_worker, (void *)0)) != 0)
+        {
+            fprintf(stderr, "pthread_create: %s\n", strerror(rc));
+            exit(-1);
+        }
+    }
+
+    for(thread_idx=0; thread_idx < nthreads; thread_idx++)
+        pthread_join(workers[thread_idx], (void **)0);
+
+    free(workers);
+
+    // 1 is not prime, nor is anything past max in the last byte
+    isprime[0] &= ~residueBit[1];
+    for(k=0; k < 8; k++)
+        if((sieveBytes-1)*WHEEL+wheelResidue[k] > max)
+            isprime[sieveBytes-1] &= ~(1<<k);
+
+    cnt=build_block_index();
+
+    // 2, 3 and 5 are not in the wheel
+    for(k=2; k <= 5; k++)
+        if((k != 4) && (k <= max)) cnt++;
+
+    return(cnt);
+}
+
+
+// Write the bitmap and its index to fileName
+//
+int sieve_save(char *fileName)
+{
+    sieveFileHeaderType header;
+    unsigned long long int pad=0;
+    int fd;
+
+    if((fd=open(fileName, O_WRONLY | O_CREAT | O_TRUNC, 00644)) < 0)
+    {
+        perror(fileName);
+        return(-1);
+    }
+
+    memset(&header, 0, sizeof(header));
+    strcpy(header.magic, SIEVE_MAGIC);
+    header.max=sieveMax;
+    header.bytes=sieveBytes;
+    header.blockBytes=INDEX_BLOCK_BYTES;
+    header.numBlocks=numBlocks;
+
+    // index starts 8 byte aligned after the bitmap
+    if((write(fd, &header, sizeof(header)) != sizeof(header)) ||
+       (write(fd, isprime, sieveBytes) != sieveBytes) ||
+       (write(fd, &pad, (8-(sieveBytes % 8)) % 8) != (8-(sieveBytes % 8)) % 8) ||
+       (write(fd, blockCount, (numBlocks+1)*sizeof(unsigned long long int)) !=
+        (numBlocks+1)*sizeof(unsigned long long int)))
+    {
+        perror("sieve_save");
+        close(fd);
+        return(-1);
+    }
+
+    close(fd);
+    return(0);
+}
+
+
+// Map a saved bitmap and index read only, replacing any sieved in this run.
+// Returns -1 if the file is missing or not a sieve file.
+//
+int sieve_load(char *fileName)
+{
+    sieveFileHeaderType header;
+    unsigned char *map;
+    struct stat st;
+    int fd;
+
+    if((fd=open(fileName, O_RDONLY)) < 0)
+        return(-1);
+
+    // the bitmap and index sizes follow from max, so a header that does not
+    // agree with itself or the file size is never trusted
+    if((fstat(fd, &st) < 0) ||
+       (read(fd, &header, sizeof(header)) != sizeof(header)) ||
+       (memcmp(header.magic, SIEVE_MAGIC, sizeof(header.magic)) != 0) ||
+       (header.blockBytes != INDEX_BLOCK_BYTES) ||
+       (header.bytes != header.max/WHEEL+1) ||
+       (header.numBlocks != (header.bytes+INDEX_BLOCK_BYTES-1)/INDEX_BLOCK_BYTES) ||
+       (header.bytes > st.st_size) ||
+       (st.st_size < sizeof(header) + ((header.bytes+7)/8)*8 + (header.numBlocks+1)*sizeof(unsigned long long int)))
+    {
+        printf("%s is not a sieve file\n", fileName);
+        close(fd);
+        return(-1);
+    }
+
+    map=mmap((void *)0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if(map == MAP_FAILED)
+    {
+        perror("mmap");
+        return(-1);
+    }
+
+    init_wheel();
+    sieveMax=header.max;
+    sieveBytes=header.bytes;
+    numBlocks=header.numBlocks;
+    isprime=map+sizeof(header);
+    blockCount=(unsigned long long int *)(map+sizeof(header)+((sieveBytes+7)/8)*8);
+
+    return(0);
+}
+
+
+// Number of primes in [0..n], n clamped to the sieved range
+//
+unsigned long long int prime_pi(unsigned long long int n)
+{
+    unsigned long long int byte, cnt=0;
+
+    if(n > sieveMax) n=sieveMax;
+
+    if(n >= 2) cnt++;
+    if(n >= 3) cnt++;
+    if(n >= 5) cnt++;
+
+    byte=n/WHEEL;
+    cnt+=blockCount[byte/INDEX_BLOCK_BYTES];
+    cnt+=popcount_bytes((byte/INDEX_BLOCK_BYTES)*INDEX_BLOCK_BYTES, byte);
+    cnt+=__builtin_popcount(isprime[byte] & maskUpTo[n%WHEEL]);
+
+    return(cnt);
+}
+
+
+// Number of primes in [a..b]
+//
+unsigned long long int count_primes(unsigned long long int a, unsigned long long int b)
+{
+    if((b < a) || (a > sieveMax))
+        return(0);
+
+    return(prime_pi(b) - ((a > 0) ? prime_pi(a-1) : 0));
+}
+
+
+// Smallest prime > n, or 0 if it is past the sieved range
+//
+unsigned long long int next_prime(unsigned long long int n)
+{
+    unsigned long long int byte, prime;
+    unsigned char bits;
+
+    if(n < 2) return(2);
+    if(n < 3) return(3);
+    if(n < 5) return(5);
+
+    byte=(n+1)/WHEEL;
+    if(byte >= sieveBytes) return(0);
+
+    // residues above n in its byte, then whole bytes
+    bits=isprime[byte] & ~(((n+1) % WHEEL) ? maskUpTo[(n+1) % WHEEL - 1] : 0);
+
+    while(bits == 0)
+    {
+        if(++byte >= sieveBytes) return(0);
+        bits=isprime[byte];
+    }
+
+    prime=byte*WHEEL + wheelResidue[__builtin_ctz(bits)];
+
+    return((prime <= sieveMax) ? prime : 0);
+}
+
+
+// The nth prime, counting 2 as the first, or 0 if it is past the sieved range
+//
+unsigned long long int nth_prime(unsigned long long int nth)
+{
+    unsigned long long int lo=0, hi=numBlocks, mid, byte, remaining;
+    unsigned char bits;
+
+    if(nth == 0) return(0);
+    if(nth <= 3) return((nth == 1) ? 2 : ((nth == 2) ? 3 : 5));
+
+    remaining=nth-3;
+    if(remaining > blockCount[numBlocks]) return(0);
+
+    // last block starting with fewer than remaining primes before it
+    while(hi-lo > 1)
+    {
+        mid=(lo+hi)/2;
+        if(blockCount[mid] < remaining) lo=mid; else hi=mid;
+    }
+
+    remaining-=blockCount[lo];
+    for(byte=lo*INDEX_BLOCK_BYTES; __builtin_popcount(isprime[byte]) < remaining; byte++)
+        remaining-=__builtin_popcount(isprime[byte]);
+
+    // drop the lower set bits until the one we want is lowest
+    bits=isprime[byte];
+    while(--remaining > 0)
+        bits&=bits-1;
+
+    return(byte*WHEEL + wheelResidue[__builtin_ctz(bits)]);
+}
+
+
+static double elapsed_usecs(struct timespec *start, struct timespec *stop)
+{
+    return((double)(stop->tv_sec - start->tv_sec)*1000000.0 +
+           (double)(stop->tv_nsec - start->tv_nsec)/1000.0);
+}
+
+
+// erast -f <file> count <a> <b> | next <n> | nth <k>
+//
+int sieve_query(int argc, char *argv[])
+{
+    unsigned long long int a=0, b=0, result;
+    struct timespec start, stop;
+
+    if(argc >= 5) sscanf(argv[4], "%llu", &a);
+    if(argc >= 6) sscanf(argv[5], "%llu", &b);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    if((strcmp(argv[3], "count") == 0) && (argc >= 6))
+        result=count_primes(a, b);
+    else if((strcmp(argv[3], "next") == 0) && (argc >= 5))
+        result=next_prime(a);
+    else if((strcmp(argv[3], "nth") == 0) && (argc >= 5))
+        result=nth_prime(a);
+    else
+    {
+        printf("usage: erast -f <file> count <a> <b> | next <n> | nth <k>\n");
+        return(-1);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+
+    if(((a > sieveMax) || (b > sieveMax)) && (strcmp(argv[3], "nth") != 0))
+        printf("note: sieve file only covers [0..%llu]\n", sieveMax);
+
+    printf("%s %s%s%s = %llu (%.2lf usecs)\n", argv[3], argv[4],
+           (argc >= 6) ? " " : "", (argc >= 6) ? argv[5] : "", result, elapsed_usecs(&start, &stop));
+
+    return(0);
+}
+
+#else
+
 int chk_isprime(unsigned long long int i)
 {
     unsigned long long int idx;
@@ -95,6 +608,7 @@ int chk_isprime(unsigned long long int i)
     return(((isprime[idx]) & (1<<bitpos))>0);
 }
 
+
 int set_isprime(unsigned long long int i, unsigned char val)
 {
     unsigned long long int idx;
@@ -152,18 +666,77 @@ void *invalidate_thread(void *threadptr)
     pthread_exit(&thargs.j);
 }
 
+#endif
+
 
-int main(void)
+int main(int argc, char *argv[])
 {
         unsigned long long int i, j, final_thread_j;
         unsigned long long int p=2;
-        unsigned int cnt=0;
+        unsigned long long int cnt=0;
         unsigned long long int thread_idx=0;
 
         printf("max uint = %u\n", (0xFFFFFFFF));
         printf("max long long = %llu\n", (0xFFFFFFFFFFFFFFFFULL));
 
         set_scheduler();
+
+#if defined(SEGMENTED_SIEVE)
+
+        // erast [max] [threads], all online CPUs by default
+        //
+        // erast -f <file> [max] [threads] maps the sieve saved in file if it
+        // covers max, otherwise sieves and saves it there, and
+        // erast -f <file> count|next|nth ... answers queries from it
+        unsigned long long int max=MAX;
+        int nthreads=sysconf(_SC_NPROCESSORS_ONLN);
+        char *fileName=(char *)0;
+
+        if((argc >= 3) && (strcmp(argv[1], "-f") == 0))
+        {
+            fileName=argv[2];
+
+            if((argc >= 4) && ((argv[3][0] < '0') || (argv[3][0] > '9')))
+            {
+                if(sieve_load(fileName) < 0)
+                {
+                    printf("no sieve file %s, create one with erast -f %s <max>\n", fileName, fileName);
+                    exit(-1);
+                }
+                return(sieve_query(argc, argv));
+            }
+
+            argc-=2;
+            argv+=2;
+        }
+
+        if(argc >= 2) sscanf(argv[1], "%llu", &max);
+        if(argc >= 3) sscanf(argv[2], "%d", &nthreads);
+        if(nthreads < 1) nthreads=1;
+
+        if((fileName != (char *)0) && (sieve_load(fileName) == 0) && (sieveMax >= max))
+        {
+            printf("mapped %s, sieved to %llu\n", fileName, sieveMax);
+            cnt=prime_pi(max);
+        }
+        else
+        {
+            cnt=segmented_sieve(max, nthreads);
+
+            if((fileName != (char *)0) && (sieve_save(fileName) == 0))
+                printf("saved sieve to %s\n", fileName);
+        }
+
+        if(max <= PRINT_MAX)
+        {
+            for(i=0; i<max+1; i++)
+                if(chk_isprime(i)) printf("%llu,", i);
+        }
+        printf("\nNumber of primes [0..%llu]=%llu\n\n", max, cnt);
+
+        return(0);
+
+#else
         if(!((isprime=malloc((size_t)(MAX/(CODE_LENGTH))+1)) > 0))
         {
             perror("malloc");
@@ -299,7 +872,9 @@ int main(void)
                 printf("%llu,", i); 
             }
         }
-        printf("\nNumber of primes [0..%llu]=%u\n\n", MAX, cnt);
+        printf("\nNumber of primes [0..%llu]=%llu\n\n", MAX, cnt);
 
         return (i);
+
+#endif
 }
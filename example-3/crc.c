@@ -231,3 +231,409 @@ crcFast(unsigned char const message[], int nBytes)
     return (REFLECT_REMAINDER(remainder) ^ FINAL_XOR_VALUE);
 
 }   /* crcFast() */
+
+
+/*********************************************************************
+ *
+ * Fixed 32-bit CRC engines
+ *
+ * CRC-32 and CRC-32C are both reflected, so every engine below works
+ * on the reflected polynomial and shifts the remainder right.
+ *
+ * Slicing-by-N keeps N tables, table k giving the CRC contribution of
+ * a byte followed by k zero bytes, so N bytes are folded in with N
+ * independent lookups instead of a chain of N dependent ones.
+ *
+ * The hardware engines are compiled with per-function target
+ * attributes and chosen from CPUID at run time, so the file still
+ * builds for, and runs on, a baseline x86-64 or non-x86 CPU.
+ *
+ *********************************************************************/
+#include <pthread.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CRC32_X86_ENGINES
+#endif
+
+static const uint32_t crc32Polys[CRC32_POLY_COUNT] = { 0xEDB88320, 0x82F63B78 };
+
+static uint32_t crc32Tables[CRC32_POLY_COUNT][16][256];
+static int crc32Selected[CRC32_POLY_COUNT] = { CRC32_IMPL_AUTO, CRC32_IMPL_AUTO };
+static pthread_once_t crc32Once = PTHREAD_ONCE_INIT;
+
+
+/*
+ * The slicing tables take the message a little-endian word at a time,
+ * whatever the host; compilers make this a single load on x86.
+ */
+static uint32_t
+load32(unsigned char const *p)
+{
+	return ((uint32_t) p[0] | ((uint32_t) p[1] << 8) | ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24));
+}
+
+
+/*********************************************************************
+ *
+ * Function:    crc32Build()
+ * 
+ * Description: Build the slicing tables for both polynomials and pick
+ *				the fastest supported engine for each.
+ *
+ * Notes:		Run once, by whichever thread first needs a CRC.
+ *
+ *********************************************************************/
+static void
+crc32Build(void)
+{
+	uint32_t  remainder;
+	int       poly, dividend, bit, slice;
+
+	for (poly = 0; poly < CRC32_POLY_COUNT; ++poly)
+	{
+		for (dividend = 0; dividend < 256; ++dividend)
+		{
+			remainder = dividend;
+			for (bit = 8; bit > 0; --bit)
+			{
+				remainder = (remainder & 1) ? ((remainder >> 1) ^ crc32Polys[poly]) : (remainder >> 1);
+			}
+			crc32Tables[poly][0][dividend] = remainder;
+		}
+
+		for (slice = 1; slice < 16; ++slice)
+		{
+			for (dividend = 0; dividend < 256; ++dividend)
+			{
+				remainder = crc32Tables[poly][slice - 1][dividend];
+				crc32Tables[poly][slice][dividend] = (remainder >> 8) ^ crc32Tables[poly][0][remainder & 0xFF];
+			}
+		}
+
+		crc32Selected[poly] = crc32ImplSupported(poly, CRC32_IMPL_HW) ? CRC32_IMPL_HW : CRC32_IMPL_SLICE16;
+	}
+
+}   /* crc32Build() */
+
+
+static uint32_t
+crc32Byte(uint32_t const table[16][256], uint32_t remainder, unsigned char const *message, size_t nBytes)
+{
+	while (nBytes--)
+	{
+		remainder = table[0][(remainder ^ *message++) & 0xFF] ^ (remainder >> 8);
+	}
+
+	return (remainder);
+}
+
+
+static uint32_t
+crc32Slice8(uint32_t const table[16][256], uint32_t remainder, unsigned char const *message, size_t nBytes)
+{
+	uint32_t  high;
+
+	for (; nBytes >= 8; nBytes -= 8, message += 8)
+	{
+		remainder ^= load32(message);
+		high = load32(message + 4);
+
+		remainder = table[7][remainder & 0xFF] ^ table[6][(remainder >> 8) & 0xFF] ^
+		            table[5][(remainder >> 16) & 0xFF] ^ table[4][remainder >> 24] ^
+		            table[3][high & 0xFF] ^ table[2][(high >> 8) & 0xFF] ^
+		            table[1][(high >> 16) & 0xFF] ^ table[0][high >> 24];
+	}
+
+	return (crc32Byte(table, remainder, message, nBytes));
+}
+
+
+static uint32_t
+crc32Slice16(uint32_t const table[16][256], uint32_t remainder, unsigned char const *message, size_t nBytes)
+{
+	uint32_t  word1, word2, word3;
+
+	for (; nBytes >= 16; nBytes -= 16, message += 16)
+	{
+		remainder ^= load32(message);
+		word1 = load32(message + 4);
+		word2 = load32(message + 8);
+		word3 = load32(message + 12);
+
+		remainder = table[15][remainder & 0xFF] ^ table[14][(remainder >> 8) & 0xFF] ^
+		            table[13][(remainder >> 16) & 0xFF] ^ table[12][remainder >> 24] ^
+		            table[11][word1 & 0xFF] ^ table[10][(word1 >> 8) & 0xFF] ^
+		            table[9][(word1 >> 16) & 0xFF] ^ table[8][word1 >> 24] ^
+		            table[7][word2 & 0xFF] ^ table[6][(word2 >> 8) & 0xFF] ^
+		            table[5][(word2 >> 16) & 0xFF] ^ table[4][word2 >> 24] ^
+		            table[3][word3 & 0xFF] ^ table[2][(word3 >> 8) & 0xFF] ^
+		            table[1][(word3 >> 16) & 0xFF] ^ table[0][word3 >> 24];
+	}
+
+	return (crc32Byte(table, remainder, message, nBytes));
+}
+
+
+#ifdef CRC32_X86_ENGINES
+
+/*
+ * CRC-32C with the SSE4.2 crc32 instruction, 8 bytes at a time.
+ */
+__attribute__((target("sse4.2")))
+static uint32_t
+crc32cSSE42(uint32_t remainder, unsigned char const *message, size_t nBytes)
+{
+	uint64_t  word, wide = remainder;
+
+	for (; nBytes >= 8; nBytes -= 8, message += 8)
+	{
+		memcpy(&word, message, sizeof(word));
+		wide = _mm_crc32_u64(wide, word);
+	}
+
+	remainder = (uint32_t) wide;
+	while (nBytes--)
+	{
+		remainder = _mm_crc32_u8(remainder, *message++);
+	}
+
+	return (remainder);
+}
+
+
+/*
+ * CRC-32 by carry-less multiply folding, after Intel's "Fast CRC
+ * Computation for Generic Polynomials Using PCLMULQDQ Instruction".
+ * Four 128-bit lanes are folded forward 64 bytes at a time, then into
+ * one lane, then Barrett reduced to 32 bits.  Needs nBytes >= 64 and
+ * a multiple of 16; the caller finishes any tail with the tables.
+ */
+__attribute__((target("pclmul,sse4.1")))
+static uint32_t
+crc32PCLMUL(uint32_t remainder, unsigned char const *message, size_t nBytes)
+{
+	static const uint64_t  k1k2[2] __attribute__((aligned(16))) = { 0x0154442bd4ULL, 0x01c6e41596ULL };
+	static const uint64_t  k3k4[2] __attribute__((aligned(16))) = { 0x01751997d0ULL, 0x00ccaa009eULL };
+	static const uint64_t  k5k0[2] __attribute__((aligned(16))) = { 0x0163cd6124ULL, 0x0000000000ULL };
+	static const uint64_t  poly[2] __attribute__((aligned(16))) = { 0x01db710641ULL, 0x01f7011641ULL };
+	__m128i  x0, x1, x2, x3, x4, x5, x6, x7, x8;
+
+	x1 = _mm_loadu_si128((__m128i *)(message + 0x00));
+	x2 = _mm_loadu_si128((__m128i *)(message + 0x10));
+	x3 = _mm_loadu_si128((__m128i *)(message + 0x20));
+	x4 = _mm_loadu_si128((__m128i *)(message + 0x30));
+	x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128(remainder));
+
+	x0 = _mm_load_si128((__m128i *)k1k2);
+	message += 64;
+	nBytes -= 64;
+
+	/*
+	 * Fold the four lanes forward over the next 64 bytes.
+	 */
+	for (; nBytes >= 64; nBytes -= 64, message += 64)
+	{
+		x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+		x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+		x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+		x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+
+		x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+		x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+		x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+		x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+
+		x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), _mm_loadu_si128((__m128i *)(message + 0x00)));
+		x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), _mm_loadu_si128((__m128i *)(message + 0x10)));
+		x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), _mm_loadu_si128((__m128i *)(message + 0x20)));
+		x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), _mm_loadu_si128((__m128i *)(message + 0x30)));
+	}
+
+	/*
+	 * Fold the four lanes into one, then any remaining 16 byte blocks.
+	 */
+	x0 = _mm_load_si128((__m128i *)k3k4);
+
+	x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+	x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+	x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+
+	x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+	x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+	x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+
+	x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+	x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+	x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+	for (; nBytes >= 16; nBytes -= 16, message += 16)
+	{
+		x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+		x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+		x1 = _mm_xor_si128(_mm_xor_si128(x1, _mm_loadu_si128((__m128i *)message)), x5);
+	}
+
+	/*
+	 * Fold 128 bits to 64, then Barrett reduce to 32.
+	 */
+	x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+	x3 = _mm_setr_epi32(~0, 0, ~0, 0);
+	x1 = _mm_srli_si128(x1, 8);
+	x1 = _mm_xor_si128(x1, x2);
+
+	x0 = _mm_loadl_epi64((__m128i *)k5k0);
+	x2 = _mm_srli_si128(x1, 4);
+	x1 = _mm_and_si128(x1, x3);
+	x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+	x1 = _mm_xor_si128(x1, x2);
+
+	x0 = _mm_load_si128((__m128i *)poly);
+	x2 = _mm_and_si128(x1, x3);
+	x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+	x2 = _mm_and_si128(x2, x3);
+	x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+	x1 = _mm_xor_si128(x1, x2);
+
+	return ((uint32_t) _mm_extract_epi32(x1, 1));
+}
+
+#endif
+
+
+int
+crc32ImplSupported(int poly, int impl)
+{
+	if ((poly < 0) || (poly >= CRC32_POLY_COUNT) || (impl < 0) || (impl >= CRC32_IMPL_COUNT))
+	{
+		return (FALSE);
+	}
+
+	if (impl != CRC32_IMPL_HW)
+	{
+		return (TRUE);
+	}
+
+#ifdef CRC32_X86_ENGINES
+	__builtin_cpu_init();
+
+	if (poly == CRC32_CASTAGNOLI)
+	{
+		return (__builtin_cpu_supports("sse4.2") ? TRUE : FALSE);
+	}
+
+	return ((__builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1")) ? TRUE : FALSE);
+#else
+	return (FALSE);
+#endif
+}
+
+
+int
+crc32SelectedImpl(int poly)
+{
+	if ((poly < 0) || (poly >= CRC32_POLY_COUNT))
+	{
+		return (CRC32_IMPL_AUTO);
+	}
+
+	pthread_once(&crc32Once, crc32Build);
+
+	return (crc32Selected[poly]);
+}
+
+
+const char *
+crc32ImplName(int impl)
+{
+	static const char *names[CRC32_IMPL_COUNT] = { "byte", "slice-by-8", "slice-by-16", "hardware" };
+
+	if ((impl < 0) || (impl >= CRC32_IMPL_COUNT))
+	{
+		return ("unknown");
+	}
+
+	return (names[impl]);
+}
+
+
+/*********************************************************************
+ *
+ * Function:    crc32UpdateImpl()
+ * 
+ * Description: Continue a CRC-32 or CRC-32C with a given engine.
+ *
+ * Notes:		Used to compare engines; crc32Update() picks one.
+ *				An engine this CPU can't run falls back to slicing.
+ *
+ * Returns:		The CRC of all the data so far, or crc unchanged for
+ *				an unknown polynomial.
+ *
+ *********************************************************************/
+uint32_t
+crc32UpdateImpl(int poly, int impl, uint32_t crc, unsigned char const message[], size_t nBytes)
+{
+	uint32_t const (*table)[256];
+	uint32_t        remainder = ~crc;
+	size_t          folded;
+
+	if ((poly < 0) || (poly >= CRC32_POLY_COUNT))
+	{
+		return (crc);
+	}
+
+	pthread_once(&crc32Once, crc32Build);
+	table = (uint32_t const (*)[256]) crc32Tables[poly];
+
+	if ((impl == CRC32_IMPL_HW) && !crc32ImplSupported(poly, impl))
+	{
+		impl = CRC32_IMPL_SLICE16;
+	}
+
+	switch (impl)
+	{
+		case CRC32_IMPL_BYTE:
+			remainder = crc32Byte(table, remainder, message, nBytes);
+			break;
+
+		case CRC32_IMPL_SLICE8:
+			remainder = crc32Slice8(table, remainder, message, nBytes);
+			break;
+
+#ifdef CRC32_X86_ENGINES
+		case CRC32_IMPL_HW:
+			if (poly == CRC32_CASTAGNOLI)
+			{
+				remainder = crc32cSSE42(remainder, message, nBytes);
+				break;
+			}
+
+			/*
+			 * Fold whole 16 byte blocks, the tables do the rest.
+			 */
+			folded = 0;
+			if (nBytes >= 64)
+			{
+				folded = nBytes & ~(size_t) 15;
+				remainder = crc32PCLMUL(remainder, message, folded);
+			}
+			remainder = crc32Slice16(table, remainder, message + folded, nBytes - folded);
+			break;
+#endif
+
+		default:
+			remainder = crc32Slice16(table, remainder, message, nBytes);
+			break;
+	}
+
+	return (~remainder);
+
+}   /* crc32UpdateImpl() */
+
+
+uint32_t
+crc32Update(int poly, uint32_t crc, unsigned char const message[], size_t nBytes)
+{
+	return (crc32UpdateImpl(poly, crc32SelectedImpl(poly), crc, message, nBytes));
+}
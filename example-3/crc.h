@@ -74,5 +74,32 @@ crc   crcSlow(unsigned char const message[], int nBytes);
 crc   crcFast(unsigned char const message[], int nBytes);
 
 
+/*
+ * Fixed 32-bit CRCs for bulk data, independent of the standard selected
+ * above.  crc32Update() continues the CRC of earlier data - start with 0 -
+ * and returns the finished CRC, so a message can be checked in pieces.
+ * The fastest implementation this CPU supports is chosen on first use.
+ */
+#include <stddef.h>
+#include <stdint.h>
+
+#define CRC32_IEEE			0	/* CRC-32, as Ethernet/zlib */
+#define CRC32_CASTAGNOLI	1	/* CRC-32C, as iSCSI/ext4 */
+#define CRC32_POLY_COUNT	2
+
+#define CRC32_IMPL_AUTO		(-1)
+#define CRC32_IMPL_BYTE		0	/* table per byte, as crcFast() */
+#define CRC32_IMPL_SLICE8	1	/* 8 tables, 8 bytes per step */
+#define CRC32_IMPL_SLICE16	2	/* 16 tables, 16 bytes per step */
+#define CRC32_IMPL_HW		3	/* SSE4.2 crc32 (CRC-32C), PCLMULQDQ folding (CRC-32) */
+#define CRC32_IMPL_COUNT	4
+
+uint32_t    crc32Update(int poly, uint32_t crc, unsigned char const message[], size_t nBytes);
+uint32_t    crc32UpdateImpl(int poly, int impl, uint32_t crc, unsigned char const message[], size_t nBytes);
+int         crc32ImplSupported(int poly, int impl);
+int         crc32SelectedImpl(int poly);
+const char *crc32ImplName(int impl);
+
+
 #endif /* _crc_h */
 
@@ -0,0 +1,520 @@
+#define _GNU_SOURCE
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "md5.h"
+#include "sha1.h"
+#include "sha2.h"
+#include "crc.h"
+
+// Streaming file integrity hasher
+//
+// filehash [-a alg,alg...] [-b KiB] [-n buffers] [-d|-m] [-v] file ...
+//
+// One reader thread streams each file through a ring of large page aligned
+// buffers while one hasher thread per digest consumes them, so the read of
+// the next buffer overlaps hashing of the last and every digest is computed
+// from a single pass over the file.  A buffer is refilled only once all the
+// hashers are done with it, so at most RING_BUFFERS are ever in memory.
+//
+// -d reads with O_DIRECT, bypassing the page cache, so hashing a multi-GB
+//    capture archive does not evict everything else (falls back to normal
+//    reads where the file system refuses it)
+// -m maps the file instead - the reader thread faults each window in ahead
+//    of the hashers and the buffers are views of the mapping, with no copy
+//
+// Output is one "ALG (file) = hex" line per digest, as BSD md5/shasum -t.
+//
+
+#define RING_BUFFERS (4)
+#define MAX_RING_BUFFERS (64)
+#define BUFFER_KB (4096)
+#define BUFFER_ALIGN (4096)
+
+#define ALG_MD5 (0)
+#define ALG_SHA1 (1)
+#define ALG_SHA256 (2)
+#define ALG_CRC32 (3)
+#define ALG_CRC32C (4)
+#define ALG_COUNT (5)
+
+static const char *algNames[ALG_COUNT] = {"MD5", "SHA1", "SHA256", "CRC32", "CRC32C"};
+static const int algDigestSize[ALG_COUNT] = {16, 20, 32, 4, 4};
+
+typedef struct
+{
+    unsigned char *data;    // aligned buffer, or a window of the mapping
+    size_t len;
+    long long seq;          // block of the file held, -1 before the first
+    int pending;            // hashers still to finish with it
+    int eof;
+} ringSlot_t;
+
+typedef struct
+{
+    ringSlot_t slot[MAX_RING_BUFFERS];
+    int nslots;
+    size_t bufSize;
+    int fd;
+    int useMmap;
+    unsigned char *map;
+    off_t fileSize;
+    int nhashers;
+    int error;
+    long long bytes;
+    pthread_mutex_t lock;
+    pthread_cond_t filled;
+    pthread_cond_t drained;
+} hashRing_t;
+
+typedef struct
+{
+    hashRing_t *ring;
+    int alg;
+    pthread_t thread;
+    union
+    {
+        md5_state_t md5;
+        sha1_context sha1;
+        sha256_ctx sha256;
+        uint32_t crc;
+    } ctx;
+    unsigned char digest[32];
+} hasher_t;
+
+
+static double elapsedSecs(struct timeval *start, struct timeval *stop)
+{
+    return (double)(stop->tv_sec - start->tv_sec) + (double)(stop->tv_usec - start->tv_usec)/1000000.0;
+}
+
+
+// Fill one ring buffer, returns bytes read, 0 at end of file or -1
+//
+static ssize_t fillSlot(hashRing_t *ring, ringSlot_t *slot, long long seq)
+{
+    off_t offset=(off_t)seq*ring->bufSize;
+    size_t len=ring->bufSize, page;
+    ssize_t rc, done=0;
+    volatile unsigned char touch;
+
+    if(ring->useMmap)
+    {
+        if(offset >= ring->fileSize)
+            return 0;
+
+        if((off_t)len > ring->fileSize-offset)
+            len=ring->fileSize-offset;
+
+        // start the read-ahead for the whole window, then fault it in here
+        // so the hashers never stall on a page fault
+        slot->data=&ring->map[offset];
+        madvise(slot->data, len, MADV_WILLNEED);
+        for(page=0; page<len; page+=BUFFER_ALIGN)
+            touch=slot->data[page];
+        (void)touch;
+
+        return len;
+    }
+
+    while((size_t)done < len)
+    {
+        rc=read(ring->fd, &slot->data[done], len-done);
+        if(rc < 0)
+        {
+            if(errno == EINTR) continue;
+            perror("filehash: read");
+            return -1;
+        }
+        if(rc == 0) break;
+        done+=rc;
+    }
+
+    return done;
+}
+
+
+static void *readerThread(void *arg)
+{
+    hashRing_t *ring=(hashRing_t *)arg;
+    ringSlot_t *slot;
+    long long seq;
+    ssize_t len;
+
+    for(seq=0; ; seq++)
+    {
+        slot=&ring->slot[seq % ring->nslots];
+
+        pthread_mutex_lock(&ring->lock);
+        while(slot->pending > 0)
+            pthread_cond_wait(&ring->drained, &ring->lock);
+        pthread_mutex_unlock(&ring->lock);
+
+        // the slot is ours until it is published below
+        len=fillSlot(ring, slot, seq);
+
+        pthread_mutex_lock(&ring->lock);
+        slot->len=(len > 0) ? len : 0;
+        slot->eof=(len <= 0);
+        slot->seq=seq;
+        slot->pending=ring->nhashers;
+        if(len < 0) ring->error=TRUE;
+        else ring->bytes+=len;
+        pthread_cond_broadcast(&ring->filled);
+        pthread_mutex_unlock(&ring->lock);
+
+        if(len <= 0) break;
+    }
+
+    return NULL;
+}
+
+
+static void hashInit(hasher_t *hasher)
+{
+    switch(hasher->alg)
+    {
+        case ALG_MD5:
+            md5_init(&hasher->ctx.md5);
+            break;
+        case ALG_SHA1:
+            sha1_starts(&hasher->ctx.sha1);
+            break;
+        case ALG_SHA256:
+            sha256_init(&hasher->ctx.sha256);
+            break;
+        default:
+            hasher->ctx.crc=0;
+    }
+}
+
+
+static void hashUpdate(hasher_t *hasher, unsigned char *data, size_t len)
+{
+    switch(hasher->alg)
+    {
+        case ALG_MD5:
+            md5_append(&hasher->ctx.md5, data, (int)len);
+            break;
+        case ALG_SHA1:
+            sha1_update(&hasher->ctx.sha1, data, (int)len);
+            break;
+        case ALG_SHA256:
+            sha256_update(&hasher->ctx.sha256, data, (unsigned int)len);
+            break;
+        case ALG_CRC32:
+            hasher->ctx.crc=crc32Update(CRC32_IEEE, hasher->ctx.crc, data, len);
+            break;
+        case ALG_CRC32C:
+            hasher->ctx.crc=crc32Update(CRC32_CASTAGNOLI, hasher->ctx.crc, data, len);
+            break;
+    }
+}
+
+
+static void hashFinish(hasher_t *hasher)
+{
+    switch(hasher->alg)
+    {
+        case ALG_MD5:
+            md5_finish(&hasher->ctx.md5, hasher->digest);
+            break;
+        case ALG_SHA1:
+            sha1_finish(&hasher->ctx.sha1, hasher->digest);
+            break;
+        case ALG_SHA256:
+            sha256_final(&hasher->ctx.sha256, hasher->digest);
+            break;
+        default:
+            hasher->digest[0]=(unsigned char)(hasher->ctx.crc >> 24);
+            hasher->digest[1]=(unsigned char)(hasher->ctx.crc >> 16);
+            hasher->digest[2]=(unsigned char)(hasher->ctx.crc >> 8);
+            hasher->digest[3]=(unsigned char)hasher->ctx.crc;
+    }
+}
+
+
+static void *hasherThread(void *arg)
+{
+    hasher_t *hasher=(hasher_t *)arg;
+    hashRing_t *ring=hasher->ring;
+    ringSlot_t *slot;
+    long long seq;
+    int eof;
+
+    hashInit(hasher);
+
+    for(seq=0; ; seq++)
+    {
+        slot=&ring->slot[seq % ring->nslots];
+
+        pthread_mutex_lock(&ring->lock);
+        while(slot->seq != seq)
+            pthread_cond_wait(&ring->filled, &ring->lock);
+        eof=slot->eof;
+        pthread_mutex_unlock(&ring->lock);
+
+        // every hasher reads the same buffer, none writes it
+        if(!eof)
+            hashUpdate(hasher, slot->data, slot->len);
+
+        pthread_mutex_lock(&ring->lock);
+        if(--slot->pending == 0)
+            pthread_cond_broadcast(&ring->drained);
+        pthread_mutex_unlock(&ring->lock);
+
+        if(eof) break;
+    }
+
+    hashFinish(hasher);
+
+    return NULL;
+}
+
+
+static int openInput(char *path, int direct)
+{
+    int fd;
+
+    if(direct)
+    {
+        if((fd=open(path, O_RDONLY | O_DIRECT)) >= 0)
+            return fd;
+
+        if(errno != EINVAL)
+        {
+            perror(path);
+            return -1;
+        }
+
+        // stdout is only digests, for scripts
+        fprintf(stderr, "filehash: O_DIRECT not supported for %s, using buffered reads\n", path);
+    }
+
+    if((fd=open(path, O_RDONLY)) < 0)
+    {
+        perror(path);
+        return -1;
+    }
+
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    return fd;
+}
+
+
+// Hash one file with every selected digest, returns 0 on success
+//
+// buffers holds the ring's read buffers, unused when mapping
+//
+int hashFile(char *path, int *algs, int nalgs, hashRing_t *ring, unsigned char **buffers,
+             int useMmap, int direct, int verbose)
+{
+    hasher_t hasher[ALG_COUNT];
+    pthread_t reader;
+    struct timeval start, stop;
+    struct stat st;
+    double secs;
+    int idx, byte;
+
+    if((ring->fd=openInput(path, useMmap ? FALSE : direct)) < 0)
+        return -1;
+
+    if(fstat(ring->fd, &st) < 0)
+    {
+        perror(path);
+        close(ring->fd);
+        return -1;
+    }
+
+    ring->fileSize=st.st_size;
+    ring->useMmap=useMmap;
+    ring->map=NULL;
+
+    if(useMmap && (ring->fileSize > 0))
+    {
+        ring->map=mmap(NULL, ring->fileSize, PROT_READ, MAP_SHARED, ring->fd, 0);
+        if(ring->map == MAP_FAILED)
+        {
+            perror("filehash: mmap");
+            close(ring->fd);
+            return -1;
+        }
+        madvise(ring->map, ring->fileSize, MADV_SEQUENTIAL);
+    }
+
+    for(idx=0; idx<ring->nslots; idx++)
+    {
+        ring->slot[idx].data=buffers[idx];
+        ring->slot[idx].seq=-1;
+        ring->slot[idx].pending=0;
+        ring->slot[idx].eof=FALSE;
+    }
+    ring->nhashers=nalgs;
+    ring->error=FALSE;
+    ring->bytes=0;
+
+    gettimeofday(&start, NULL);
+
+    for(idx=0; idx<nalgs; idx++)
+    {
+        hasher[idx].ring=ring;
+        hasher[idx].alg=algs[idx];
+        pthread_create(&hasher[idx].thread, NULL, hasherThread, &hasher[idx]);
+    }
+    pthread_create(&reader, NULL, readerThread, ring);
+
+    pthread_join(reader, NULL);
+    for(idx=0; idx<nalgs; idx++)
+        pthread_join(hasher[idx].thread, NULL);
+
+    gettimeofday(&stop, NULL);
+
+    if(ring->map != NULL)
+        munmap(ring->map, ring->fileSize);
+    close(ring->fd);
+
+    if(ring->error)
+    {
+        fprintf(stderr, "filehash: %s: read failed, no digest\n", path);
+        return -1;
+    }
+
+    for(idx=0; idx<nalgs; idx++)
+    {
+        printf("%s (%s) = ", algNames[algs[idx]], path);
+        for(byte=0; byte<algDigestSize[algs[idx]]; byte++)
+            printf("%02x", hasher[idx].digest[byte]);
+        printf("\n");
+    }
+
+    if(verbose)
+    {
+        secs=elapsedSecs(&start, &stop);
+        printf("%s: %lld bytes in %.3lf secs, %.1lf MB/s, %d digests\n", path, ring->bytes, secs,
+               (secs > 0.0) ? ((double)ring->bytes/1.0e6)/secs : 0.0, nalgs);
+    }
+
+    return 0;
+}
+
+
+// Parse "md5,sha256,..." or "all" into algs, returns the count or -1
+//
+int parseAlgs(char *list, int *algs)
+{
+    char *name, *save=NULL;
+    int nalgs=0, alg, seen[ALG_COUNT]={0};
+
+    if(strcasecmp(list, "all") == 0)
+    {
+        for(alg=0; alg<ALG_COUNT; alg++)
+            algs[alg]=alg;
+        return ALG_COUNT;
+    }
+
+    for(name=strtok_r(list, ",", &save); name != NULL; name=strtok_r(NULL, ",", &save))
+    {
+        for(alg=0; alg<ALG_COUNT; alg++)
+            if(strcasecmp(name, algNames[alg]) == 0)
+                break;
+
+        if(alg == ALG_COUNT)
+        {
+            fprintf(stderr, "filehash: unknown digest %s\n", name);
+            return -1;
+        }
+
+        if(!seen[alg])
+        {
+            seen[alg]=TRUE;
+            algs[nalgs++]=alg;
+        }
+    }
+
+    return nalgs;
+}
+
+
+void usage(void)
+{
+    printf("usage: filehash [-a md5,sha1,sha256,crc32,crc32c|all] [-b KiB] [-n buffers] [-d|-m] [-v] file ...\n");
+    printf("       -d  O_DIRECT reads, -m mmap the file, -v throughput per file\n");
+}
+
+
+int main(int argc, char *argv[])
+{
+    hashRing_t ring;
+    unsigned char *buffers[MAX_RING_BUFFERS];
+    char defaultAlgs[]="all";
+    char *algList=defaultAlgs;
+    int algs[ALG_COUNT], nalgs, opt, idx, rc=0;
+    int useMmap=FALSE, direct=FALSE, verbose=FALSE, bufKB=BUFFER_KB;
+
+    ring.nslots=RING_BUFFERS;
+
+    while((opt=getopt(argc, argv, "a:b:n:dmv")) != -1)
+    {
+        switch(opt)
+        {
+            case 'a': algList=optarg; break;
+            case 'b': bufKB=atoi(optarg); break;
+            case 'n': ring.nslots=atoi(optarg); break;
+            case 'd': direct=TRUE; break;
+            case 'm': useMmap=TRUE; break;
+            case 'v': verbose=TRUE; break;
+            default: usage(); exit(-1);
+        }
+    }
+
+    if((optind >= argc) || (bufKB < 4) || (ring.nslots < 2) || (ring.nslots > MAX_RING_BUFFERS))
+    {
+        usage();
+        exit(-1);
+    }
+
+    if((nalgs=parseAlgs(algList, algs)) <= 0)
+        exit(-1);
+
+    // whole pages, so O_DIRECT offsets and lengths stay block aligned
+    ring.bufSize=((size_t)bufKB*1024 + BUFFER_ALIGN-1) & ~((size_t)BUFFER_ALIGN-1);
+
+    for(idx=0; idx<ring.nslots; idx++)
+    {
+        buffers[idx]=NULL;
+        if(!useMmap && (posix_memalign((void **)&buffers[idx], BUFFER_ALIGN, ring.bufSize) != 0))
+        {
+            perror("filehash: posix_memalign");
+            exit(-1);
+        }
+    }
+
+    pthread_mutex_init(&ring.lock, NULL);
+    pthread_cond_init(&ring.filled, NULL);
+    pthread_cond_init(&ring.drained, NULL);
+
+    for(idx=optind; idx<argc; idx++)
+    {
+        if(hashFile(argv[idx], algs, nalgs, &ring, buffers, useMmap, direct, verbose) != 0)
+            rc=1;
+    }
+
+    pthread_cond_destroy(&ring.drained);
+    pthread_cond_destroy(&ring.filled);
+    pthread_mutex_destroy(&ring.lock);
+
+    for(idx=0; idx<ring.nslots; idx++)
+        free(buffers[idx]);
+
+    return rc;
+}
@@ -0,0 +1,433 @@
+/**********************************************************************
+ *
+ * Filename:    mbhash.c
+ *
+ * Description: Multi-buffer MD5, SHA-1 and SHA-256.
+ *
+ * Notes:       The single-buffer hashes in md5.c, sha1.c and sha2.c
+ *              are a long chain of dependent 32-bit operations, so a
+ *              short message leaves most of a modern core idle.  Here
+ *              4 (SSE2) or 8 (AVX2) unrelated messages are hashed at
+ *              once, each in its own 32-bit lane of a vector register.
+ *
+ *              The scheduler keeps every lane busy: each step runs all
+ *              lanes for as many blocks as the shortest one has left,
+ *              then hands the lanes that finished to the next queued
+ *              messages.  Mixed lengths therefore cost no idle lanes
+ *              until the final mbFlush().
+ *
+ **********************************************************************/
+
+#include <string.h>
+
+#include "mbhash.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define MB_X86_AVX2
+#endif
+
+static const uint32_t md5T[64] =
+{
+	0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+	0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be, 0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+	0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+	0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+	0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c, 0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+	0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+	0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+	0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1, 0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391
+};
+
+static const int md5Shift[64] =
+{
+	7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22,
+	5,  9, 14, 20, 5,  9, 14, 20, 5,  9, 14, 20, 5,  9, 14, 20,
+	4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23,
+	6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21
+};
+
+static const int md5Index[64] =
+{
+	0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15,
+	1, 6, 11, 0, 5, 10, 15, 4, 9, 14, 3, 8, 13, 2, 7, 12,
+	5, 8, 11, 14, 1, 4, 7, 10, 13, 0, 3, 6, 9, 12, 15, 2,
+	0, 7, 14, 5, 12, 3, 10, 1, 8, 15, 6, 13, 4, 11, 2, 9
+};
+
+static const uint32_t sha256K[64] =
+{
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static const uint32_t mbInitState[MB_ALG_COUNT][8] =
+{
+	{ 0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476 },
+	{ 0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0 },
+	{ 0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19 }
+};
+
+static const int mbStateWords[MB_ALG_COUNT] = { 4, 5, 8 };
+static const char *mbAlgNames[MB_ALG_COUNT] = { "MD5", "SHA-1", "SHA-256" };
+
+
+/* Byte order independent loads, compiled to plain (or bswapped) loads. */
+static inline uint32_t
+load32LE(unsigned char const *p)
+{
+	return ((uint32_t) p[0] | ((uint32_t) p[1] << 8) | ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24));
+}
+
+
+static inline uint32_t
+load32BE(unsigned char const *p)
+{
+	return (((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16) | ((uint32_t) p[2] << 8) | (uint32_t) p[3]);
+}
+
+
+/*
+ * 4 lanes - SSE2 on x86-64, AltiVec/VSX or plain scalar code elsewhere.
+ */
+#define MB_LANES	4
+#define MB_VEC		mbVec4_t
+#define MB_FN(name)	name##X4
+#include "mbkernel.h"
+#undef MB_LANES
+#undef MB_VEC
+#undef MB_FN
+
+/*
+ * 8 lanes - AVX2, picked at run time so the build still runs on
+ * CPUs without it.
+ */
+#ifdef MB_X86_AVX2
+#pragma GCC push_options
+#pragma GCC target("avx2")
+#define MB_LANES	8
+#define MB_VEC		mbVec8_t
+#define MB_FN(name)	name##X8
+#include "mbkernel.h"
+#undef MB_LANES
+#undef MB_VEC
+#undef MB_FN
+#pragma GCC pop_options
+#endif
+
+
+typedef void (*mbBlocksFn)(uint32_t state[8][MB_MAX_LANES], unsigned char const *next[], size_t nBlocks);
+
+static const mbBlocksFn mbBlocksX4[MB_ALG_COUNT] = { md5BlocksX4, sha1BlocksX4, sha256BlocksX4 };
+#ifdef MB_X86_AVX2
+static const mbBlocksFn mbBlocksX8[MB_ALG_COUNT] = { md5BlocksX8, sha1BlocksX8, sha256BlocksX8 };
+#endif
+
+
+/*********************************************************************
+ *
+ * Function:    mbLanesSupported()
+ *
+ * Description: Widest lane count this CPU can run.
+ *
+ *********************************************************************/
+int
+mbLanesSupported(void)
+{
+#ifdef MB_X86_AVX2
+	if (__builtin_cpu_supports("avx2"))
+	{
+		return (8);
+	}
+#endif
+
+	return (4);
+
+}   /* mbLanesSupported() */
+
+
+int
+mbDigestSize(int alg)
+{
+	return (4 * mbStateWords[alg]);
+}
+
+
+const char *
+mbAlgName(int alg)
+{
+	return (((alg >= 0) && (alg < MB_ALG_COUNT)) ? mbAlgNames[alg] : "unknown");
+}
+
+
+/*********************************************************************
+ *
+ * Function:    mbMgrInit()
+ *
+ * Description: Set up an empty lane manager for one algorithm.
+ *
+ * Notes:		lanes is 4, 8 or 0 for the widest the CPU supports.
+ *
+ * Returns:		The lane count used, or -1 if alg or lanes is invalid.
+ *
+ *********************************************************************/
+int
+mbMgrInit(mbMgr_t *mgr, int alg, int lanes)
+{
+	if (lanes == 0)
+	{
+		lanes = mbLanesSupported();
+	}
+
+	if ((alg < 0) || (alg >= MB_ALG_COUNT) || ((lanes != 4) && (lanes != 8)) ||
+	    (lanes > mbLanesSupported()))
+	{
+		return (-1);
+	}
+
+	memset(mgr, 0, sizeof(*mgr));
+	mgr->alg = alg;
+	mgr->lanes = lanes;
+
+	return (lanes);
+
+}   /* mbMgrInit() */
+
+
+/*
+ * Start a message in a free lane: run its whole blocks in place, and
+ * build the tail, 0x80, zeros and the bit length in pad[].
+ */
+static void
+mbLaneStart(mbMgr_t *mgr, int lane, mbJob_t *job)
+{
+	unsigned char  *pad = mgr->pad[lane];
+	size_t          tail = job->nBytes % MB_BLOCK_SIZE;
+	uint64_t        bits = (uint64_t) job->nBytes * 8;
+	int             word, padBytes, i;
+
+	for (word = 0; word < 8; ++word)
+	{
+		mgr->state[word][lane] = mbInitState[mgr->alg][word];
+	}
+
+	padBytes = (tail < MB_BLOCK_SIZE - 8) ? MB_BLOCK_SIZE : 2 * MB_BLOCK_SIZE;
+
+	memcpy(pad, job->message + (job->nBytes - tail), tail);
+	pad[tail] = 0x80;
+	memset(pad + tail + 1, 0, padBytes - tail - 1);
+
+	for (i = 0; i < 8; ++i)
+	{
+		if (mgr->alg == MB_MD5)
+			pad[padBytes - 8 + i] = (unsigned char) (bits >> (8 * i));
+		else
+			pad[padBytes - 1 - i] = (unsigned char) (bits >> (8 * i));
+	}
+
+	mgr->job[lane] = job;
+	mgr->next[lane] = job->message;
+	mgr->blocks[lane] = job->nBytes / MB_BLOCK_SIZE;
+	mgr->padBlocks[lane] = padBytes / MB_BLOCK_SIZE;
+	job->done = 0;
+	mgr->busy++;
+
+	if (mgr->blocks[lane] == 0)
+	{
+		mgr->next[lane] = pad;
+		mgr->blocks[lane] = mgr->padBlocks[lane];
+		mgr->padBlocks[lane] = 0;
+	}
+}
+
+
+/*
+ * A lane ran out of blocks - move it on to its padding, or finish it.
+ * Returns TRUE if the lane's message is done.
+ */
+static int
+mbLaneAdvance(mbMgr_t *mgr, int lane)
+{
+	mbJob_t  *job = mgr->job[lane];
+	uint32_t  word;
+	int       i;
+
+	if (mgr->padBlocks[lane])
+	{
+		mgr->next[lane] = mgr->pad[lane];
+		mgr->blocks[lane] = mgr->padBlocks[lane];
+		mgr->padBlocks[lane] = 0;
+		return (0);
+	}
+
+	for (i = 0; i < mbStateWords[mgr->alg]; ++i)
+	{
+		word = mgr->state[i][lane];
+
+		if (mgr->alg == MB_MD5)
+		{
+			job->digest[4 * i + 0] = (unsigned char) word;
+			job->digest[4 * i + 1] = (unsigned char) (word >> 8);
+			job->digest[4 * i + 2] = (unsigned char) (word >> 16);
+			job->digest[4 * i + 3] = (unsigned char) (word >> 24);
+		}
+		else
+		{
+			job->digest[4 * i + 0] = (unsigned char) (word >> 24);
+			job->digest[4 * i + 1] = (unsigned char) (word >> 16);
+			job->digest[4 * i + 2] = (unsigned char) (word >> 8);
+			job->digest[4 * i + 3] = (unsigned char) word;
+		}
+	}
+
+	job->done = 1;
+	mgr->job[lane] = NULL;
+	mgr->busy--;
+
+	return (1);
+}
+
+
+/*
+ * Run every lane for as many blocks as the busy lane with the fewest
+ * left, then settle the lanes that ran out.  Idle lanes shadow a busy
+ * one so they only ever read valid memory; their results are ignored.
+ * Returns the number of messages finished.
+ */
+static int
+mbStep(mbMgr_t *mgr)
+{
+	unsigned char const  *next[MB_MAX_LANES];
+	size_t                run = 0;
+	int                   lane, busyLane = -1, finished = 0;
+
+	for (lane = 0; lane < mgr->lanes; ++lane)
+	{
+		if (mgr->job[lane] && ((busyLane < 0) || (mgr->blocks[lane] < run)))
+		{
+			run = mgr->blocks[lane];
+			busyLane = lane;
+		}
+	}
+
+	if (busyLane < 0)
+	{
+		return (0);
+	}
+
+	for (lane = 0; lane < mgr->lanes; ++lane)
+	{
+		next[lane] = mgr->job[lane] ? mgr->next[lane] : mgr->next[busyLane];
+	}
+
+#ifdef MB_X86_AVX2
+	if (mgr->lanes == 8)
+		mbBlocksX8[mgr->alg](mgr->state, next, run);
+	else
+#endif
+		mbBlocksX4[mgr->alg](mgr->state, next, run);
+
+	for (lane = 0; lane < mgr->lanes; ++lane)
+	{
+		if (mgr->job[lane])
+		{
+			mgr->next[lane] = next[lane];
+			mgr->blocks[lane] -= run;
+
+			if (mgr->blocks[lane] == 0)
+			{
+				finished += mbLaneAdvance(mgr, lane);
+			}
+		}
+	}
+
+	return (finished);
+}
+
+
+/*********************************************************************
+ *
+ * Function:    mbSubmit()
+ *
+ * Description: Queue a message.  If every lane is then busy the lanes
+ *				are run until at least one message finishes.
+ *
+ * Notes:		job->message must stay valid until job->done is set.
+ *
+ * Returns:		The number of messages (this or earlier ones) finished.
+ *
+ *********************************************************************/
+int
+mbSubmit(mbMgr_t *mgr, mbJob_t *job)
+{
+	int  lane, finished = 0;
+
+	for (lane = 0; mgr->job[lane]; ++lane);
+
+	mbLaneStart(mgr, lane, job);
+
+	while (mgr->busy == mgr->lanes)
+	{
+		finished += mbStep(mgr);
+	}
+
+	return (finished);
+
+}   /* mbSubmit() */
+
+
+/*********************************************************************
+ *
+ * Function:    mbFlush()
+ *
+ * Description: Finish every message still in a lane.
+ *
+ * Returns:		The number of messages finished.
+ *
+ *********************************************************************/
+int
+mbFlush(mbMgr_t *mgr)
+{
+	int  finished = 0;
+
+	while (mgr->busy)
+	{
+		finished += mbStep(mgr);
+	}
+
+	return (finished);
+
+}   /* mbFlush() */
+
+
+/*********************************************************************
+ *
+ * Function:    mbHashMessages()
+ *
+ * Description: Hash a batch of messages, lanes as for mbMgrInit().
+ *
+ *********************************************************************/
+void
+mbHashMessages(int alg, int lanes, mbJob_t jobs[], int nJobs)
+{
+	mbMgr_t  mgr;
+	int      i;
+
+	if (mbMgrInit(&mgr, alg, lanes) < 0)
+	{
+		return;
+	}
+
+	for (i = 0; i < nJobs; ++i)
+	{
+		mbSubmit(&mgr, &jobs[i]);
+	}
+
+	mbFlush(&mgr);
+
+}   /* mbHashMessages() */
@@ -0,0 +1,67 @@
+/**********************************************************************
+ *
+ * Filename:    mbhash.h
+ *
+ * Description: Multi-buffer MD5, SHA-1 and SHA-256.
+ *
+ * Notes:       Independent messages are hashed side by side, one per
+ *              SIMD lane, so many short messages cost little more than
+ *              one.  Queue messages with mbSubmit(), then mbFlush() to
+ *              finish the ones still in flight.  Digests are the same
+ *              as md5_finish(), sha1() and sha256() give.
+ *
+ **********************************************************************/
+
+#ifndef _mbhash_h
+#define _mbhash_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define MB_MD5				0
+#define MB_SHA1				1
+#define MB_SHA256			2
+#define MB_ALG_COUNT		3
+
+#define MB_MAX_LANES		8	/* AVX2, 8 x 32-bit words */
+#define MB_MAX_DIGEST		32
+#define MB_BLOCK_SIZE		64
+
+
+typedef struct mbJob
+{
+	const unsigned char	*message;
+	size_t				nBytes;
+	unsigned char		digest[MB_MAX_DIGEST];
+	int					done;
+} mbJob_t;
+
+/*
+ * One lane per message being hashed.  A lane first runs over the whole
+ * blocks of its message in place, then over one or two padding blocks
+ * built in pad[].  Lanes are refilled from the queue as they finish.
+ */
+typedef struct mbMgr
+{
+	uint32_t			state[8][MB_MAX_LANES] __attribute__((aligned(32)));
+	const unsigned char	*next[MB_MAX_LANES];
+	size_t				blocks[MB_MAX_LANES];
+	int					padBlocks[MB_MAX_LANES];
+	mbJob_t				*job[MB_MAX_LANES];
+	unsigned char		pad[MB_MAX_LANES][2 * MB_BLOCK_SIZE];
+	int					alg;
+	int					lanes;
+	int					busy;
+} mbMgr_t;
+
+
+int         mbMgrInit(mbMgr_t *mgr, int alg, int lanes);
+int         mbSubmit(mbMgr_t *mgr, mbJob_t *job);
+int         mbFlush(mbMgr_t *mgr);
+void        mbHashMessages(int alg, int lanes, mbJob_t jobs[], int nJobs);
+int         mbLanesSupported(void);
+int         mbDigestSize(int alg);
+const char *mbAlgName(int alg);
+
+
+#endif /* _mbhash_h */
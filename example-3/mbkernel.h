@@ -0,0 +1,251 @@
+/**********************************************************************
+ *
+ * Filename:    mbkernel.h
+ *
+ * Description: Lane-parallel MD5, SHA-1 and SHA-256 compression.
+ *
+ * Notes:       Included by mbhash.c once per lane width, with
+ *              MB_LANES, MB_VEC and MB_FN() defined.  Each function
+ *              runs nBlocks 64-byte blocks from every lane's next[]
+ *              pointer through the lane's column of state[][], then
+ *              advances the pointers.  The arithmetic uses GCC vector
+ *              types, so the same source compiles to SSE2, AVX2 or
+ *              whatever the target offers.
+ *
+ **********************************************************************/
+
+typedef uint32_t MB_VEC __attribute__((vector_size(MB_LANES * 4)));
+
+#define MB_ROTL(x, n)	(((x) << (n)) | ((x) >> (32 - (n))))
+
+#define MB_MD5_STEP(fn, i)											\
+	f = a + (fn) + x[md5Index[i]] + md5T[i];						\
+	a = d; d = c; c = b;											\
+	b = b + MB_ROTL(f, md5Shift[i])
+
+
+static inline MB_VEC
+MB_FN(loadState)(uint32_t const *words)
+{
+	MB_VEC  v;
+
+	memcpy(&v, words, sizeof(v));
+
+	return (v);
+}
+
+
+static inline void
+MB_FN(storeState)(uint32_t *words, MB_VEC v)
+{
+	memcpy(words, &v, sizeof(v));
+}
+
+
+/*
+ * Gather word i of the current block of every lane.
+ */
+static inline MB_VEC
+MB_FN(loadLE)(unsigned char const *const next[], int i)
+{
+	MB_VEC  v;
+	int     lane;
+
+	for (lane = 0; lane < MB_LANES; ++lane)
+	{
+		v[lane] = load32LE(next[lane] + 4 * i);
+	}
+
+	return (v);
+}
+
+
+static inline MB_VEC
+MB_FN(loadBE)(unsigned char const *const next[], int i)
+{
+	MB_VEC  v;
+	int     lane;
+
+	for (lane = 0; lane < MB_LANES; ++lane)
+	{
+		v[lane] = load32BE(next[lane] + 4 * i);
+	}
+
+	return (v);
+}
+
+
+static void
+MB_FN(md5Blocks)(uint32_t state[8][MB_MAX_LANES], unsigned char const *next[], size_t nBlocks)
+{
+	MB_VEC  a, b, c, d, aa, bb, cc, dd, f, x[16];
+	int     i, lane;
+
+	a = MB_FN(loadState)(state[0]);
+	b = MB_FN(loadState)(state[1]);
+	c = MB_FN(loadState)(state[2]);
+	d = MB_FN(loadState)(state[3]);
+
+	for (; nBlocks > 0; --nBlocks)
+	{
+		for (i = 0; i < 16; ++i)
+		{
+			x[i] = MB_FN(loadLE)(next, i);
+		}
+
+		aa = a; bb = b; cc = c; dd = d;
+
+		for (i = 0; i < 16; ++i)
+		{
+			MB_MD5_STEP((((c ^ d) & b) ^ d), i);
+		}
+		for (; i < 32; ++i)
+		{
+			MB_MD5_STEP((((b ^ c) & d) ^ c), i);
+		}
+		for (; i < 48; ++i)
+		{
+			MB_MD5_STEP((b ^ c ^ d), i);
+		}
+		for (; i < 64; ++i)
+		{
+			MB_MD5_STEP((c ^ (b | ~d)), i);
+		}
+
+		a += aa; b += bb; c += cc; d += dd;
+
+		for (lane = 0; lane < MB_LANES; ++lane)
+		{
+			next[lane] += MB_BLOCK_SIZE;
+		}
+	}
+
+	MB_FN(storeState)(state[0], a);
+	MB_FN(storeState)(state[1], b);
+	MB_FN(storeState)(state[2], c);
+	MB_FN(storeState)(state[3], d);
+}
+
+
+static void
+MB_FN(sha1Blocks)(uint32_t state[8][MB_MAX_LANES], unsigned char const *next[], size_t nBlocks)
+{
+	MB_VEC  a, b, c, d, e, aa, bb, cc, dd, ee, f, t, w[16];
+	int     i, lane;
+
+	a = MB_FN(loadState)(state[0]);
+	b = MB_FN(loadState)(state[1]);
+	c = MB_FN(loadState)(state[2]);
+	d = MB_FN(loadState)(state[3]);
+	e = MB_FN(loadState)(state[4]);
+
+	for (; nBlocks > 0; --nBlocks)
+	{
+		aa = a; bb = b; cc = c; dd = d; ee = e;
+
+		for (i = 0; i < 80; ++i)
+		{
+			if (i < 16)
+			{
+				w[i] = MB_FN(loadBE)(next, i);
+			}
+			else
+			{
+				t = w[(i + 13) & 15] ^ w[(i + 8) & 15] ^ w[(i + 2) & 15] ^ w[i & 15];
+				w[i & 15] = MB_ROTL(t, 1);
+			}
+
+			if (i < 20)
+				f = (((c ^ d) & b) ^ d) + 0x5A827999;
+			else if (i < 40)
+				f = (b ^ c ^ d) + 0x6ED9EBA1;
+			else if (i < 60)
+				f = ((b & c) | ((b | c) & d)) + 0x8F1BBCDC;
+			else
+				f = (b ^ c ^ d) + 0xCA62C1D6;
+
+			t = MB_ROTL(a, 5) + f + e + w[i & 15];
+			e = d; d = c;
+			c = MB_ROTL(b, 30);
+			b = a; a = t;
+		}
+
+		a += aa; b += bb; c += cc; d += dd; e += ee;
+
+		for (lane = 0; lane < MB_LANES; ++lane)
+		{
+			next[lane] += MB_BLOCK_SIZE;
+		}
+	}
+
+	MB_FN(storeState)(state[0], a);
+	MB_FN(storeState)(state[1], b);
+	MB_FN(storeState)(state[2], c);
+	MB_FN(storeState)(state[3], d);
+	MB_FN(storeState)(state[4], e);
+}
+
+
+static void
+MB_FN(sha256Blocks)(uint32_t state[8][MB_MAX_LANES], unsigned char const *next[], size_t nBlocks)
+{
+	MB_VEC  h[8], v[8], w[16], s0, s1, t1, t2;
+	int     i, j, lane;
+
+	for (j = 0; j < 8; ++j)
+	{
+		h[j] = MB_FN(loadState)(state[j]);
+	}
+
+	for (; nBlocks > 0; --nBlocks)
+	{
+		for (j = 0; j < 8; ++j)
+		{
+			v[j] = h[j];
+		}
+
+		for (i = 0; i < 64; ++i)
+		{
+			if (i < 16)
+			{
+				w[i] = MB_FN(loadBE)(next, i);
+			}
+			else
+			{
+				s0 = w[(i + 1) & 15];
+				s0 = MB_ROTL(s0, 25) ^ MB_ROTL(s0, 14) ^ (s0 >> 3);
+				s1 = w[(i + 14) & 15];
+				s1 = MB_ROTL(s1, 15) ^ MB_ROTL(s1, 13) ^ (s1 >> 10);
+				w[i & 15] += s0 + s1 + w[(i + 9) & 15];
+			}
+
+			t1 = v[7] + (MB_ROTL(v[4], 26) ^ MB_ROTL(v[4], 21) ^ MB_ROTL(v[4], 7)) +
+			     (((v[5] ^ v[6]) & v[4]) ^ v[6]) + sha256K[i] + w[i & 15];
+			t2 = (MB_ROTL(v[0], 30) ^ MB_ROTL(v[0], 19) ^ MB_ROTL(v[0], 10)) +
+			     ((v[0] & v[1]) | ((v[0] | v[1]) & v[2]));
+
+			v[7] = v[6]; v[6] = v[5]; v[5] = v[4];
+			v[4] = v[3] + t1;
+			v[3] = v[2]; v[2] = v[1]; v[1] = v[0];
+			v[0] = t1 + t2;
+		}
+
+		for (j = 0; j < 8; ++j)
+		{
+			h[j] += v[j];
+		}
+
+		for (lane = 0; lane < MB_LANES; ++lane)
+		{
+			next[lane] += MB_BLOCK_SIZE;
+		}
+	}
+
+	for (j = 0; j < 8; ++j)
+	{
+		MB_FN(storeState)(state[j], h[j]);
+	}
+}
+
+#undef MB_ROTL
+#undef MB_MD5_STEP
@@ -4,17 +4,28 @@
 #include <pthread.h>
 #include <sched.h>
 #include <stdlib.h>
+#include <string.h>
 #include <signal.h>
 #include <semaphore.h>
 
 #include "md5.h"
+#include "crc.h"
+#include "sha1.h"
+#include "sha2.h"
+#include "mbhash.h"
 
 #define SCHED_POLICY SCHED_FIFO
 #define THREAD_ITERATIONS 100000
 #define ITERATIONS 100000
 #define MAX_THREADS 256
+#ifndef TRUE
 #define TRUE 1
 #define FALSE 0
+#endif
+#define CRC_TEST_BYTES (64*1024*1024)
+#define CRC_TEST_ITERATIONS 8
+#define MB_TEST_MESSAGES 1024
+#define MB_TEST_BYTES (32*1024*1024)
 
 static const char test[512]="#0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ##0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ##0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ##0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ##0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ##0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ##0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ##0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ#";
 
@@ -159,6 +170,160 @@ void *digestThread(void *threadparam)
 }
 
 
+// Throughput of every CRC-32/CRC-32C engine over one large buffer, with
+// all engines checked against the byte at a time table.
+//
+void crcThroughput(void)
+{
+	unsigned char *buffer;
+	struct timeval StartTime, StopTime;
+	double secs;
+	uint32_t crcResult=0, reference;
+	int poly, impl, i;
+	static const char *polyNames[CRC32_POLY_COUNT] = {"CRC-32", "CRC-32C"};
+
+	if((buffer=malloc(CRC_TEST_BYTES)) == NULL)
+	{
+		perror("malloc");
+		exit(-1);
+	}
+
+	for(i=0;i<CRC_TEST_BYTES;i++)
+		buffer[i]=(unsigned char)(i*31 + (i>>11));
+
+	printf("\nCRC throughput over %d MB, %d iterations\n", CRC_TEST_BYTES/(1024*1024), CRC_TEST_ITERATIONS);
+
+	for(poly=0;poly<CRC32_POLY_COUNT;poly++)
+	{
+		reference=crc32UpdateImpl(poly, CRC32_IMPL_BYTE, 0, buffer, CRC_TEST_BYTES);
+
+		for(impl=0;impl<CRC32_IMPL_COUNT;impl++)
+		{
+			if(!crc32ImplSupported(poly, impl))
+			{
+				printf("%-8s %-12s not supported on this CPU\n", polyNames[poly], crc32ImplName(impl));
+				continue;
+			}
+
+			gettimeofday(&StartTime, 0);
+			for(i=0;i<CRC_TEST_ITERATIONS;i++)
+				crcResult=crc32UpdateImpl(poly, impl, 0, buffer, CRC_TEST_BYTES);
+			gettimeofday(&StopTime, 0);
+
+			secs=(double)(StopTime.tv_sec - StartTime.tv_sec) + (double)(StopTime.tv_usec - StartTime.tv_usec)/1000000.0;
+
+			printf("%-8s %-12s %8.3lf GB/s  CRC=0x%08x%s%s\n", polyNames[poly], crc32ImplName(impl),
+			       ((double)CRC_TEST_BYTES*CRC_TEST_ITERATIONS/1.0e9)/secs, crcResult,
+			       (crcResult == reference) ? "" : " MISMATCH",
+			       (impl == crc32SelectedImpl(poly)) ? "  (selected)" : "");
+		}
+	}
+
+	free(buffer);
+}
+
+
+// Single thread messages/sec for short messages, one at a time with the
+// md5.c/sha1.c/sha2.c calls and then lane parallel through mbhash.c, with
+// every multi-buffer digest checked against the single-buffer one.
+//
+void mbThroughput(void)
+{
+	static const int sizes[] = {64, 256, 1024, 4096};
+	unsigned char *buffer, (*reference)[MB_MAX_DIGEST];
+	mbJob_t *jobs;
+	md5_state_t state;
+	struct timeval StartTime, StopTime;
+	double secs, rate, baseRate;
+	int alg, size, lanes, rounds, round, i, j, mismatches;
+
+	buffer=malloc(MB_TEST_MESSAGES*4096);
+	reference=malloc(MB_TEST_MESSAGES*sizeof(*reference));
+	jobs=malloc(MB_TEST_MESSAGES*sizeof(mbJob_t));
+	if((buffer == NULL) || (reference == NULL) || (jobs == NULL))
+	{
+		perror("malloc");
+		exit(-1);
+	}
+
+	for(i=0;i<MB_TEST_MESSAGES*4096;i++)
+		buffer[i]=(unsigned char)(i*131 + (i>>9));
+
+	printf("\nMulti-buffer hashing, %d lanes supported, %d messages per batch\n", mbLanesSupported(), MB_TEST_MESSAGES);
+	printf("%-8s %5s %-8s %12s %8s\n", "digest", "bytes", "lanes", "messages/s", "speedup");
+
+	for(alg=0;alg<MB_ALG_COUNT;alg++)
+	{
+		for(size=0;size<(int)(sizeof(sizes)/sizeof(sizes[0]));size++)
+		{
+			rounds=MB_TEST_BYTES/(MB_TEST_MESSAGES*sizes[size]);
+
+			gettimeofday(&StartTime, 0);
+			for(round=0;round<rounds;round++)
+			{
+				for(i=0;i<MB_TEST_MESSAGES;i++)
+				{
+					unsigned char *message=&buffer[i*sizes[size]];
+
+					if(alg == MB_MD5)
+					{
+						md5_init(&state);
+						md5_append(&state, (const md5_byte_t *)message, sizes[size]);
+						md5_finish(&state, reference[i]);
+					}
+					else if(alg == MB_SHA1)
+						sha1(message, sizes[size], reference[i]);
+					else
+						sha256(message, sizes[size], reference[i]);
+				}
+			}
+			gettimeofday(&StopTime, 0);
+
+			secs=(double)(StopTime.tv_sec - StartTime.tv_sec) + (double)(StopTime.tv_usec - StartTime.tv_usec)/1000000.0;
+			baseRate=((double)rounds*MB_TEST_MESSAGES)/secs;
+			printf("%-8s %5d %-8s %12.0lf %8.2lf\n", mbAlgName(alg), sizes[size], "single", baseRate, 1.0);
+
+			for(lanes=4;lanes<=mbLanesSupported();lanes*=2)
+			{
+				for(i=0;i<MB_TEST_MESSAGES;i++)
+				{
+					jobs[i].message=&buffer[i*sizes[size]];
+					jobs[i].nBytes=sizes[size];
+				}
+
+				gettimeofday(&StartTime, 0);
+				for(round=0;round<rounds;round++)
+					mbHashMessages(alg, lanes, jobs, MB_TEST_MESSAGES);
+				gettimeofday(&StopTime, 0);
+
+				for(i=0, mismatches=0;i<MB_TEST_MESSAGES;i++)
+				{
+					for(j=0;j<mbDigestSize(alg);j++)
+					{
+						if(jobs[i].digest[j] != reference[i][j])
+						{
+							mismatches++;
+							break;
+						}
+					}
+				}
+
+				secs=(double)(StopTime.tv_sec - StartTime.tv_sec) + (double)(StopTime.tv_usec - StartTime.tv_usec)/1000000.0;
+				rate=((double)rounds*MB_TEST_MESSAGES)/secs;
+				printf("%-8s %5d %-8d %12.0lf %8.2lf", mbAlgName(alg), sizes[size], lanes, rate, rate/baseRate);
+				if(mismatches)
+					printf("  %d DIGEST MISMATCHES", mismatches);
+				printf("\n");
+			}
+		}
+	}
+
+	free(buffer);
+	free(reference);
+	free(jobs);
+}
+
+
 void thread_shutdown(int signum)
 {
     int i;
@@ -187,6 +352,20 @@ int main(int argc, char *argv[])
 	unsigned char shaDigest[20];
 	unsigned char shaDigest256[32];
 
+        // testdigest crc - CRC engine throughput only
+        if((argc >= 2) && (strcmp(argv[1], "crc") == 0))
+        {
+            crcThroughput();
+            return 0;
+        }
+
+        // testdigest mb - single thread multi-buffer MD5/SHA-1/SHA-256 messages/sec
+        if((argc >= 2) && (strcmp(argv[1], "mb") == 0))
+        {
+            mbThroughput();
+            return 0;
+        }
+
         if(argc < 2)
 	{
 		numThreads=4;
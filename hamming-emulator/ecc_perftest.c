@@ -0,0 +1,87 @@
+#include <time.h>
+#include <string.h>
+#include "ecclib.h"
+
+#define DEFAULT_MB (64)
+#define DEFAULT_ITERATIONS (4)
+
+
+static double elapsed_secs(struct timespec *start, struct timespec *stop)
+{
+    return (double)(stop->tv_sec - start->tv_sec) + (double)(stop->tv_nsec - start->tv_nsec)/1000000000.0;
+}
+
+
+// Throughput of whole buffer ECC writes and reads in one mode, then reads
+// again with a single bit error injected every 4 KiB
+//
+static void bench_mode(int mode, size_t size, int iterations)
+{
+    ecc_t ECC;
+    unsigned char *base_addr, *buffer;
+    struct timespec start, stop;
+    double writeSecs, readSecs, errorSecs;
+    size_t idx;
+    int iter, rc=NO_ERROR;
+
+    if((base_addr=ecc_init(&ECC, size, mode)) == NULL)
+    {
+        printf("could not allocate %zu bytes of ECC memory\n", size);
+        return;
+    }
+
+    buffer=malloc(size);
+    for(idx=0; idx < size; idx++)
+        buffer[idx]=(unsigned char)(idx ^ (idx >> 8));
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for(iter=0; iter < iterations; iter++)
+        ecc_write_block(&ECC, base_addr, buffer, size);
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+    writeSecs=elapsed_secs(&start, &stop);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for(iter=0; iter < iterations; iter++)
+        rc=ecc_read_block(&ECC, base_addr, buffer, size);
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+    readSecs=elapsed_secs(&start, &stop);
+
+    if(rc != NO_ERROR)
+        printf("clean read returned %d\n", rc);
+
+    for(idx=0; idx < size; idx+=4096)
+        base_addr[idx] ^= DATA_BIT_3;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for(iter=0; iter < iterations; iter++)
+        ecc_read_block(&ECC, base_addr, buffer, size);
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+    errorSecs=elapsed_secs(&start, &stop);
+
+    printf("%-7s overhead %5.1lf%%: write %8.1lf MB/s, read %8.1lf MB/s, read with SBEs %8.1lf MB/s (%lu corrected)\n",
+           (mode == ECC_MODE_72_64) ? "(72,64)" : "(13,8)",
+           (mode == ECC_MODE_72_64) ? 12.5 : 100.0,
+           ((double)size*iterations/1.0e6)/writeSecs,
+           ((double)size*iterations/1.0e6)/readSecs,
+           ((double)size*iterations/1.0e6)/errorSecs,
+           ECC.corrected);
+
+    free(buffer);
+    ecc_free(&ECC);
+}
+
+
+int main(int argc, char *argv[])
+{
+    int megabytes=DEFAULT_MB, iterations=DEFAULT_ITERATIONS;
+
+    if(argc >= 2) sscanf(argv[1], "%d", &megabytes);
+    if(argc >= 3) sscanf(argv[2], "%d", &iterations);
+
+    printf("ECC throughput over %d MB, %d iterations\n", megabytes, iterations);
+
+    bench_mode(ECC_MODE_13_8, (size_t)megabytes*1024*1024, iterations);
+    bench_mode(ECC_MODE_72_64, (size_t)megabytes*1024*1024, iterations);
+
+    return NO_ERROR;
+}
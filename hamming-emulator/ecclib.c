@@ -1,7 +1,43 @@
+#include <string.h>
 #include "ecclib.h"
 
 static int printTrace=0;
 
+// Table driven codec
+//
+// The 13 bit SECDED code word for a byte depends only on the byte value, so
+// encode_byte() below - the bit by bit spreadsheet model - is run once per
+// value at startup to fill encodeTable[], and every write is then a single
+// lookup.  The syndrome (p04..p01) plus whether the overall parity pW agrees
+// index decodeTable[], which gives the read_byte() result directly, and
+// correctTable[] gives the data bit to flip back for a single bit error.
+//
+// For bulk work write_word()/read_word() handle 8 bytes at once in a 64 bit
+// word, bit-slicing the same parity equations: shifting the whole word right
+// by k brings bit k of every byte down to bit 0 of that byte, so each parity
+// bit for all 8 bytes takes a handful of shifts, XORs and one mask.  Only a
+// word with an error in it drops back to the per byte tables.
+//
+// (72,64) SECDED, as used for DRAM ECC
+//
+// One check byte per 64 bit data word, 12.5% overhead rather than the 100% of
+// the byte code.  The 64 data bits take Hamming positions 3...71 skipping the
+// powers of two, check bit j covers every position with bit j set, and bit 7
+// of the check byte is even parity over all 72 bits.  The check bits of a word
+// are the XOR of one checkTable72[] lookup per data byte, and syndromeTable72[]
+// maps a syndrome back to the data bit to correct.  A write of part of a word
+// is a read-modify-write, as in a real memory controller.
+//
+static unsigned char encodeTable[256];
+static unsigned char parityTable[256];
+static int decodeTable[32];
+static unsigned char correctTable[16];
+static unsigned char checkTable72[8][256];
+static signed char syndromeTable72[128];
+static int tablesBuilt=0;
+
+#define LSB64 (0x0101010101010101ULL)
+
 void traceOn(void)
 {
     printTrace=1;
@@ -12,10 +48,161 @@ void traceOff(void)
     printTrace=0;
 }
 
+
+// reference encoder, per the spreadsheet model
+static unsigned char encode_byte(unsigned char data)
+{
+
+    unsigned char codeword=0;
+
+    // p01 - per spreadsheet model, compute even parity=0 over 7,5,4,3,2,1 bits
+    codeword |= (P01_BIT & (
+                        ((data & DATA_BIT_1) ^ 
+                        ((data & DATA_BIT_2)>>1) ^ 
+                        ((data & DATA_BIT_4)>>3) ^ 
+                        ((data & DATA_BIT_5)>>4) ^ 
+                        ((data & DATA_BIT_7)>>6)) 
+                       ) );
+
+    // p02 - per spreadsheet modell, compute even parity=0 over 7,6,4,3,1 bits
+    codeword |= (P02_BIT & (
+                        (
+                         ((data & DATA_BIT_1) ^ 
+                         ((data & DATA_BIT_3)>>2) ^ 
+                         ((data & DATA_BIT_4)>>3) ^ 
+                         ((data & DATA_BIT_6)>>5) ^ 
+                         ((data & DATA_BIT_7)>>6))<<1) 
+                        ) );
+
+    // p03 - per spreadsheet model, compute even parity=0 over 8,4,3,2 bits
+    codeword |= (P03_BIT & (
+                        ((
+                          ((data & DATA_BIT_2)>>1) ^ 
+                          ((data & DATA_BIT_3)>>2) ^ 
+                          ((data & DATA_BIT_4)>>3) ^ 
+                          ((data & DATA_BIT_8)>>7))<<2) 
+                         ) );
+
+    // p04 - per spreadsheet model, compute even parity=0 over 8,7,6,5 bits
+    codeword |= (P04_BIT & (
+                        ((
+                          ((data & DATA_BIT_5)>>4) ^ 
+                          ((data & DATA_BIT_6)>>5) ^ 
+                          ((data & DATA_BIT_7)>>6) ^ 
+                          ((data & DATA_BIT_8)>>7))<<3) 
+                         ) );
+
+    // pW - per spreadsheet model compute even parity=0 over all bits
+    codeword |= (PW_BIT & (
+                      (((
+                          (data & DATA_BIT_1) ^ 
+                         ((data & DATA_BIT_2)>>1) ^ 
+                         ((data & DATA_BIT_3)>>2) ^ 
+                         ((data & DATA_BIT_4)>>3) ^ 
+                         ((data & DATA_BIT_5)>>4) ^ 
+                         ((data & DATA_BIT_6)>>5) ^ 
+                         ((data & DATA_BIT_7)>>6) ^ 
+                         ((data & DATA_BIT_8)>>7)) ^ 
+                         ((codeword & P01_BIT) ^ 
+                         ((codeword & P02_BIT)>>1) ^ 
+                         ((codeword & P03_BIT)>>2) ^ 
+                         ((codeword & P04_BIT)>>3)))<<4) 
+                        ) );
+
+    // set the encoded bit
+    codeword |= ENCODED_BIT;
+
+    return codeword;
+
+}
+
+
+void build_ecc_tables(void)
+{
+    int value, bit, syndrome;
+    unsigned char position[64];
+
+    if(tablesBuilt) return;
+
+    for(value=0; value < 256; value++)
+    {
+        encodeTable[value]=encode_byte((unsigned char)value);
+
+        parityTable[value]=0;
+        for(bit=0; bit < 8; bit++)
+            parityTable[value] ^= (value >> bit) & 1;
+    }
+
+    // index is SYNDROME | pW mismatch << 4
+    for(syndrome=0; syndrome < 16; syndrome++)
+    {
+        // 1) no syndrome, pW agrees - no error
+        // 2) no syndrome, pW wrong - the error is in pW itself
+        // 3) syndrome, pW agrees - even number of errors, so DBE
+        // 4) syndrome, pW wrong - SBE at encoded bit position SYNDROME,
+        //    unless the position is off the end of the 13 bit word, which
+        //    takes 3 or more errors
+        decodeTable[syndrome] = (syndrome == 0) ? NO_ERROR : DOUBLE_BIT_ERROR;
+        decodeTable[syndrome | 0x10] = (syndrome == 0) ? PW_ERROR :
+                                       ((syndrome <= 12) ? syndrome : UNKNOWN_ERROR);
+        correctTable[syndrome]=0;
+    }
+
+    // encoded word: pW p1 p2 d1 p3 d2 d3 d4 p4 d5 d6 d7 d8
+    correctTable[3]=DATA_BIT_1;
+    correctTable[5]=DATA_BIT_2;
+    correctTable[6]=DATA_BIT_3;
+    correctTable[7]=DATA_BIT_4;
+    correctTable[9]=DATA_BIT_5;
+    correctTable[10]=DATA_BIT_6;
+    correctTable[11]=DATA_BIT_7;
+    correctTable[12]=DATA_BIT_8;
+
+    // (72,64) - data bit to Hamming position, and syndrome back to data bit
+    for(syndrome=0; syndrome < 128; syndrome++)
+        syndromeTable72[syndrome] = ((syndrome & (syndrome-1)) == 0) ? ECC72_CHECK_BIT : ECC72_INVALID;
+
+    for(bit=0, syndrome=3; bit < 64; bit++, syndrome++)
+    {
+        while((syndrome & (syndrome-1)) == 0) syndrome++;
+        syndromeTable72[syndrome] = bit;
+        position[bit] = syndrome;
+    }
+
+    for(value=0; value < 256; value++)
+        for(bit=0; bit < 64; bit++)
+            if((value >> (bit & 7)) & 1)
+                checkTable72[bit >> 3][value] ^= position[bit];
+
+    tablesBuilt=1;
+}
+
+
+// Decode one stored byte with no tracing, returning the data with any single
+// data bit error corrected.  Memory is left as is.
+//
+static int decode_byte(unsigned char data, unsigned char code, unsigned char *byteRead)
+{
+    unsigned char SYNDROME, pW2;
+    int rc;
+
+    SYNDROME = (encodeTable[data] ^ code) & SYNBITS;
+    pW2 = parityTable[data] ^ parityTable[code & SYNBITS];
+    rc = decodeTable[SYNDROME | ((pW2 ^ (code >> 4)) & 1) << 4];
+
+    *byteRead = (rc > 0) ? (data ^ correctTable[SYNDROME]) : data;
+
+    return rc;
+}
+
+
 int write_byte(ecc_t *ecc, unsigned char *address, unsigned char byteToWrite) {
     unsigned int offset = address - ecc->data_memory;
     unsigned char codeword=0;
 
+    if(ecc->mode == ECC_MODE_72_64)
+        return ecc_write_block(ecc, address, &byteToWrite, 1);
+
     ecc->data_memory[offset]= byteToWrite;
     codeword = get_codeword(ecc, offset);
     ecc->code_memory[offset] = codeword;
@@ -34,6 +221,10 @@ int write_byte(ecc_t *ecc, unsigned char *address, unsigned char byteToWrite) {
 int read_byte(ecc_t *ecc, unsigned char *address, unsigned char *byteRead) {
     unsigned int offset = address - ecc->data_memory;
     unsigned char SYNDROME=0, pW2=0, pW=0, codeword=0;
+    int rc;
+
+    if(ecc->mode == ECC_MODE_72_64)
+        return ecc_read_block(ecc, address, byteRead, 1);
 
     codeword = get_codeword(ecc, offset);
 
@@ -41,22 +232,9 @@ int read_byte(ecc_t *ecc, unsigned char *address, unsigned char *byteRead) {
 
     pW = (ecc->code_memory[offset]) & PW_BIT;
     // BUG -- pW2 = (codeword) & PW_BIT; 
-    pW2 |= (PW_BIT & (
-                      (((
-                          (ecc->data_memory[offset] & DATA_BIT_1) ^ 
-                         ((ecc->data_memory[offset] & DATA_BIT_2)>>1) ^ 
-                         ((ecc->data_memory[offset] & DATA_BIT_3)>>2) ^ 
-                         ((ecc->data_memory[offset] & DATA_BIT_4)>>3) ^ 
-                         ((ecc->data_memory[offset] & DATA_BIT_5)>>4) ^ 
-                         ((ecc->data_memory[offset] & DATA_BIT_6)>>5) ^ 
-                         ((ecc->data_memory[offset] & DATA_BIT_7)>>6) ^ 
-                         ((ecc->data_memory[offset] & DATA_BIT_8)>>7)) ^ 
-                         ((ecc->code_memory[offset] & P01_BIT) ^ 
-                         ((ecc->code_memory[offset] & P02_BIT)>>1) ^ 
-                         ((ecc->code_memory[offset] & P03_BIT)>>2) ^ 
-                         ((ecc->code_memory[offset] & P04_BIT)>>3)))<<4) 
-                        ) );
-
+    // pW2 is recomputed over the stored data and stored p01...p04
+    pW2 = PW_BIT & ((parityTable[ecc->data_memory[offset]] ^
+                     parityTable[ecc->code_memory[offset] & SYNBITS]) << 4);
 
     if(printTrace) { printf("READ  : COMPUTED PARITY = ");print_code(codeword); }
     if(printTrace) { printf("READ  : PARITY          = ");print_code_word(ecc, address); }
@@ -66,114 +244,323 @@ int read_byte(ecc_t *ecc, unsigned char *address, unsigned char *byteRead) {
     if(printTrace) { printf("READ  : PW              = ");print_code(pW); }
     if(printTrace) { printf("READ  : PW2             = ");print_code(pW2); }
     if(printTrace) { printf("\n"); }
-    
-    // 1) if SYNDROME ==0 and pW == pW2, return NO_ERROR
-    if((SYNDROME == 0) && (pW == pW2))
-    {
-        return NO_ERROR;
-    }
 
-    // 2) if SYNDROME ==0 and pW != pW2, return PW_ERROR
-        if((SYNDROME == 0) && (pW != pW2))
+    rc = decode_byte(ecc->data_memory[offset], ecc->code_memory[offset], byteRead);
+
+    if(rc == PW_ERROR)
     {
         // restore pW to PW2
         printf("PW ERROR\n\n");
         ecc->code_memory[offset] |= pW2 & PW_BIT;
-        return PW_ERROR;
     }
-
-    // 3) if SYNDROME !=0 and pW == pW2, return DOUBLE_BIT_ERROR
-    if((SYNDROME != 0) && (pW == pW2))
+    else if(rc == DOUBLE_BIT_ERROR)
     {
         printf("DOUBLE BIT ERROR\n\n");
-        return DOUBLE_BIT_ERROR;
     }
-
-    // 4) if SYNDROME !=0 and pW != pW2, SBE, return SYNDROME
-    if((SYNDROME != 0) && (pW != pW2))
+    else if(rc > 0)
     {
         printf("SBE @ %d\n\n", SYNDROME);
-        return SYNDROME;
     }
 
-    // if we get here, something is seriously wrong like triple bit
-    // or worse error, so return UNKNOWN_ERROR    
-    return UNKNOWN_ERROR;
+    // UNKNOWN_ERROR is a triple bit or worse error
+    return rc;
 }
 
 
-unsigned char *enable_ecc_memory(ecc_t *ecc){
+// Bit-sliced encode of 8 data bytes, returning their 8 code bytes
+//
+static uint64_t encode_word(uint64_t data)
+{
+    uint64_t p01, p02, p03, p04, pW;
+
+    p01 = (data ^ (data>>1) ^ (data>>3) ^ (data>>4) ^ (data>>6)) & LSB64;
+    p02 = (data ^ (data>>2) ^ (data>>3) ^ (data>>5) ^ (data>>6)) & LSB64;
+    p03 = ((data>>1) ^ (data>>2) ^ (data>>3) ^ (data>>7)) & LSB64;
+    p04 = ((data>>4) ^ (data>>5) ^ (data>>6) ^ (data>>7)) & LSB64;
+
+    // parity of each byte, folded down into its bit 0
+    pW = data ^ (data>>4);
+    pW ^= pW>>2;
+    pW ^= pW>>1;
+    pW = (pW ^ p01 ^ p02 ^ p03 ^ p04) & LSB64;
+
+    return p01 | (p02<<1) | (p03<<2) | (p04<<3) | (pW<<4) | (LSB64 * ENCODED_BIT);
+}
+
+
+// 8 bytes at address, which need not be aligned
+//
+int write_word(ecc_t *ecc, unsigned char *address, uint64_t wordToWrite)
+{
+    unsigned int offset = address - ecc->data_memory;
+    uint64_t codeword = encode_word(wordToWrite);
+
+    if(ecc->mode == ECC_MODE_72_64)
+        return ecc_write_block(ecc, address, (unsigned char *)&wordToWrite, sizeof(uint64_t));
+
+    memcpy(&ecc->data_memory[offset], &wordToWrite, sizeof(uint64_t));
+    memcpy(&ecc->code_memory[offset], &codeword, sizeof(uint64_t));
+
+    return NO_ERROR;
+}
+
+
+// Returns NO_ERROR, or the read_byte() code of the first byte in error, with
+// single bit data errors corrected in wordRead.  Like read_byte() the stored
+// data is not rewritten.
+//
+int read_word(ecc_t *ecc, unsigned char *address, uint64_t *wordRead)
+{
+    unsigned int offset = address - ecc->data_memory;
+    uint64_t data, stored;
+    unsigned char bytes[8];
+    int idx, byteRc, rc=NO_ERROR;
+
+    if(ecc->mode == ECC_MODE_72_64)
+        return ecc_read_block(ecc, address, (unsigned char *)wordRead, sizeof(uint64_t));
+
+    memcpy(&data, &ecc->data_memory[offset], sizeof(uint64_t));
+    memcpy(&stored, &ecc->code_memory[offset], sizeof(uint64_t));
+
+    // syndrome and pW all agree - the common case
+    if(((encode_word(data) ^ stored) & (LSB64 * (SYNBITS | PW_BIT))) == 0)
+    {
+        *wordRead = data;
+        return NO_ERROR;
+    }
+
+    for(idx=0; idx < 8; idx++)
+    {
+        byteRc = decode_byte(ecc->data_memory[offset+idx], ecc->code_memory[offset+idx], &bytes[idx]);
+
+        if((byteRc != NO_ERROR) && (rc == NO_ERROR))
+            rc = byteRc;
+    }
+
+    memcpy(wordRead, bytes, sizeof(uint64_t));
+
+    return rc;
+}
+
+
+static unsigned char encode72(uint64_t data)
+{
+    unsigned char check=0;
     int idx;
-    for(idx=0; idx < MEM_SIZE; idx++) ecc->code_memory[idx]=0;
-    return ecc->data_memory;
+
+    for(idx=0; idx < 8; idx++)
+        check ^= checkTable72[idx][(data >> (8*idx)) & 0xFF];
+
+    return check | ((__builtin_parityll(data) ^ __builtin_parity(check)) << 7);
 }
 
-unsigned char get_codeword(ecc_t *ecc, unsigned int offset)
+
+// Check and correct one (72,64) word in place
+//
+static int decode72(uint64_t *data, unsigned char code)
 {
+    unsigned char syndrome = (encode72(*data) ^ code) & ECC72_CHECK_BITS;
+    int overall = __builtin_parityll(*data) ^ __builtin_parity(code);
 
-    unsigned char codeword=0;
+    if(syndrome == 0)
+        return overall ? PW_ERROR : NO_ERROR;
 
-    //printf("CODEWORD offset=%d\n", offset);
+    // even number of bits flipped
+    if(!overall)
+        return DOUBLE_BIT_ERROR;
 
-    // p01 - per spreadsheet model, compute even parity=0 over 7,5,4,3,2,1 bits
-    codeword |= (P01_BIT & (
-                        ((ecc->data_memory[offset] & DATA_BIT_1) ^ 
-                        ((ecc->data_memory[offset] & DATA_BIT_2)>>1) ^ 
-                        ((ecc->data_memory[offset] & DATA_BIT_4)>>3) ^ 
-                        ((ecc->data_memory[offset] & DATA_BIT_5)>>4) ^ 
-                        ((ecc->data_memory[offset] & DATA_BIT_7)>>6)) 
-                       ) );
+    if(syndromeTable72[syndrome] == ECC72_INVALID)
+        return UNKNOWN_ERROR;
 
-    // p02 - per spreadsheet modell, compute even parity=0 over 7,6,4,3,1 bits
-    codeword |= (P02_BIT & (
-                        (
-                         ((ecc->data_memory[offset] & DATA_BIT_1) ^ 
-                         ((ecc->data_memory[offset] & DATA_BIT_3)>>2) ^ 
-                         ((ecc->data_memory[offset] & DATA_BIT_4)>>3) ^ 
-                         ((ecc->data_memory[offset] & DATA_BIT_6)>>5) ^ 
-                         ((ecc->data_memory[offset] & DATA_BIT_7)>>6))<<1) 
-                        ) );
+    if(syndromeTable72[syndrome] >= 0)
+        *data ^= 1ULL << syndromeTable72[syndrome];
 
-    // p03 - per spreadsheet model, compute even parity=0 over 8,4,3,2 bits
-    codeword |= (P03_BIT & (
-                        ((
-                          ((ecc->data_memory[offset] & DATA_BIT_2)>>1) ^ 
-                          ((ecc->data_memory[offset] & DATA_BIT_3)>>2) ^ 
-                          ((ecc->data_memory[offset] & DATA_BIT_4)>>3) ^ 
-                          ((ecc->data_memory[offset] & DATA_BIT_8)>>7))<<2) 
-                         ) );
+    return SINGLE_BIT_ERROR_CORRECTED;
+}
 
-    // p04 - per spreadsheet model, compute even parity=0 over 8,7,6,5 bits
-    codeword |= (P04_BIT & (
-                        ((
-                          ((ecc->data_memory[offset] & DATA_BIT_5)>>4) ^ 
-                          ((ecc->data_memory[offset] & DATA_BIT_6)>>5) ^ 
-                          ((ecc->data_memory[offset] & DATA_BIT_7)>>6) ^ 
-                          ((ecc->data_memory[offset] & DATA_BIT_8)>>7))<<3) 
-                         ) );
 
-    // pW - per spreadsheet model compute even parity=0 over all bits
-    codeword |= (PW_BIT & (
-                      (((
-                          (ecc->data_memory[offset] & DATA_BIT_1) ^ 
-                         ((ecc->data_memory[offset] & DATA_BIT_2)>>1) ^ 
-                         ((ecc->data_memory[offset] & DATA_BIT_3)>>2) ^ 
-                         ((ecc->data_memory[offset] & DATA_BIT_4)>>3) ^ 
-                         ((ecc->data_memory[offset] & DATA_BIT_5)>>4) ^ 
-                         ((ecc->data_memory[offset] & DATA_BIT_6)>>5) ^ 
-                         ((ecc->data_memory[offset] & DATA_BIT_7)>>6) ^ 
-                         ((ecc->data_memory[offset] & DATA_BIT_8)>>7)) ^ 
-                         ((codeword & P01_BIT) ^ 
-                         ((codeword & P02_BIT)>>1) ^ 
-                         ((codeword & P03_BIT)>>2) ^ 
-                         ((codeword & P04_BIT)>>3)))<<4) 
-                        ) );
+// Count an error and fold it into the worst seen so far.  Any single bit
+// error, including one in a check bit, is SINGLE_BIT_ERROR_CORRECTED; the
+// codes are ordered so the more negative one is the worse.
+//
+static int tally_error(ecc_t *ecc, int worst, int rc)
+{
+    if(rc == NO_ERROR)
+        return worst;
 
-    // set the encoded bit
-    codeword |= ENCODED_BIT;
+    if((rc == DOUBLE_BIT_ERROR) || (rc == UNKNOWN_ERROR))
+    {
+        ecc->uncorrected++;
+    }
+    else
+    {
+        ecc->corrected++;
+        rc = SINGLE_BIT_ERROR_CORRECTED;
+    }
 
-    return codeword;
+    return (rc < worst) ? rc : worst;
+}
+
+
+// Write len bytes from buffer to ECC memory at address, in either mode.
+// Returns NO_ERROR, ECC_RANGE_ERROR, or for a partial (72,64) word the worst
+// error found reading the old word back.
+//
+int ecc_write_block(ecc_t *ecc, unsigned char *address, const unsigned char *buffer, size_t len)
+{
+    size_t offset = address - ecc->data_memory, idx, word, lo, hi;
+    uint64_t data, codeword;
+    int worst=NO_ERROR;
+
+    if((address < ecc->data_memory) || (offset+len > ecc->mem_size))
+        return ECC_RANGE_ERROR;
+
+    if(ecc->mode == ECC_MODE_13_8)
+    {
+        for(idx=0; idx+8 <= len; idx+=8)
+        {
+            memcpy(&data, &buffer[idx], sizeof(uint64_t));
+            codeword = encode_word(data);
+            memcpy(&ecc->data_memory[offset+idx], &data, sizeof(uint64_t));
+            memcpy(&ecc->code_memory[offset+idx], &codeword, sizeof(uint64_t));
+        }
+
+        for(; idx < len; idx++)
+        {
+            ecc->data_memory[offset+idx] = buffer[idx];
+            ecc->code_memory[offset+idx] = encodeTable[buffer[idx]];
+        }
+
+        return NO_ERROR;
+    }
+
+    for(word=offset/8; word*8 < offset+len; word++)
+    {
+        lo = (word*8 > offset) ? word*8 : offset;
+        hi = (word*8+8 < offset+len) ? word*8+8 : offset+len;
+
+        if(hi-lo < 8)
+        {
+            // partial word - merge into the corrected old data
+            memcpy(&data, &ecc->data_memory[word*8], sizeof(uint64_t));
+            worst = tally_error(ecc, worst, decode72(&data, ecc->code_memory[word]));
+            memcpy((unsigned char *)&data + (lo - word*8), &buffer[lo-offset], hi-lo);
+        }
+        else
+        {
+            memcpy(&data, &buffer[lo-offset], sizeof(uint64_t));
+        }
+
+        memcpy(&ecc->data_memory[word*8], &data, sizeof(uint64_t));
+        ecc->code_memory[word] = encode72(data);
+    }
+
+    return worst;
+}
+
+
+// Read len bytes at address into buffer, correcting single bit errors in the
+// buffer (memory itself is not rewritten).  Returns NO_ERROR,
+// SINGLE_BIT_ERROR_CORRECTED, DOUBLE_BIT_ERROR, UNKNOWN_ERROR for the worst
+// word or byte, or ECC_RANGE_ERROR.  The corrected and uncorrected counts in
+// ecc_t are updated.
+//
+int ecc_read_block(ecc_t *ecc, unsigned char *address, unsigned char *buffer, size_t len)
+{
+    size_t offset = address - ecc->data_memory, idx, word, lo, hi;
+    uint64_t data, stored;
+    int worst=NO_ERROR, byteIdx;
+
+    if((address < ecc->data_memory) || (offset+len > ecc->mem_size))
+        return ECC_RANGE_ERROR;
+
+    if(ecc->mode == ECC_MODE_13_8)
+    {
+        for(idx=0; idx+8 <= len; idx+=8)
+        {
+            memcpy(&data, &ecc->data_memory[offset+idx], sizeof(uint64_t));
+            memcpy(&stored, &ecc->code_memory[offset+idx], sizeof(uint64_t));
+
+            if(((encode_word(data) ^ stored) & (LSB64 * (SYNBITS | PW_BIT))) == 0)
+            {
+                memcpy(&buffer[idx], &data, sizeof(uint64_t));
+                continue;
+            }
+
+            for(byteIdx=0; byteIdx < 8; byteIdx++)
+                worst = tally_error(ecc, worst, decode_byte(ecc->data_memory[offset+idx+byteIdx],
+                                                            ecc->code_memory[offset+idx+byteIdx],
+                                                            &buffer[idx+byteIdx]));
+        }
+
+        for(; idx < len; idx++)
+            worst = tally_error(ecc, worst, decode_byte(ecc->data_memory[offset+idx],
+                                                        ecc->code_memory[offset+idx], &buffer[idx]));
+
+        return worst;
+    }
+
+    for(word=offset/8; word*8 < offset+len; word++)
+    {
+        lo = (word*8 > offset) ? word*8 : offset;
+        hi = (word*8+8 < offset+len) ? word*8+8 : offset+len;
+
+        memcpy(&data, &ecc->data_memory[word*8], sizeof(uint64_t));
+        if(encode72(data) != ecc->code_memory[word])
+            worst = tally_error(ecc, worst, decode72(&data, ecc->code_memory[word]));
 
+        memcpy(&buffer[lo-offset], (unsigned char *)&data + (lo - word*8), hi-lo);
+    }
+
+    return worst;
+}
+
+
+// Allocate size bytes of zeroed ECC memory in ECC_MODE_13_8, one code byte
+// per data byte, or ECC_MODE_72_64, one check byte per 8 data bytes.  Size is
+// rounded up to a whole number of 64 bit words.  Returns the base of the data
+// memory or NULL.
+//
+unsigned char *ecc_init(ecc_t *ecc, size_t size, int mode)
+{
+    build_ecc_tables();
+
+    size = (size + 7) & ~(size_t)7;
+
+    ecc->mode = mode;
+    ecc->mem_size = size;
+    ecc->corrected = 0;
+    ecc->uncorrected = 0;
+    ecc->data_memory = calloc(size, 1);
+    ecc->code_memory = calloc((mode == ECC_MODE_72_64) ? size/8 : size, 1);
+
+    if((ecc->data_memory == NULL) || (ecc->code_memory == NULL))
+    {
+        ecc_free(ecc);
+        return NULL;
+    }
+
+    return ecc->data_memory;
+}
+
+
+void ecc_free(ecc_t *ecc)
+{
+    free(ecc->data_memory);
+    free(ecc->code_memory);
+    ecc->data_memory = NULL;
+    ecc->code_memory = NULL;
+    ecc->mem_size = 0;
+}
+
+
+unsigned char *enable_ecc_memory(ecc_t *ecc){
+    return ecc_init(ecc, MEM_SIZE, ECC_MODE_13_8);
+}
+
+unsigned char get_codeword(ecc_t *ecc, unsigned int offset)
+{
+    return encodeTable[ecc->data_memory[offset]];
 }
 
 
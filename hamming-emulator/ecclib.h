@@ -1,6 +1,8 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 
+// default size for enable_ecc_memory(), ecc_init() takes any size
 //#define MEM_SIZE (1024*1024)
 #define MEM_SIZE (1024)
 #define NO_ERROR (0)
@@ -8,6 +10,11 @@
 #define SINGLE_BIT_ERROR_CORRECTED (-2)
 #define DOUBLE_BIT_ERROR (-3)
 #define UNKNOWN_ERROR (-4)
+#define ECC_RANGE_ERROR (-5)
+
+// ECC modes for ecc_init()
+#define ECC_MODE_13_8 (0)
+#define ECC_MODE_72_64 (1)
 
 #define P01_BIT      (0x01)
 #define P02_BIT      (0x02)
@@ -29,10 +36,19 @@
 
 #define SYNBITS    (0x0F)
 
+// (72,64) check byte - 7 Hamming check bits and overall parity in bit 7
+#define ECC72_CHECK_BITS (0x7F)
+#define ECC72_CHECK_BIT  (-1)
+#define ECC72_INVALID    (-2)
+
 typedef struct emulated_ecc
 {
-    unsigned char data_memory[MEM_SIZE];
-    unsigned char code_memory[MEM_SIZE];
+    unsigned char *data_memory;
+    unsigned char *code_memory;
+    size_t mem_size;
+    int mode;
+    unsigned long corrected;
+    unsigned long uncorrected;
 } ecc_t;
 
 void print_code(unsigned char codeword);
@@ -46,7 +62,21 @@ int read_byte(ecc_t *ecc, unsigned char *address, unsigned char *byteRead);
 
 int write_byte(ecc_t *ecc, unsigned char *address, unsigned char byteToWrite);
 
+// 8 bytes at a time, bit-sliced in a 64 bit word
+int read_word(ecc_t *ecc, unsigned char *address, uint64_t *wordRead);
+
+int write_word(ecc_t *ecc, unsigned char *address, uint64_t wordToWrite);
+
+void build_ecc_tables(void);
+
 unsigned char *enable_ecc_memory(ecc_t *ecc);
 
+// dynamically sized memory in either mode, and whole buffer read/write
+unsigned char *ecc_init(ecc_t *ecc, size_t size, int mode);
+void ecc_free(ecc_t *ecc);
+
+int ecc_write_block(ecc_t *ecc, unsigned char *address, const unsigned char *buffer, size_t len);
+int ecc_read_block(ecc_t *ecc, unsigned char *address, unsigned char *buffer, size_t len);
+
 void traceOn(void);
 void traceOff(void);
@@ -1,4 +1,5 @@
 #include <assert.h>
+#include <string.h>
 #include "ecclib.h"
 
 void flip_bit(ecc_t *ecc, unsigned char *address, unsigned short bit_to_flip);
@@ -9,6 +10,9 @@ int main(void)
     int i, j;
     unsigned int offset=0; int rc; unsigned char byteToRead;
     unsigned short bitToFlip, bitToFlip2;
+    uint64_t wordToWrite, wordRead;
+    ecc_t ECC72;
+    unsigned char block[256], readBack[256];
     unsigned char *base_addr=enable_ecc_memory(&ECC);
 
     // NEGATIVE testing - flip a SINGLE bit, read to correct
@@ -102,6 +106,80 @@ int main(void)
     printf("**** END TEST CASE 5 *****************************\n\n");
 
 
+    // TEST CASE 6: 64 bit word path agrees with the byte tables
+    printf("**** TEST CASE 6: Word read after write **********\n");
+    for(offset=0; offset+8 <= MEM_SIZE; offset+=8)
+    {
+        wordToWrite = (0x0123456789ABCDEFULL * (offset+1)) ^ ((uint64_t)offset << 32);
+        write_word(&ECC, base_addr+offset, wordToWrite);
+
+        for(i=0; i<8; i++)
+            assert(ECC.code_memory[offset+i] == get_codeword(&ECC, offset+i));
+
+        assert((rc=read_word(&ECC, base_addr+offset, &wordRead)) == NO_ERROR);
+        assert(wordRead == wordToWrite);
+
+        // one data bit in each byte in turn, corrected on read
+        for(i=0; i<8; i++)
+        {
+            ECC.data_memory[offset+i] ^= DATA_BIT_1 << (i % 8);
+            assert((rc=read_word(&ECC, base_addr+offset, &wordRead)) > 0);
+            assert(wordRead == wordToWrite);
+            ECC.data_memory[offset+i] ^= DATA_BIT_1 << (i % 8);
+        }
+
+        // two data bits in one byte can only be detected
+        ECC.data_memory[offset+3] ^= (DATA_BIT_2 | DATA_BIT_7);
+        assert((rc=read_word(&ECC, base_addr+offset, &wordRead)) == DOUBLE_BIT_ERROR);
+        ECC.data_memory[offset+3] ^= (DATA_BIT_2 | DATA_BIT_7);
+    }
+    printf("**** END TEST CASE 6 *****************************\n\n");
+
+
+    // TEST CASE 7: (72,64) mode, every single bit and some double bit errors
+    printf("**** TEST CASE 7: (72,64) block read/write *******\n");
+    base_addr=ecc_init(&ECC72, 4096, ECC_MODE_72_64);
+    assert(base_addr != NULL);
+
+    for(offset=0; offset < sizeof(block); offset++)
+        block[offset]=(unsigned char)(offset*7+3);
+
+    assert(ecc_write_block(&ECC72, base_addr, block, sizeof(block)) == NO_ERROR);
+    assert(ecc_read_block(&ECC72, base_addr, readBack, sizeof(block)) == NO_ERROR);
+    assert(memcmp(block, readBack, sizeof(block)) == 0);
+
+    // 64 data bits then 8 check bits of word 1
+    for(i=0; i<72; i++)
+    {
+        if(i < 64) base_addr[8 + i/8] ^= 1 << (i%8); else ECC72.code_memory[1] ^= 1 << (i-64);
+        assert(ecc_read_block(&ECC72, base_addr, readBack, sizeof(block)) == SINGLE_BIT_ERROR_CORRECTED);
+        assert(memcmp(block, readBack, sizeof(block)) == 0);
+        if(i < 64) base_addr[8 + i/8] ^= 1 << (i%8); else ECC72.code_memory[1] ^= 1 << (i-64);
+    }
+    assert(ECC72.corrected == 72);
+
+    for(i=0; i<64; i++)
+    {
+        base_addr[16 + i/8] ^= 1 << (i%8);
+        base_addr[16 + ((i+9)%64)/8] ^= 1 << ((i+9)%8);
+        assert(ecc_read_block(&ECC72, base_addr+16, readBack, 8) == DOUBLE_BIT_ERROR);
+        base_addr[16 + i/8] ^= 1 << (i%8);
+        base_addr[16 + ((i+9)%64)/8] ^= 1 << ((i+9)%8);
+    }
+
+    // unaligned partial words are read-modify-write
+    assert(ecc_write_block(&ECC72, base_addr+13, (unsigned char *)"partial", 7) == NO_ERROR);
+    memcpy(&block[13], "partial", 7);
+    assert(ecc_read_block(&ECC72, base_addr, readBack, sizeof(block)) == NO_ERROR);
+    assert(memcmp(block, readBack, sizeof(block)) == 0);
+    assert(ecc_write_block(&ECC72, base_addr+4090, block, 7) == ECC_RANGE_ERROR);
+
+    ecc_free(&ECC72);
+    printf("**** END TEST CASE 7 *****************************\n\n");
+
+
+    ecc_free(&ECC);
+
     return NO_ERROR;
 }
 
@@ -35,6 +35,10 @@
 
 #include <time.h>
 
+#include "yuvconvert.h"
+#include "framequeue.h"
+#include "framewriter.h"
+
 #define CLEAR(x) memset(&(x), 0, sizeof(x))
 
 #define MAX_HRES (1920)
@@ -68,7 +72,24 @@
 //#define COLOR_CONVERT_GRAY
 #define DUMP_FRAMES
 
-#define DRIVER_MMAP_BUFFERS (6)  // request buffers for delay
+// frames queued for the writer thread before the storage service drops them
+#define WRITER_BUFFERS (8)
+
+// every stored frame goes to one archive, see framearchive.h and frameexport,
+// comment out for a frames/test%04d.ppm (or .pgm) file per frame instead
+#define ARCHIVE_FRAMES
+
+#ifdef ARCHIVE_FRAMES
+#define FRAME_ARCHIVE "frames/capture.fa"
+#else
+#define FRAME_ARCHIVE NULL
+#endif
+
+#define DRIVER_MMAP_BUFFERS (8)  // request buffers for delay
+
+// frames held in the ring stay dequeued from the driver, so leave it at least
+// this many to keep streaming into
+#define DRIVER_MIN_QUEUED (2)
 
 
 // Format is used by a number of functions, so made as a file global
@@ -82,25 +103,28 @@ struct buffer
 };
 
 
-struct save_frame_t
-{
-    unsigned char   frame[HRES*VRES*PIXEL_SIZE];
-    struct timespec time_stamp;
-    char identifier_str[80];
-};
-
-struct ring_buffer_t
-{
-    unsigned int ring_size;
+// Frames pass between the acquisition, processing and storage services only
+// through lock-free queues of frame_desc_t, so each can run on its own core:
+//
+// capture_queue - V4L2 buffer indices, read to process.  A dequeued buffer is
+//                 owned by the queue until it is given back with VIDIOC_QBUF.
+//                 One producer, and the reader also pops the oldest frame
+//                 when the queue is full, so two consumers.
+// store_queue   - processed frame slots, process to store
+// free_queue    - the same slots back from store to process
+//
+static frame_queue_t capture_queue;
+static frame_queue_t store_queue;
+static frame_queue_t free_queue;
 
-    int tail_idx;
-    int head_idx;
-    int count;
+#define PROCESSED_FRAMES (4)
 
-    struct save_frame_t save_frame[3*FRAMES_PER_SEC];
-};
+static unsigned char processed_frame[PROCESSED_FRAMES][HRES*VRES*MAX_PIXEL_SIZE];
 
-static  struct ring_buffer_t	ring_buffer;
+// frames released unprocessed because capture_queue was full when the next one
+// was read, because a newer frame was queued when processing, and processed
+// frames dropped with every slot waiting to be stored
+static unsigned long long capture_dropped=0, capture_skipped=0, store_dropped=0;
 
 static int              camera_device_fd = -1;
 struct buffer          *buffers;
@@ -132,78 +156,6 @@ static int xioctl(int fh, int request, void *arg)
 }
 
 
-char ppm_header[]="P6\n#9999999999 sec 9999999999 msec \n"HRES_STR" "VRES_STR"\n255\n";
-char ppm_dumpname[]="frames/test0000.ppm";
-
-static void dump_ppm(const void *p, int size, unsigned int tag, struct timespec *time)
-{
-    int written, i, total, dumpfd;
-   
-    snprintf(&ppm_dumpname[11], 9, "%04d", tag);
-    strncat(&ppm_dumpname[15], ".ppm", 5);
-    dumpfd = open(ppm_dumpname, O_WRONLY | O_NONBLOCK | O_CREAT, 00666);
-
-    snprintf(&ppm_header[4], 11, "%010d", (int)time->tv_sec);
-    strncat(&ppm_header[14], " sec ", 5);
-    snprintf(&ppm_header[19], 11, "%010d", (int)((time->tv_nsec)/1000000));
-    strncat(&ppm_header[29], " msec \n"HRES_STR" "VRES_STR"\n255\n", 19);
-
-    // subtract 1 from sizeof header because it includes the null terminator for the string
-    written=write(dumpfd, ppm_header, sizeof(ppm_header)-1);
-
-    total=0;
-
-    do
-    {
-        written=write(dumpfd, p, size);
-        total+=written;
-    } while(total < size);
-
-    clock_gettime(CLOCK_MONOTONIC, &time_now);
-    fnow = (double)time_now.tv_sec + (double)time_now.tv_nsec / 1000000000.0;
-    printf("Frame written to flash at %lf, %d, bytes\n", (fnow-fstart), total);
-
-    close(dumpfd);
-    
-}
-
-
-char pgm_header[]="P5\n#9999999999 sec 9999999999 msec \n"HRES_STR" "VRES_STR"\n255\n";
-char pgm_dumpname[]="frames/test0000.pgm";
-
-static void dump_pgm(const void *p, int size, unsigned int tag, struct timespec *time)
-{
-    int written, i, total, dumpfd;
-   
-    snprintf(&pgm_dumpname[11], 9, "%04d", tag);
-    strncat(&pgm_dumpname[15], ".pgm", 5);
-    dumpfd = open(pgm_dumpname, O_WRONLY | O_NONBLOCK | O_CREAT, 00666);
-
-    snprintf(&pgm_header[4], 11, "%010d", (int)time->tv_sec);
-    strncat(&pgm_header[14], " sec ", 5);
-    snprintf(&pgm_header[19], 11, "%010d", (int)((time->tv_nsec)/1000000));
-    strncat(&pgm_header[29], " msec \n"HRES_STR" "VRES_STR"\n255\n", 19);
-
-    // subtract 1 from sizeof header because it includes the null terminator for the string
-    written=write(dumpfd, pgm_header, sizeof(pgm_header)-1);
-
-    total=0;
-
-    do
-    {
-        written=write(dumpfd, p, size);
-        total+=written;
-    } while(total < size);
-
-    clock_gettime(CLOCK_MONOTONIC, &time_now);
-    fnow = (double)time_now.tv_sec + (double)time_now.tv_nsec / 1000000000.0;
-    printf("Frame written to flash at %lf, %d, bytes\n", (fnow-fstart), total);
-
-    close(dumpfd);
-    
-}
-
-
 void yuv2rgb_float(float y, float u, float v, 
                    unsigned char *r, unsigned char *g, unsigned char *b)
 {
@@ -278,15 +230,14 @@ static int save_image(const void *p, int size, struct timespec *frame_time)
     int i, newi, newsize=0;
     unsigned char *frame_ptr = (unsigned char *)p;
 
+    // no printf per frame here, the writer counts and times every frame
     save_framecnt++;
-    printf("save frame %d: ", save_framecnt);
-    
+
 #ifdef DUMP_FRAMES	
 
     if(fmt.fmt.pix.pixelformat == V4L2_PIX_FMT_GREY)
     {
-        printf("Dump graymap as-is size %d\n", size);
-        dump_pgm(frame_ptr, size, save_framecnt, frame_time);
+        fw_write_frame(FW_PGM, frame_ptr, size, save_framecnt, frame_time);
     }
 
     else if(fmt.fmt.pix.pixelformat == V4L2_PIX_FMT_YUYV)
@@ -296,14 +247,12 @@ static int save_image(const void *p, int size, struct timespec *frame_time)
        
         if(save_framecnt > 0) 
         {
-            dump_ppm(frame_ptr, ((size*6)/4), save_framecnt, frame_time);
-            printf("Dump YUYV converted to RGB size %d\n", size);
+            fw_write_frame(FW_PPM, frame_ptr, ((size*6)/4), save_framecnt, frame_time);
         }
 #elif defined(COLOR_CONVERT_GRAY)
         if(save_framecnt > 0)
         {
-            dump_pgm(frame_ptr, (size/2), process_framecnt, frame_time);
-            printf("Dump YUYV converted to YY size %d\n", size);
+            fw_write_frame(FW_PGM, frame_ptr, (size/2), process_framecnt, frame_time);
         }
 #endif
 
@@ -311,8 +260,7 @@ static int save_image(const void *p, int size, struct timespec *frame_time)
 
     else if(fmt.fmt.pix.pixelformat == V4L2_PIX_FMT_RGB24)
     {
-        printf("Dump RGB as-is size %d\n", size);
-        dump_ppm(frame_ptr, size, process_framecnt, frame_time);
+        fw_write_frame(FW_PPM, frame_ptr, size, process_framecnt, frame_time);
     }
     else
     {
@@ -324,10 +272,8 @@ static int save_image(const void *p, int size, struct timespec *frame_time)
 }
 
 
-static int process_image(const void *p, int size)
+static int process_image(const void *p, int size, unsigned char *out)
 {
-    int i, newi, newsize=0;
-    int y_temp, y2_temp, u_temp, v_temp;
     unsigned char *frame_ptr = (unsigned char *)p;
 
     process_framecnt++;
@@ -345,22 +291,13 @@ static int process_image(const void *p, int size)
         // Pixels are YU and YV alternating, so YUYV which is 4 bytes
         // We want RGB, so RGBRGB which is 6 bytes
         //
-        for(i=0, newi=0; i<size; i=i+4, newi=newi+6)
-        {
-            y_temp=(int)frame_ptr[i]; u_temp=(int)frame_ptr[i+1]; y2_temp=(int)frame_ptr[i+2]; v_temp=(int)frame_ptr[i+3];
-            yuv2rgb(y_temp, u_temp, v_temp, &scratchpad_buffer[newi], &scratchpad_buffer[newi+1], &scratchpad_buffer[newi+2]);
-            yuv2rgb(y2_temp, u_temp, v_temp, &scratchpad_buffer[newi+3], &scratchpad_buffer[newi+4], &scratchpad_buffer[newi+5]);
-        }
+        // yuvconvert.c does the yuv2rgb() conversion a vector of pixels at a time
+        yuyv_to_rgb24(frame_ptr, out, size/2);
 #elif defined(COLOR_CONVERT_GRAY)
         // Pixels are YU and YV alternating, so YUYV which is 4 bytes
         // We want Y, so YY which is 2 bytes
         //
-        for(i=0, newi=0; i<size; i=i+4, newi=newi+2)
-        {
-            // Y1=first byte and Y2=third byte
-            scratchpad_buffer[newi]=frame_ptr[i];
-            scratchpad_buffer[newi+1]=frame_ptr[i+2];
-        }
+        yuyv_to_gray(frame_ptr, out, size/2);
 #endif
     }
 
@@ -420,10 +357,28 @@ static int read_frame(void)
 }
 
 
+// Give a buffer back to the driver to capture into
+//
+static void release_frame(unsigned int index)
+{
+    struct v4l2_buffer buf;
+
+    CLEAR(buf);
+    buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    buf.memory = V4L2_MEMORY_MMAP;
+    buf.index = index;
+
+    if (-1 == xioctl(camera_device_fd, VIDIOC_QBUF, &buf))
+        errno_exit("VIDIOC_QBUF");
+}
+
+
 int seq_frame_read(void)
 {
     fd_set fds;
     struct timeval tv;
+    frame_desc_t desc, oldest;
+    double fread_now;
     int rc;
 
     FD_ZERO(&fds);
@@ -435,62 +390,88 @@ int seq_frame_read(void)
 
     rc = select(camera_device_fd + 1, &fds, NULL, NULL, &tv);
 
-    read_frame();
-
-    // save off copy of image with time-stamp here
-    //printf("memcpy to %p from %p for %d bytes\n", (void *)&(ring_buffer.save_frame[ring_buffer.tail_idx].frame[0]), buffers[frame_buf.index].start, frame_buf.bytesused);
-    //syslog(LOG_CRIT, "memcpy to %p from %p for %d bytes\n", (void *)&(ring_buffer.save_frame[ring_buffer.tail_idx].frame[0]), buffers[frame_buf.index].start, frame_buf.bytesused);
-    memcpy((void *)&(ring_buffer.save_frame[ring_buffer.tail_idx].frame[0]), buffers[frame_buf.index].start, frame_buf.bytesused);
+    if(!read_frame())
+        return 0;
 
-    ring_buffer.tail_idx = (ring_buffer.tail_idx + 1) % ring_buffer.ring_size;
-    ring_buffer.count++;
+    // keep the buffer itself, no copy, until processing releases it
+    desc.index = frame_buf.index;
+    desc.bytesused = frame_buf.bytesused;
+    desc.sequence = read_framecnt;
+    clock_gettime(CLOCK_MONOTONIC, &desc.time_stamp);
+    fread_now = (double)desc.time_stamp.tv_sec + (double)desc.time_stamp.tv_nsec / 1000000000.0;
 
-    clock_gettime(CLOCK_MONOTONIC, &time_now);
-    fnow = (double)time_now.tv_sec + (double)time_now.tv_nsec / 1000000000.0;
+    // backpressure - with the queue full, the oldest frame goes back to the
+    // driver so it always has buffers to capture into, and the newest is kept
+    while(!fq_push_spsc(&capture_queue, &desc))
+    {
+        if(fq_pop(&capture_queue, &oldest))
+        {
+            release_frame(oldest.index);
+            capture_dropped++;
+        }
+    }
 
     if(read_framecnt > 0)
     {	
-        //printf("read_framecnt=%d, rb.tail=%d, rb.head=%d, rb.count=%d at %lf and %lf FPS", read_framecnt, ring_buffer.tail_idx, ring_buffer.head_idx, ring_buffer.count, (fnow-fstart), (double)(read_framecnt) / (fnow-fstart));
-
-        //syslog(LOG_CRIT, "read_framecnt=%d, rb.tail=%d, rb.head=%d, rb.count=%d at %lf and %lf FPS", read_framecnt, ring_buffer.tail_idx, ring_buffer.head_idx, ring_buffer.count, (fnow-fstart), (double)(read_framecnt) / (fnow-fstart));
-        syslog(LOG_CRIT, "read_framecnt=%d at %lf and %lf FPS", read_framecnt, (fnow-fstart), (double)(read_framecnt) / (fnow-fstart));
+        syslog(LOG_CRIT, "read_framecnt=%d, queued %u at %lf and %lf FPS", read_framecnt, fq_depth(&capture_queue), (fread_now-fstart), (double)(read_framecnt) / (fread_now-fstart));
     }
     else 
     {
-        printf("at %lf\n", fnow);
+        printf("at %lf\n", fread_now);
     }
 
-    if (-1 == xioctl(camera_device_fd, VIDIOC_QBUF, &frame_buf))
-        errno_exit("VIDIOC_QBUF");
+    return 1;
 }
 
 
 
 int seq_frame_process(void)
 {
+    frame_desc_t desc, newer, slot;
+    struct timespec process_now;
+    double fprocess_now;
     int cnt;
 
-    printf("processing rb.tail=%d, rb.head=%d, rb.count=%d\n", ring_buffer.tail_idx, ring_buffer.head_idx, ring_buffer.count);
+    printf("processing %u queued frames, %u to store\n", fq_depth(&capture_queue), fq_depth(&store_queue));
 
-    ring_buffer.head_idx = (ring_buffer.head_idx + 2) % ring_buffer.ring_size;
+    if(!fq_pop(&capture_queue, &desc))
+    {
+        printf("no frame to process\n");
+        return process_framecnt;
+    }
 
-    cnt=process_image((void *)&(ring_buffer.save_frame[ring_buffer.head_idx].frame[0]), HRES*VRES*PIXEL_SIZE);
+    // only the newest frame is processed, the older ones go back to the driver
+    while(fq_pop(&capture_queue, &newer))
+    {
+        release_frame(desc.index);
+        capture_skipped++;
+        desc = newer;
+    }
 
-    ring_buffer.head_idx = (ring_buffer.head_idx + 3) % ring_buffer.ring_size;
-    ring_buffer.count = ring_buffer.count - 5;
+    if(!fq_pop_spsc(&free_queue, &slot))
+    {
+        printf("no free slot, frame %u dropped\n", desc.sequence);
+        release_frame(desc.index);
+        store_dropped++;
+        return process_framecnt;
+    }
+
+    // straight from the driver's buffer to the processed frame slot
+    cnt=process_image(buffers[desc.index].start, HRES*VRES*PIXEL_SIZE, processed_frame[slot.index]);
+    release_frame(desc.index);
+
+    slot.bytesused = desc.bytesused;
+    slot.sequence = desc.sequence;
+    slot.time_stamp = desc.time_stamp;
+
+    // there are only as many slots as store_queue holds
+    fq_push_spsc(&store_queue, &slot);
 
-     	
-    printf("rb.tail=%d, rb.head=%d, rb.count=%d ", ring_buffer.tail_idx, ring_buffer.head_idx, ring_buffer.count);
-       
     if(process_framecnt > 0)
     {	
-        clock_gettime(CLOCK_MONOTONIC, &time_now);
-        fnow = (double)time_now.tv_sec + (double)time_now.tv_nsec / 1000000000.0;
-                printf(" processed at %lf, @ %lf FPS\n", (fnow-fstart), (double)(process_framecnt+1) / (fnow-fstart));
-    }
-    else 
-    {
-        printf("at %lf\n", fnow-fstart);
+        clock_gettime(CLOCK_MONOTONIC, &process_now);
+        fprocess_now = (double)process_now.tv_sec + (double)process_now.tv_nsec / 1000000000.0;
+                printf(" processed at %lf, @ %lf FPS\n", (fprocess_now-fstart), (double)(process_framecnt+1) / (fprocess_now-fstart));
     }
 
     return cnt;
@@ -499,21 +480,27 @@ int seq_frame_process(void)
 
 int seq_frame_store(void)
 {
+    frame_desc_t slot;
+    struct timespec store_now;
+    double fstore_now;
     int cnt;
 
-    cnt=save_image(scratchpad_buffer, HRES*VRES*PIXEL_SIZE, &time_now);
+    if(!fq_pop_spsc(&store_queue, &slot))
+    {
+        printf("no frame to store\n");
+        return save_framecnt;
+    }
+
+    cnt=save_image(processed_frame[slot.index], HRES*VRES*PIXEL_SIZE, &slot.time_stamp);
     printf("save_framecnt=%d ", save_framecnt);
 
+    fq_push_spsc(&free_queue, &slot);
 
     if(save_framecnt > 0)
     {	
-        clock_gettime(CLOCK_MONOTONIC, &time_now);
-        fnow = (double)time_now.tv_sec + (double)time_now.tv_nsec / 1000000000.0;
-                printf(" saved at %lf, @ %lf FPS\n", (fnow-fstart), (double)(process_framecnt+1) / (fnow-fstart));
-    }
-    else 
-    {
-        printf("at %lf\n", fnow-fstart);
+        clock_gettime(CLOCK_MONOTONIC, &store_now);
+        fstore_now = (double)store_now.tv_sec + (double)store_now.tv_nsec / 1000000000.0;
+                printf(" saved at %lf, @ %lf FPS\n", (fstore_now-fstart), (double)(save_framecnt+1) / (fstore_now-fstart));
     }
 
     return cnt;
@@ -601,26 +588,12 @@ static void mainloop(void)
 	            {	
                         printf(" read at %lf, @ %lf FPS\n", (fnow-fstart), (double)(read_framecnt+1) / (fnow-fstart));
 
-                        memcpy((void *)&(ring_buffer.save_frame[ring_buffer.tail_idx].frame[0]), buffers[frame_buf.index].start, frame_buf.bytesused);
-			printf("memcpy to rb.tail=%d, rb.head=%d, ptr=%p\n", ring_buffer.tail_idx, ring_buffer.head_idx, (void *)&(ring_buffer.save_frame[ring_buffer.tail_idx].frame[0]));
-
-                        // advance ring buffer for next read
-                        ring_buffer.tail_idx = (ring_buffer.tail_idx + 1) % ring_buffer.ring_size;
-                        ring_buffer.count++;
-
-
-                        process_image((void *)&(ring_buffer.save_frame[ring_buffer.head_idx].frame[0]), HRES*VRES*PIXEL_SIZE);
-                        //process_image(buffers[frame_buf.index].start, frame_buf.bytesused);
+                        // process straight from the dequeued buffer, which is
+                        // only given back to the driver after it is saved
+                        process_image(buffers[frame_buf.index].start, HRES*VRES*PIXEL_SIZE, scratchpad_buffer);
 			printf("bytesused=%d, hxvxp=%d\n", frame_buf.bytesused, HRES*VRES*PIXEL_SIZE);
-                        process_image((void *)&(ring_buffer.save_frame[ring_buffer.head_idx].frame[0]), HRES*VRES*PIXEL_SIZE);
 
-			printf("process from rb.tail=%d, rb.head=%d, ptr=%p\n", ring_buffer.tail_idx, ring_buffer.head_idx, (void *)&(ring_buffer.save_frame[ring_buffer.head_idx].frame[0]));
                         save_image(scratchpad_buffer, HRES*VRES*PIXEL_SIZE, &time_now);
-
-                        // advance ring buffer for next write
-                        ring_buffer.head_idx = (ring_buffer.head_idx + 1) % ring_buffer.ring_size;
-                        ring_buffer.count--;
-
 		    }
 		    else 
 		    {
@@ -700,6 +673,35 @@ static void uninit_device(void)
 }
 
 
+// capture_queue holds all but DRIVER_MIN_QUEUED of the buffers the driver
+// granted, though never less than the 2 a frame_queue_t needs, and every
+// processed frame slot starts out free
+//
+static void init_queues(unsigned int capture_frames)
+{
+    frame_desc_t slot;
+    unsigned int i;
+
+    if((fq_init(&capture_queue, capture_frames) < 0) ||
+       (fq_init(&store_queue, PROCESSED_FRAMES) < 0) ||
+       (fq_init(&free_queue, PROCESSED_FRAMES) < 0))
+    {
+        fprintf(stderr, "Out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    memset(&slot, 0, sizeof(slot));
+
+    for(i=0; i < PROCESSED_FRAMES; i++)
+    {
+        slot.index=i;
+        fq_push_spsc(&free_queue, &slot);
+    }
+
+    printf("capture queue holds %u of %u buffers\n", capture_frames, n_buffers);
+}
+
+
 static void init_mmap(char *dev_name)
 {
         struct v4l2_requestbuffers req;
@@ -712,10 +714,6 @@ static void init_mmap(char *dev_name)
 
 	printf("init_mmap req.count=%d\n",req.count);
 
-	ring_buffer.tail_idx=0;
-	ring_buffer.head_idx=0;
-	ring_buffer.count=0;
-	ring_buffer.ring_size=3*FRAMES_PER_SEC;
 
         if (-1 == xioctl(camera_device_fd, VIDIOC_REQBUFS, &req)) 
         {
@@ -777,6 +775,8 @@ static void init_mmap(char *dev_name)
 
                 printf("mappped buffer %d\n", n_buffers);
         }
+
+        init_queues((n_buffers > DRIVER_MIN_QUEUED + 2) ? n_buffers - DRIVER_MIN_QUEUED : 2);
 }
 
 
@@ -786,6 +786,7 @@ static void init_device(char *dev_name)
     struct v4l2_cropcap cropcap;
     struct v4l2_crop crop;
     unsigned int min;
+    int impl;
 
     if (-1 == xioctl(camera_device_fd, VIDIOC_QUERYCAP, &cap))
     {
@@ -885,6 +886,15 @@ static void init_device(char *dev_name)
                     errno_exit("VIDIOC_G_FMT");
     }
 
+    // fastest YUYV converter for this CPU unless YUV_CONVERT names one,
+    // e.g. YUV_CONVERT=scalar for the reference
+    if((impl=yuv_convert_select_name(getenv("YUV_CONVERT"))) < 0)
+    {
+        fprintf(stderr, "YUV_CONVERT=%s not supported, using auto\n", getenv("YUV_CONVERT"));
+        impl=yuv_convert_select(YUV_IMPL_AUTO);
+    }
+    printf("YUYV conversion with %s\n", yuv_impl_name(impl));
+
     /* Buggy driver paranoia. */
     min = fmt.fmt.pix.width * 2;
     if (fmt.fmt.pix.bytesperline < min)
@@ -940,11 +950,15 @@ int v4l2_frame_acquisition_loop(char *dev_name)
 
     start_capturing();
 
+    if(fw_start(HRES, VRES, WRITER_BUFFERS, FRAME_ARCHIVE) < 0)
+        errno_exit("fw_start");
+
     // service loop frame read
     mainloop();
 
     // shutdown of frame acquisition service
     stop_capturing();
+    fw_stop();
 
     printf("Total capture time=%lf, for %d frames, %lf FPS\n", (fstop-fstart), read_framecnt, ((double)read_framecnt / (fstop-fstart)));
 
@@ -961,6 +975,9 @@ int v4l2_frame_acquisition_initialization(char *dev_name)
     open_device(dev_name);
     init_device(dev_name);
 
+    if(fw_start(HRES, VRES, WRITER_BUFFERS, FRAME_ARCHIVE) < 0)
+        errno_exit("fw_start");
+
     start_capturing();
 }
 
@@ -971,6 +988,14 @@ int v4l2_frame_acquisition_shutdown(void)
     stop_capturing();
 
     printf("Total capture time=%lf, for %d frames, %lf FPS\n", (fstop-fstart), read_framecnt+1, ((double)read_framecnt / (fstop-fstart)));
+    printf("Processed %d frames, skipped %llu older frames, dropped %llu on a full queue and %llu unstored\n",
+           process_framecnt, capture_skipped, capture_dropped, store_dropped);
+    syslog(LOG_CRIT, "Processed %d frames, skipped %llu older frames, dropped %llu on a full queue and %llu unstored\n",
+           process_framecnt, capture_skipped, capture_dropped, store_dropped);
+    fq_print_stats(&capture_queue, "capture");
+    fq_print_stats(&store_queue, "store");
+    fq_print_stats(&free_queue, "free");
+    fw_stop();
 
     uninit_device();
     close_device();
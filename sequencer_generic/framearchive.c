@@ -0,0 +1,330 @@
+// Frame archive, see framearchive.h
+//
+// The writer appends whole records with O_DIRECT, like framewriter.c does
+// for single frames, preallocating FA_PREALLOC_RECORDS at a time beyond the
+// end of the file so the file size only ever covers complete records.  The
+// index is kept in memory and written with the final header on close.
+//
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "framearchive.h"
+
+#define FA_PREALLOC_RECORDS (64)
+#define FA_INDEX_START (1024)
+
+
+unsigned int fa_record_bytes(int width, int height)
+{
+    unsigned int bytes=sizeof(fa_record_t) + (unsigned int)width*height*3;
+
+    return ((bytes + FA_ALIGN - 1) / FA_ALIGN) * FA_ALIGN;
+}
+
+
+static void fa_buffered(fa_writer_t *w)
+{
+    fcntl(w->fd, F_SETFL, fcntl(w->fd, F_GETFL) & ~O_DIRECT);
+    w->direct=0;
+}
+
+
+// data is FA_ALIGN aligned and bytes a multiple of it while writing direct
+static int fa_write(fa_writer_t *w, const void *data, size_t bytes, unsigned long long offset)
+{
+    size_t total=0;
+    ssize_t written;
+
+    while(total < bytes)
+    {
+        written=pwrite(w->fd, (const char *)data+total, bytes-total, offset+total);
+
+        if(written < 0)
+        {
+            if(errno == EINTR)
+                continue;
+
+            // accepted O_DIRECT at open, but not for I/O
+            if(w->direct && (errno == EINVAL))
+            {
+                fa_buffered(w);
+                continue;
+            }
+
+            perror("fa_write");
+            return -1;
+        }
+
+        total+=written;
+    }
+
+    return 0;
+}
+
+
+static int fa_write_header(fa_writer_t *w)
+{
+    void *block;
+    int rc;
+
+    if(posix_memalign(&block, FA_ALIGN, FA_ALIGN) != 0)
+        return -1;
+
+    memset(block, 0, FA_ALIGN);
+    memcpy(block, &w->header, sizeof(fa_header_t));
+    rc=fa_write(w, block, FA_ALIGN, 0);
+    free(block);
+
+    return rc;
+}
+
+
+int fa_create(fa_writer_t *w, const char *name, int width, int height)
+{
+    struct timespec now;
+
+    memset(w, 0, sizeof(fa_writer_t));
+
+    w->direct=1;
+    if((w->fd=open(name, O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 00666)) < 0)
+    {
+        w->direct=0;
+        w->fd=open(name, O_WRONLY | O_CREAT | O_TRUNC, 00666);
+    }
+
+    if(w->fd < 0)
+    {
+        perror(name);
+        return -1;
+    }
+
+    clock_gettime(CLOCK_REALTIME, &now);
+
+    memcpy(w->header.magic, FA_MAGIC, sizeof(w->header.magic));
+    w->header.version=FA_VERSION;
+    w->header.header_bytes=FA_ALIGN;
+    w->header.record_bytes=fa_record_bytes(width, height);
+    w->header.width=width;
+    w->header.height=height;
+    w->header.created_sec=now.tv_sec;
+    w->header.created_nsec=now.tv_nsec;
+
+    w->allocated=FA_ALIGN;
+
+    if(((w->index=malloc(FA_INDEX_START * sizeof(fa_index_t))) == NULL) || (fa_write_header(w) < 0))
+    {
+        close(w->fd);
+        free(w->index);
+        return -1;
+    }
+
+    w->index_size=FA_INDEX_START;
+    return 0;
+}
+
+
+int fa_append(fa_writer_t *w, const void *record)
+{
+    const fa_record_t *rec=record;
+    unsigned long long offset=w->header.header_bytes + (unsigned long long)w->header.frames * w->header.record_bytes;
+    fa_index_t *entry, *grown;
+
+    if(w->header.frames == w->index_size)
+    {
+        if((grown=realloc(w->index, 2 * w->index_size * sizeof(fa_index_t))) == NULL)
+            return -1;
+
+        w->index=grown;
+        w->index_size*=2;
+    }
+
+    // not every file system can preallocate, which is fine
+    if(offset + w->header.record_bytes > w->allocated)
+    {
+        fallocate(w->fd, FALLOC_FL_KEEP_SIZE, w->allocated,
+                  (unsigned long long)FA_PREALLOC_RECORDS * w->header.record_bytes);
+        w->allocated+=(unsigned long long)FA_PREALLOC_RECORDS * w->header.record_bytes;
+    }
+
+    if(fa_write(w, record, w->header.record_bytes, offset) < 0)
+        return -1;
+
+    entry=&w->index[w->header.frames++];
+    entry->offset=offset;
+    entry->sequence=rec->sequence;
+    entry->kind=rec->kind;
+    entry->tv_sec=rec->tv_sec;
+    entry->tv_nsec=rec->tv_nsec;
+
+    return 0;
+}
+
+
+int fa_close(fa_writer_t *w)
+{
+    unsigned long long offset=w->header.header_bytes + (unsigned long long)w->header.frames * w->header.record_bytes;
+    size_t bytes=(size_t)w->header.frames * sizeof(fa_index_t);
+    int rc=0;
+
+    // the index is not a whole number of blocks
+    fa_buffered(w);
+
+    if(fa_write(w, w->index, bytes, offset) < 0)
+        rc=-1;
+
+    else
+    {
+        // drop whatever was preallocated past the index
+        ftruncate(w->fd, offset + bytes);
+
+        w->header.index_offset=offset;
+        rc=fa_write_header(w);
+    }
+
+    close(w->fd);
+    free(w->index);
+    w->index=NULL;
+
+    return rc;
+}
+
+
+int fa_open(fa_reader_t *r, const char *name)
+{
+    struct stat st;
+    fa_header_t *h;
+    unsigned long long pixels, records;
+    int fd;
+
+    memset(r, 0, sizeof(fa_reader_t));
+
+    if((fd=open(name, O_RDONLY)) < 0)
+    {
+        perror(name);
+        return -1;
+    }
+
+    if((fstat(fd, &st) < 0) || (st.st_size < (off_t)sizeof(fa_header_t)))
+    {
+        fprintf(stderr, "%s: not a frame archive\n", name);
+        close(fd);
+        return -1;
+    }
+
+    r->length=st.st_size;
+    r->map=mmap(NULL, r->length, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if(r->map == MAP_FAILED)
+    {
+        perror(name);
+        return -1;
+    }
+
+    h=r->header=(fa_header_t *)r->map;
+
+    if((memcmp(h->magic, FA_MAGIC, sizeof(h->magic)) != 0) || (h->version != FA_VERSION))
+    {
+        fprintf(stderr, "%s: not a version %d frame archive\n", name, FA_VERSION);
+        fa_unmap(r);
+        return -1;
+    }
+
+    // every record must hold a whole frame, and every frame be in the file,
+    // before fa_frame() hands out pointers into the mapping
+    pixels=(unsigned long long)h->width * h->height * 3;
+
+    if((pixels == 0) || (pixels > (unsigned int)-1 - sizeof(fa_record_t) - FA_ALIGN) ||
+       (h->record_bytes < fa_record_bytes(h->width, h->height)) ||
+       (h->header_bytes < sizeof(fa_header_t)) || (h->header_bytes > r->length))
+    {
+        fprintf(stderr, "%s: corrupt archive header\n", name);
+        fa_unmap(r);
+        return -1;
+    }
+
+    records=h->header_bytes + (unsigned long long)h->frames * h->record_bytes;
+
+    if((h->index_offset != 0) && (h->index_offset <= r->length) &&
+       ((unsigned long long)h->frames * sizeof(fa_index_t) <= r->length - h->index_offset))
+    {
+        if(records > h->index_offset)
+        {
+            fprintf(stderr, "%s: corrupt archive index\n", name);
+            fa_unmap(r);
+            return -1;
+        }
+
+        r->index=(fa_index_t *)(r->map + h->index_offset);
+        r->frames=h->frames;
+    }
+
+    // never closed, recover every complete record
+    else
+        r->frames=(r->length - h->header_bytes) / h->record_bytes;
+
+    return 0;
+}
+
+
+void fa_unmap(fa_reader_t *r)
+{
+    munmap(r->map, r->length);
+    r->map=NULL;
+}
+
+
+fa_record_t *fa_frame(fa_reader_t *r, unsigned int n)
+{
+    if(n >= r->frames)
+        return NULL;
+
+    return (fa_record_t *)(r->map + r->header->header_bytes + (unsigned long long)n * r->header->record_bytes);
+}
+
+
+static int before(long long sec, long long nsec, struct timespec *time)
+{
+    return (sec < time->tv_sec) || ((sec == time->tv_sec) && (nsec < time->tv_nsec));
+}
+
+
+unsigned int fa_find_time(fa_reader_t *r, struct timespec *time)
+{
+    unsigned int low=0, high=r->frames, mid;
+    fa_record_t *rec;
+
+    // frames are in the order they were read, so in time order
+    while(low < high)
+    {
+        mid=low + (high-low)/2;
+
+        if(r->index)
+        {
+            if(before(r->index[mid].tv_sec, r->index[mid].tv_nsec, time))
+                low=mid+1;
+            else
+                high=mid;
+        }
+        else
+        {
+            rec=fa_frame(r, mid);
+
+            if(before(rec->tv_sec, rec->tv_nsec, time))
+                low=mid+1;
+            else
+                high=mid;
+        }
+    }
+
+    return low;
+}
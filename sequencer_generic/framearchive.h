@@ -0,0 +1,107 @@
+#ifndef _FRAMEARCHIVE_
+#define _FRAMEARCHIVE_
+
+#include <time.h>
+
+// Frame archive, every stored frame in one file
+//
+// +----------------------+  0
+// | fa_header_t          |  padded to FA_ALIGN
+// +----------------------+  header_bytes
+// | record 0             |  fa_record_t, then the pixels, padded to
+// | record 1             |  record_bytes, a multiple of FA_ALIGN, so
+// | ...                  |  record n is at header_bytes + n*record_bytes
+// +----------------------+  index_offset
+// | fa_index_t [frames]  |  written when the archive is closed
+// +----------------------+
+//
+// Fields are in host byte order.  Records are page aligned, so a reader can
+// mmap() the whole file and use the pixels in place.  An archive that was
+// never closed has index_offset 0, and the frames are recovered from the
+// file size, since every record is the same size.
+
+#define FA_MAGIC "SEQFRAME"
+#define FA_VERSION (1)
+#define FA_ALIGN (4096)
+
+// same kinds as framewriter.h
+#define FA_PGM (0)
+#define FA_PPM (1)
+
+typedef struct
+{
+    char magic[8];
+    unsigned int version;
+    unsigned int header_bytes;
+    unsigned int record_bytes;
+    unsigned int width;
+    unsigned int height;
+    unsigned int frames;
+    unsigned long long index_offset;
+    long long created_sec;      // CLOCK_REALTIME when created
+    long long created_nsec;
+} fa_header_t;
+
+typedef struct
+{
+    unsigned int sequence;
+    unsigned int kind;          // FA_PGM or FA_PPM
+    unsigned int bytes;         // pixel bytes that follow
+    unsigned int reserved;
+    long long tv_sec;           // CLOCK_MONOTONIC when the frame was read
+    long long tv_nsec;
+    unsigned char pad[32];      // keeps the pixels 64 byte aligned
+} fa_record_t;
+
+typedef struct
+{
+    unsigned long long offset;
+    unsigned int sequence;
+    unsigned int kind;
+    long long tv_sec;
+    long long tv_nsec;
+} fa_index_t;
+
+// record size for frames of up to width x height RGB
+unsigned int fa_record_bytes(int width, int height);
+
+typedef struct
+{
+    int fd;
+    int direct;
+    fa_header_t header;
+    fa_index_t *index;
+    unsigned int index_size;
+    unsigned long long allocated;
+} fa_writer_t;
+
+// returns 0 or -1
+int fa_create(fa_writer_t *w, const char *name, int width, int height);
+
+// record is fa_record_bytes() long, FA_ALIGN aligned and already filled in,
+// so it goes to the file as it is, returns 0 or -1
+int fa_append(fa_writer_t *w, const void *record);
+
+// writes the index and final header, returns 0 or -1
+int fa_close(fa_writer_t *w);
+
+typedef struct
+{
+    unsigned char *map;
+    size_t length;
+    fa_header_t *header;
+    fa_index_t *index;          // NULL when the archive was never closed
+    unsigned int frames;
+} fa_reader_t;
+
+// maps the archive read only, returns 0 or -1
+int fa_open(fa_reader_t *r, const char *name);
+void fa_unmap(fa_reader_t *r);
+
+// record of frame n, pixels follow it, NULL past the end
+fa_record_t *fa_frame(fa_reader_t *r, unsigned int n);
+
+// first frame read at or after time, frames if none
+unsigned int fa_find_time(fa_reader_t *r, struct timespec *time);
+
+#endif
@@ -0,0 +1,148 @@
+// Frame archive listing and export
+//
+// Maps a frame archive written by capturelib (framearchive.h).  With only the
+// archive it lists every frame with its sequence number and CLOCK_MONOTONIC
+// time, and the intervals between them.  Given a directory it writes frames
+// back out as PPM/PGM, with the same timestamp comment the capture used to
+// put in each file, from the first frame (a number, or @seconds for the first
+// frame read at or after that time) for count frames.
+//
+// usage: frameexport archive [directory [first|@seconds [count]]]
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "framearchive.h"
+
+
+static double record_sec(fa_record_t *rec)
+{
+    return (double)rec->tv_sec + (double)rec->tv_nsec / 1000000000.0;
+}
+
+
+static void list_frames(fa_reader_t *r)
+{
+    fa_record_t *rec;
+    double last=0.0, interval, total=0.0, max=0.0;
+    unsigned int n;
+
+    for(n=0; n < r->frames; n++)
+    {
+        rec=fa_frame(r, n);
+
+        printf("%8u seq %8u %s %8u bytes at %.6lf", n, rec->sequence, (rec->kind == FA_PPM) ? "ppm" : "pgm",
+               rec->bytes, record_sec(rec));
+
+        if(n > 0)
+        {
+            interval=record_sec(rec) - last;
+            total+=interval;
+            if(interval > max) max=interval;
+            printf(" +%.6lf", interval);
+        }
+
+        printf("\n");
+        last=record_sec(rec);
+    }
+
+    if(r->frames > 1)
+        printf("interval mean %.6lf sec, max %.6lf sec\n", total / (r->frames-1), max);
+}
+
+
+static int export_frame(fa_record_t *rec, fa_reader_t *r, char *directory)
+{
+    char name[1024];
+    FILE *out;
+    int rc=0;
+
+    if(rec->bytes > r->header->record_bytes - sizeof(fa_record_t))
+    {
+        fprintf(stderr, "frame %u: %u pixel bytes do not fit a %u byte record\n",
+                rec->sequence, rec->bytes, r->header->record_bytes);
+        return -1;
+    }
+
+    snprintf(name, sizeof(name), "%s/frame%08u.%s", directory, rec->sequence, (rec->kind == FA_PPM) ? "ppm" : "pgm");
+
+    if((out=fopen(name, "wb")) == NULL)
+    {
+        perror(name);
+        return -1;
+    }
+
+    fprintf(out, "%s\n#%010d sec %010d msec \n%u %u\n255\n", (rec->kind == FA_PPM) ? "P6" : "P5",
+            (int)rec->tv_sec, (int)(rec->tv_nsec/1000000), r->header->width, r->header->height);
+
+    if(fwrite(rec+1, 1, rec->bytes, out) != rec->bytes)
+    {
+        perror(name);
+        rc=-1;
+    }
+
+    fclose(out);
+    return rc;
+}
+
+
+int main(int argc, char **argv)
+{
+    fa_reader_t archive;
+    struct timespec start;
+    unsigned int first=0, count, n;
+    int rc=0;
+    double sec;
+
+    if((argc < 2) || (argc > 5))
+    {
+        printf("usage: frameexport archive [directory [first|@seconds [count]]]\n");
+        exit(-1);
+    }
+
+    if(fa_open(&archive, argv[1]) < 0)
+        exit(-1);
+
+    printf("%s: %u frames of %ux%u, %u byte records%s\n", argv[1], archive.frames,
+           archive.header->width, archive.header->height, archive.header->record_bytes,
+           archive.index ? "" : ", no index (recovered from the file size)");
+
+    if(argc == 2)
+    {
+        list_frames(&archive);
+        fa_unmap(&archive);
+        return 0;
+    }
+
+    if(argc > 3)
+    {
+        if(argv[3][0] == '@')
+        {
+            sec=atof(&argv[3][1]);
+            start.tv_sec=(time_t)sec;
+            start.tv_nsec=(long)((sec - (double)start.tv_sec) * 1000000000.0);
+            first=fa_find_time(&archive, &start);
+        }
+        else
+            first=atoi(argv[3]);
+    }
+
+    count = (first < archive.frames) ? archive.frames - first : 0;
+
+    if((argc > 4) && ((unsigned int)atoi(argv[4]) < count))
+        count=atoi(argv[4]);
+
+    for(n=first; n < first+count; n++)
+    {
+        if((rc=export_frame(fa_frame(&archive, n), &archive, argv[2])) < 0)
+            break;
+    }
+
+    printf("exported %u frames from %u to %s\n", n-first, first, argv[2]);
+
+    fa_unmap(&archive);
+    return rc;
+}
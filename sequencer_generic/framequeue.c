@@ -0,0 +1,185 @@
+// Bounded lock-free frame queue, see framequeue.h
+//
+// Memory ordering: a producer writes the frame into its slot and then stores
+// the slot sequence pos+1 with release, which a consumer loads with acquire
+// before reading the frame, and the consumer in turn releases the slot with
+// sequence pos+size for the producer one lap later.  The positions themselves
+// only order producers among producers and consumers among consumers, so
+// they are relaxed.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <syslog.h>
+
+#include "framequeue.h"
+
+
+int fq_init(frame_queue_t *q, unsigned int size)
+{
+    unsigned int i;
+
+    // with one slot a full queue looks free to the next push
+    if(size < 2)
+        return -1;
+
+    if(posix_memalign((void **)&q->slots, FQ_CACHE_LINE, sizeof(fq_slot_t) * size) != 0)
+        return -1;
+
+    for(i=0; i < size; i++)
+        q->slots[i].seq = i;
+
+    q->size = size;
+    q->enqueue_pos = 0;
+    q->dequeue_pos = 0;
+    q->pushed = 0;
+    q->popped = 0;
+    q->full = 0;
+    q->max_depth = 0;
+
+    return 0;
+}
+
+
+void fq_destroy(frame_queue_t *q)
+{
+    free(q->slots);
+    q->slots = NULL;
+}
+
+
+static void note_push(frame_queue_t *q, unsigned long long pos)
+{
+    unsigned int depth = pos + 1 - __atomic_load_n(&q->dequeue_pos, __ATOMIC_RELAXED);
+
+    __atomic_fetch_add(&q->pushed, 1, __ATOMIC_RELAXED);
+
+    // approximate with more than one producer, which is fine for a statistic
+    if(depth > __atomic_load_n(&q->max_depth, __ATOMIC_RELAXED))
+        __atomic_store_n(&q->max_depth, depth, __ATOMIC_RELAXED);
+}
+
+
+int fq_push(frame_queue_t *q, const frame_desc_t *frame)
+{
+    unsigned long long pos = __atomic_load_n(&q->enqueue_pos, __ATOMIC_RELAXED), seq;
+    fq_slot_t *slot;
+    long long diff;
+
+    for(;;)
+    {
+        slot = &q->slots[pos % q->size];
+        seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+        diff = (long long)(seq - pos);
+
+        // free for this lap, claim it
+        if(diff == 0)
+        {
+            if(__atomic_compare_exchange_n(&q->enqueue_pos, &pos, pos + 1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                break;
+        }
+
+        // still holding the frame from the last lap
+        else if(diff < 0)
+        {
+            __atomic_fetch_add(&q->full, 1, __ATOMIC_RELAXED);
+            return 0;
+        }
+
+        // another producer got there first
+        else
+            pos = __atomic_load_n(&q->enqueue_pos, __ATOMIC_RELAXED);
+    }
+
+    slot->frame = *frame;
+    __atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+    note_push(q, pos);
+
+    return 1;
+}
+
+
+int fq_push_spsc(frame_queue_t *q, const frame_desc_t *frame)
+{
+    unsigned long long pos = q->enqueue_pos;
+    fq_slot_t *slot = &q->slots[pos % q->size];
+
+    if(__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != pos)
+    {
+        q->full++;
+        return 0;
+    }
+
+    slot->frame = *frame;
+    __atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&q->enqueue_pos, pos + 1, __ATOMIC_RELAXED);
+    note_push(q, pos);
+
+    return 1;
+}
+
+
+int fq_pop(frame_queue_t *q, frame_desc_t *frame)
+{
+    unsigned long long pos = __atomic_load_n(&q->dequeue_pos, __ATOMIC_RELAXED), seq;
+    fq_slot_t *slot;
+    long long diff;
+
+    for(;;)
+    {
+        slot = &q->slots[pos % q->size];
+        seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+        diff = (long long)(seq - (pos + 1));
+
+        if(diff == 0)
+        {
+            if(__atomic_compare_exchange_n(&q->dequeue_pos, &pos, pos + 1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                break;
+        }
+        else if(diff < 0)
+            return 0;
+        else
+            pos = __atomic_load_n(&q->dequeue_pos, __ATOMIC_RELAXED);
+    }
+
+    *frame = slot->frame;
+    __atomic_store_n(&slot->seq, pos + q->size, __ATOMIC_RELEASE);
+    __atomic_fetch_add(&q->popped, 1, __ATOMIC_RELAXED);
+
+    return 1;
+}
+
+
+int fq_pop_spsc(frame_queue_t *q, frame_desc_t *frame)
+{
+    unsigned long long pos = q->dequeue_pos;
+    fq_slot_t *slot = &q->slots[pos % q->size];
+
+    if(__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != pos + 1)
+        return 0;
+
+    *frame = slot->frame;
+    __atomic_store_n(&slot->seq, pos + q->size, __ATOMIC_RELEASE);
+    __atomic_store_n(&q->dequeue_pos, pos + 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&q->popped, 1, __ATOMIC_RELAXED);
+
+    return 1;
+}
+
+
+unsigned int fq_depth(frame_queue_t *q)
+{
+    unsigned long long out = __atomic_load_n(&q->dequeue_pos, __ATOMIC_RELAXED);
+    unsigned long long in = __atomic_load_n(&q->enqueue_pos, __ATOMIC_RELAXED);
+
+    return (in > out) ? (unsigned int)(in - out) : 0;
+}
+
+
+void fq_print_stats(frame_queue_t *q, char *name)
+{
+    printf("%s queue: size %u, pushed %llu, popped %llu, full %llu, depth %u, max depth %u\n",
+           name, q->size, q->pushed, q->popped, q->full, fq_depth(q), q->max_depth);
+    syslog(LOG_CRIT, "%s queue: size %u, pushed %llu, popped %llu, full %llu, depth %u, max depth %u\n",
+           name, q->size, q->pushed, q->popped, q->full, fq_depth(q), q->max_depth);
+}
@@ -0,0 +1,70 @@
+#ifndef _FRAMEQUEUE_
+#define _FRAMEQUEUE_
+
+#include <time.h>
+
+// Bounded lock-free queue of frame descriptors between sequencer services
+//
+// Each slot carries a sequence number (Vyukov's bounded MPMC queue): a slot
+// is free for the push at position pos when its sequence is pos, and full
+// for the pop at pos when it is pos+1, so producers and consumers never touch
+// the same index.  The producer and consumer positions and counters are on
+// separate cache lines.
+//
+// fq_push()/fq_pop() take any number of producers and consumers, claiming a
+// position with compare-and-swap.  fq_push_spsc()/fq_pop_spsc() skip the CAS
+// when one thread is the only producer or the only consumer - a side must use
+// one kind or the other, never both.
+
+#define FQ_CACHE_LINE (64)
+
+typedef struct
+{
+    unsigned int    index;          // V4L2 buffer or processed frame slot
+    unsigned int    bytesused;
+    unsigned int    sequence;       // frame count when read
+    struct timespec time_stamp;     // CLOCK_MONOTONIC when read
+} frame_desc_t;
+
+typedef struct
+{
+    unsigned long long seq;
+    frame_desc_t frame;
+} fq_slot_t;
+
+typedef struct
+{
+    // producer side
+    unsigned long long enqueue_pos __attribute__((aligned(FQ_CACHE_LINE)));
+    unsigned long long pushed;
+    unsigned long long full;        // pushes refused
+    unsigned int max_depth;
+
+    // consumer side
+    unsigned long long dequeue_pos __attribute__((aligned(FQ_CACHE_LINE)));
+    unsigned long long popped;
+
+    // read only after fq_init()
+    unsigned int size __attribute__((aligned(FQ_CACHE_LINE)));
+    fq_slot_t *slots;
+} frame_queue_t;
+
+// size is the capacity, any size from 2, returns 0 or -1 out of memory or
+// for a smaller size
+int fq_init(frame_queue_t *q, unsigned int size);
+void fq_destroy(frame_queue_t *q);
+
+// returns 1 if pushed, 0 if full
+int fq_push(frame_queue_t *q, const frame_desc_t *frame);
+int fq_push_spsc(frame_queue_t *q, const frame_desc_t *frame);
+
+// returns 1 if popped, 0 if empty
+int fq_pop(frame_queue_t *q, frame_desc_t *frame);
+int fq_pop_spsc(frame_queue_t *q, frame_desc_t *frame);
+
+// frames queued now, a snapshot when other threads are running
+unsigned int fq_depth(frame_queue_t *q);
+
+void fq_print_stats(frame_queue_t *q, char *name);
+
+#endif
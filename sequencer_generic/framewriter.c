@@ -0,0 +1,350 @@
+// Asynchronous frame writer, see framewriter.h
+//
+// dump_ppm()/dump_pgm() used to open a new file per frame, rebuild the header
+// with several snprintf()/strncat() calls and write() it all synchronously in
+// the storage service.  Here the service only copies the frame into a buffer
+// and queues it:
+//
+// 1) buffers are allocated once, aligned for O_DIRECT, and pass between the
+//    service and the writer thread through two single producer, single
+//    consumer frame queues - waiting to be written and free again
+// 2) the header is formatted with one snprintf() straight into the buffer,
+//    in front of the pixels, so the file is a single write
+// 3) each file is preallocated to its final size with fallocate() and
+//    written with O_DIRECT, bypassing the page cache so a burst of frames
+//    does not stall later in writeback.  The write is rounded up to whole
+//    blocks and the file truncated back.  File systems that refuse O_DIRECT
+//    (e.g. tmpfs) get ordinary buffered writes instead.
+// 4) the writer wakes on a semaphore and writes out everything queued,
+//    recording how long each write took and how long each frame waited
+//    from queueing to being on disk, as log2 histograms in usec
+// 5) given an archive name, frames go to a single frame archive instead
+//    (framearchive.h) - the buffer is then laid out as an archive record, so
+//    it is appended as it is, with no per-frame file at all
+//
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <unistd.h>
+
+#include "framearchive.h"
+#include "framequeue.h"
+#include "framewriter.h"
+
+#define FW_ALIGN (4096)
+#define FW_HEADER_MAX (64)
+#define FW_HIST_BUCKETS (24)    // up to 2^23 usec, about 8 seconds
+
+typedef struct
+{
+    unsigned char *data;        // PNM header or archive record, then pixels
+    int bytes;
+    int kind;
+    unsigned int tag;
+    struct timespec queued;
+} fwBuffer_t;
+
+static fwBuffer_t *fw_buffers;
+static int fw_nbuffers, fw_width, fw_height;
+static frame_queue_t fw_write_queue, fw_free_queue;
+static sem_t fw_sem;
+static pthread_t fw_thread;
+static volatile int fw_abort;
+static int fw_direct=1;
+static int fw_archiving;
+static fa_writer_t fw_archive;
+
+static unsigned long long fw_written, fw_dropped, fw_failed;
+static unsigned long long fw_write_hist[FW_HIST_BUCKETS], fw_total_hist[FW_HIST_BUCKETS];
+static unsigned long long fw_write_max, fw_total_max;
+
+
+static unsigned long long usec_since(struct timespec *start)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (unsigned long long)(now.tv_sec - start->tv_sec) * 1000000ULL +
+           (now.tv_nsec - start->tv_nsec) / 1000;
+}
+
+
+static void histogram_add(unsigned long long hist[], unsigned long long *max, unsigned long long usec)
+{
+    int bucket=0;
+
+    while((bucket < FW_HIST_BUCKETS-1) && ((1ULL << bucket) <= usec))
+        bucket++;
+
+    hist[bucket]++;
+    if(usec > *max) *max=usec;
+}
+
+
+static void histogram_print(char *name, unsigned long long hist[], unsigned long long max)
+{
+    int bucket;
+
+    printf("%s latency, max %llu usec\n", name, max);
+    syslog(LOG_CRIT, "%s latency, max %llu usec\n", name, max);
+
+    for(bucket=0; bucket < FW_HIST_BUCKETS; bucket++)
+    {
+        if(hist[bucket] == 0)
+            continue;
+
+        printf("  < %8llu usec %8llu\n", 1ULL << bucket, hist[bucket]);
+        syslog(LOG_CRIT, "%s < %llu usec %llu\n", name, 1ULL << bucket, hist[bucket]);
+    }
+}
+
+
+static int open_frame_file(char *name, int direct)
+{
+    return open(name, O_WRONLY | O_CREAT | O_TRUNC | (direct ? O_DIRECT : 0), 00666);
+}
+
+
+// Whole file in one go, O_DIRECT if it works here, returns 0 or -1
+//
+static int write_frame_file(char *name, unsigned char *data, int bytes)
+{
+    int fd, direct=fw_direct, length, total=0, written;
+
+    if((fd=open_frame_file(name, direct)) < 0 && direct)
+    {
+        direct=0;
+        fd=open_frame_file(name, direct);
+    }
+
+    if(fd < 0)
+    {
+        perror(name);
+        return -1;
+    }
+
+    // O_DIRECT transfers whole blocks from the aligned buffer
+    length = direct ? ((bytes + FW_ALIGN - 1) / FW_ALIGN) * FW_ALIGN : bytes;
+
+    // not every file system can preallocate, which is fine
+    fallocate(fd, 0, 0, length);
+
+    while(total < length)
+    {
+        written=pwrite(fd, data+total, length-total, total);
+
+        if(written < 0)
+        {
+            if(errno == EINTR)
+                continue;
+
+            // accepted O_DIRECT at open, but not for I/O - buffered from now on
+            if(direct && (errno == EINVAL))
+            {
+                close(fd);
+                fw_direct=0;
+                return write_frame_file(name, data, bytes);
+            }
+
+            perror(name);
+            close(fd);
+            return -1;
+        }
+
+        total+=written;
+    }
+
+    if(direct && (length != bytes))
+        ftruncate(fd, bytes);
+
+    close(fd);
+    return 0;
+}
+
+
+static void *fw_writer(void *arg)
+{
+    char name[64];
+    frame_desc_t desc;
+    fwBuffer_t *buf;
+    struct timespec start;
+    int done=0;
+
+    while(!done)
+    {
+        sem_wait(&fw_sem);
+        done=fw_abort;
+
+        // everything queued, including any left when told to stop
+        while(fq_pop_spsc(&fw_write_queue, &desc))
+        {
+            buf=&fw_buffers[desc.index];
+
+            clock_gettime(CLOCK_MONOTONIC, &start);
+
+            if(fw_archiving)
+            {
+                if(fa_append(&fw_archive, buf->data) == 0)
+                    fw_written++;
+                else
+                    fw_failed++;
+            }
+            else
+            {
+                snprintf(name, sizeof(name), "frames/test%04u.%s", buf->tag, (buf->kind == FW_PPM) ? "ppm" : "pgm");
+
+                if(write_frame_file(name, buf->data, buf->bytes) == 0)
+                    fw_written++;
+                else
+                    fw_failed++;
+            }
+
+            histogram_add(fw_write_hist, &fw_write_max, usec_since(&start));
+            histogram_add(fw_total_hist, &fw_total_max, usec_since(&buf->queued));
+
+            fq_push_spsc(&fw_free_queue, &desc);
+        }
+    }
+
+    return NULL;
+}
+
+
+int fw_start(int width, int height, int nbuffers, const char *archive)
+{
+    size_t size=FW_HEADER_MAX + (size_t)width*height*3;
+    frame_desc_t desc;
+    int i;
+
+    size=((size + FW_ALIGN - 1) / FW_ALIGN) * FW_ALIGN;
+
+    fw_archiving=(archive != NULL);
+    if(fw_archiving)
+    {
+        if(fa_create(&fw_archive, archive, width, height) < 0)
+            return -1;
+
+        size=fa_record_bytes(width, height);
+    }
+
+    fw_width=width;
+    fw_height=height;
+    fw_nbuffers=nbuffers;
+    fw_abort=0;
+    fw_written=fw_dropped=fw_failed=0;
+    fw_write_max=fw_total_max=0;
+    memset(fw_write_hist, 0, sizeof(fw_write_hist));
+    memset(fw_total_hist, 0, sizeof(fw_total_hist));
+
+    if(((fw_buffers=calloc(nbuffers, sizeof(fwBuffer_t))) == NULL) ||
+       (fq_init(&fw_write_queue, nbuffers) < 0) || (fq_init(&fw_free_queue, nbuffers) < 0))
+        return -1;
+
+    memset(&desc, 0, sizeof(desc));
+
+    for(i=0; i < nbuffers; i++)
+    {
+        if(posix_memalign((void **)&fw_buffers[i].data, FW_ALIGN, size) != 0)
+            return -1;
+
+        desc.index=i;
+        fq_push_spsc(&fw_free_queue, &desc);
+    }
+
+    sem_init(&fw_sem, 0, 0);
+
+    if(pthread_create(&fw_thread, NULL, fw_writer, NULL) != 0)
+    {
+        perror("fw_start pthread_create");
+        return -1;
+    }
+
+    return 0;
+}
+
+
+int fw_write_frame(int kind, const void *pixels, int size, unsigned int tag, struct timespec *time)
+{
+    frame_desc_t desc;
+    fwBuffer_t *buf;
+    fa_record_t *rec;
+    int headerBytes;
+
+    if(!fq_pop_spsc(&fw_free_queue, &desc))
+    {
+        fw_dropped++;
+        return 0;
+    }
+
+    buf=&fw_buffers[desc.index];
+
+    if(fw_archiving)
+    {
+        rec=(fa_record_t *)buf->data;
+        memset(rec, 0, sizeof(fa_record_t));
+        rec->sequence=tag;
+        rec->kind=(kind == FW_PPM) ? FA_PPM : FA_PGM;
+        rec->bytes=size;
+        rec->tv_sec=time->tv_sec;
+        rec->tv_nsec=time->tv_nsec;
+        headerBytes=sizeof(fa_record_t);
+    }
+
+    else
+    {
+        // same header as before, written straight into the buffer
+        headerBytes=snprintf((char *)buf->data, FW_HEADER_MAX, "%s\n#%010d sec %010d msec \n%d %d\n255\n",
+                             (kind == FW_PPM) ? "P6" : "P5", (int)time->tv_sec, (int)(time->tv_nsec/1000000),
+                             fw_width, fw_height);
+    }
+    memcpy(buf->data + headerBytes, pixels, size);
+
+    buf->bytes=headerBytes + size;
+    buf->kind=kind;
+    buf->tag=tag;
+    clock_gettime(CLOCK_MONOTONIC, &buf->queued);
+
+    fq_push_spsc(&fw_write_queue, &desc);
+    sem_post(&fw_sem);
+
+    return 1;
+}
+
+
+void fw_stop(void)
+{
+    int i, direct;
+
+    fw_abort=1;
+    sem_post(&fw_sem);
+    pthread_join(fw_thread, NULL);
+
+    direct = fw_archiving ? fw_archive.direct : fw_direct;
+
+    printf("Frame writer: %llu written, %llu dropped with no free buffer, %llu failed, %s\n",
+           fw_written, fw_dropped, fw_failed, direct ? "O_DIRECT" : "buffered");
+    syslog(LOG_CRIT, "Frame writer: %llu written, %llu dropped with no free buffer, %llu failed, %s\n",
+           fw_written, fw_dropped, fw_failed, direct ? "O_DIRECT" : "buffered");
+
+    if(fw_archiving && (fa_close(&fw_archive) < 0))
+        printf("Frame writer: archive index not written, frames are still recoverable\n");
+
+    histogram_print("write", fw_write_hist, fw_write_max);
+    histogram_print("queued to written", fw_total_hist, fw_total_max);
+
+    for(i=0; i < fw_nbuffers; i++)
+        free(fw_buffers[i].data);
+
+    free(fw_buffers);
+    fq_destroy(&fw_write_queue);
+    fq_destroy(&fw_free_queue);
+    sem_destroy(&fw_sem);
+}
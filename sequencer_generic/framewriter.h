@@ -0,0 +1,29 @@
+#ifndef _FRAMEWRITER_
+#define _FRAMEWRITER_
+
+#include <time.h>
+
+// Asynchronous frame writer
+//
+// The storage service hands a frame to fw_write_frame(), which copies it into
+// a free aligned buffer behind a ready-made PNM header and returns, so it
+// never waits on the file system.  A writer thread then writes each frame to
+// frames/test%04d.ppm (or .pgm), preallocated with fallocate() and written
+// with O_DIRECT where the file system allows it - or, given an archive name,
+// appends it to that one frame archive (framearchive.h) instead.
+
+#define FW_PGM (0)
+#define FW_PPM (1)
+
+// nbuffers, at least 2, frames of up to width x height RGB can be waiting to
+// be written, archive NULL for a file per frame, returns 0 or -1
+int fw_start(int width, int height, int nbuffers, const char *archive);
+
+// tag is the frame number in the file name, or the archive record sequence,
+// returns 1 if queued, 0 if dropped because every buffer is waiting
+int fw_write_frame(int kind, const void *pixels, int size, unsigned int tag, struct timespec *time);
+
+// writes out all queued frames and prints the write latency histograms
+void fw_stop(void);
+
+#endif
@@ -0,0 +1,207 @@
+// Partitioned scheduling allocator for sequencer services
+//
+// Rather than a fixed split of services over cores (e.g. even thread indexes
+// on core 2 and odd on core 3), take each service's period and WCET and bin
+// pack them:
+//
+// 1) sort by utilization C/T, largest first - the decreasing order is what
+//    keeps first-fit and worst-fit within a small factor of the fewest cores
+// 2) try each service on the candidate cores, first-fit in core order or
+//    worst-fit from the least utilized core up, and keep it on the first one
+//    where every service on that core still meets its deadline (D=T)
+// 3) the per core test is exact response time analysis in rate monotonic
+//    order, in integer microseconds:
+//
+//        R(i) = C(i) + sum over higher priority j on the core of ceil(R(i)/T(j)) * C(j)
+//
+// Priority is rate monotonic over all services (ties by index), so a service
+// keeps the same relative priority on whichever core it lands.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <syslog.h>
+
+#include "seqalloc.h"
+
+
+static unsigned long long ceil_div(unsigned long long a, unsigned long long b)
+{
+    return (a + b - 1) / b;
+}
+
+
+// TRUE if service a has higher rate monotonic priority than b
+//
+static int higher_priority(seqService_t services[], int a, int b)
+{
+    if(services[a].periodUsec != services[b].periodUsec)
+        return (services[a].periodUsec < services[b].periodUsec);
+
+    return (a < b);
+}
+
+
+// Response time analysis of all services placed on core, responseUsec set
+// for each, returns 1 if they all meet their deadlines
+//
+static int core_feasible(int numServices, seqService_t services[], int core, seqService_t *overhead)
+{
+    unsigned long long an, anext;
+    int i, j;
+
+    for(i=0; i < numServices; i++)
+    {
+        if(services[i].core != core)
+            continue;
+
+        an = services[i].wcetUsec;
+        if(overhead) an += overhead->wcetUsec;
+
+        while(an <= services[i].periodUsec)
+        {
+            anext = services[i].wcetUsec;
+
+            if(overhead)
+                anext += ceil_div(an, overhead->periodUsec) * overhead->wcetUsec;
+
+            for(j=0; j < numServices; j++)
+                if((j != i) && (services[j].core == core) && higher_priority(services, j, i))
+                    anext += ceil_div(an, services[j].periodUsec) * services[j].wcetUsec;
+
+            if(anext == an)
+                break;
+
+            an = anext;
+        }
+
+        services[i].responseUsec = an;
+
+        if(an > services[i].periodUsec)
+            return 0;
+    }
+
+    return 1;
+}
+
+
+int seq_allocate(int numServices, seqService_t services[], int firstCore, int numCores,
+                 int policy, seqService_t *overhead)
+{
+    int *order, *coreOrder, i, j, k, tmp, core, used=0;
+    double *coreU, ui, uj;
+
+    order=malloc(sizeof(int) * numServices);
+    coreOrder=malloc(sizeof(int) * numCores);
+    coreU=calloc(numCores, sizeof(double));
+
+    if(!order || !coreOrder || !coreU)
+    {
+        perror("seq_allocate");
+        exit(-1);
+    }
+
+    // rate monotonic rank, and unassigned until placed
+    for(i=0; i < numServices; i++)
+    {
+        services[i].rank=0;
+        services[i].core=-1;
+        services[i].responseUsec=0;
+
+        for(j=0; j < numServices; j++)
+            if((j != i) && higher_priority(services, j, i))
+                services[i].rank++;
+    }
+
+    // decreasing utilization, insertion sort as the sets are small
+    for(i=0; i < numServices; i++)
+    {
+        order[i]=i;
+        ui=(double)services[i].wcetUsec / (double)services[i].periodUsec;
+
+        for(j=i; j > 0; j--)
+        {
+            uj=(double)services[order[j-1]].wcetUsec / (double)services[order[j-1]].periodUsec;
+            if(uj >= ui)
+                break;
+
+            order[j]=order[j-1];
+            order[j-1]=i;
+        }
+    }
+
+    for(i=0; i < numServices; i++)
+    {
+        // candidate cores, in core order for first-fit or least utilized first for worst-fit
+        for(k=0; k < numCores; k++)
+            coreOrder[k]=k;
+
+        if(policy == SEQ_WORST_FIT)
+        {
+            for(k=1; k < numCores; k++)
+                for(j=k; (j > 0) && (coreU[coreOrder[j]] < coreU[coreOrder[j-1]]); j--)
+                {
+                    tmp=coreOrder[j]; coreOrder[j]=coreOrder[j-1]; coreOrder[j-1]=tmp;
+                }
+        }
+
+        for(k=0; k < numCores; k++)
+        {
+            core=firstCore + coreOrder[k];
+            services[order[i]].core=core;
+
+            if(core_feasible(numServices, services, core, overhead))
+                break;
+        }
+
+        if(k == numCores)
+        {
+            printf("seq_allocate: %s (T=%llu usec, C=%llu usec) does not fit on cores %d-%d\n",
+                   services[order[i]].name, services[order[i]].periodUsec, services[order[i]].wcetUsec,
+                   firstCore, firstCore+numCores-1);
+            syslog(LOG_CRIT, "seq_allocate: %s does not fit on cores %d-%d\n",
+                   services[order[i]].name, firstCore, firstCore+numCores-1);
+            services[order[i]].core=-1;
+            services[order[i]].responseUsec=0;
+            used=-1;
+            break;
+        }
+
+        if(coreU[coreOrder[k]] == 0.0)
+            used++;
+
+        coreU[coreOrder[k]] += (double)services[order[i]].wcetUsec / (double)services[order[i]].periodUsec;
+    }
+
+    // final response times for every core, the last check only covers the last
+    // core tried, and after a failure the trials left values for cores the
+    // service did not fit on
+    for(k=0; k < numCores; k++)
+        core_feasible(numServices, services, firstCore+k, overhead);
+
+    free(order);
+    free(coreOrder);
+    free(coreU);
+
+    return used;
+}
+
+
+void seq_print_allocation(int numServices, seqService_t services[], int rt_max_prio)
+{
+    int i;
+
+    printf("Service    T usec    C usec      U  core  prio    R usec\n");
+
+    for(i=0; i < numServices; i++)
+    {
+        printf("%-7s %9llu %9llu %6.3lf %5d %5d %9llu\n", services[i].name,
+               services[i].periodUsec, services[i].wcetUsec,
+               (double)services[i].wcetUsec / (double)services[i].periodUsec,
+               services[i].core, rt_max_prio-1-services[i].rank, services[i].responseUsec);
+
+        syslog(LOG_CRIT, "%s T=%llu C=%llu usec on core %d at prio %d, R=%llu usec\n", services[i].name,
+               services[i].periodUsec, services[i].wcetUsec, services[i].core,
+               rt_max_prio-1-services[i].rank, services[i].responseUsec);
+    }
+}
@@ -0,0 +1,38 @@
+#ifndef _SEQALLOC_
+#define _SEQALLOC_
+
+// Partitioned (AMP) allocation of sequencer services to CPU cores
+//
+// Each service is bound to one core and scheduled SCHED_FIFO there with rate
+// monotonic priority, so a core is feasible when every service on it passes
+// response time analysis against the higher priority services on the same
+// core only.  seq_allocate() bins the services onto cores in decreasing
+// utilization order, first-fit (packs onto as few cores as possible) or
+// worst-fit (onto the least loaded core, balancing the slack).
+
+#define SEQ_FIRST_FIT (0)
+#define SEQ_WORST_FIT (1)
+
+typedef struct
+{
+    char *name;
+    unsigned long long periodUsec;
+    unsigned long long wcetUsec;
+
+    // filled in by seq_allocate()
+    int core;
+    int rank;                       // rate monotonic rank over all services, 0 highest
+    unsigned long long responseUsec;
+} seqService_t;
+
+// Assigns services[i].core in [firstCore, firstCore+numCores) and .rank,
+// overhead (may be NULL) is a highest priority load charged on every core,
+// e.g. the sequencer itself.  Returns the number of cores used, or -1 if some
+// service does not fit on any core, leaving that one on core -1 with
+// responseUsec 0 and the response times of the services already placed.
+int seq_allocate(int numServices, seqService_t services[], int firstCore, int numCores,
+                 int policy, seqService_t *overhead);
+
+void seq_print_allocation(int numServices, seqService_t services[], int rt_max_prio);
+
+#endif
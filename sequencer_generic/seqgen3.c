@@ -11,8 +11,9 @@
 //
 // 1) Uses SCEHD_FIFO - https://man7.org/linux/man-pages//man7/sched.7.html
 // 2) Sequencer runs on core 1
-// 3) EVEN thread indexes run on core 2
-// 4) ODD thread indexes run on core 3
+// 3) Services are partitioned over cores 2 and up by seqalloc.c, from their periods and WCETs below,
+//    so that every service passes response time analysis on its core
+// 4) Each service is bound to its core with rate monotonic priority
 // 5) Linux kernel mostly runs on core 0, but does load balance non-RT workload over all cores
 // 6) check for irqbalance [https://linux.die.net/man/1/irqbalance] which also distribute IRQ handlers
 //
@@ -65,7 +66,9 @@
 // Service_4 = RT_MAX-4	@ 5   Hz
 // Service_5 = RT_MAX-5	@ 2   Hz
 // Service_6 = RT_MAX-6	@ 1   Hz
-// Service_7 = RT_MIN	@ 1   Hz
+// Service_7 = RT_MAX-7	@ 1   Hz
+//
+// which seq_allocate() assigns as it places them, RT_MAX-1-rank by period
 //
 /////////////////////////////////////////////////////////////////////////////
 // JETSON SYSTEM NOTES:
@@ -120,6 +123,8 @@
 
 #include <signal.h>
 
+#include "seqalloc.h"
+
 #define USEC_PER_MSEC (1000)
 #define NANOSEC_PER_MSEC (1000000)
 #define NANOSEC_PER_SEC (1000000000)
@@ -129,6 +134,15 @@
 
 #define NUM_THREADS (7)
 
+// services are allocated to cores from here up, core 0 is left to the kernel and
+// core 1 to the sequencer
+#define SEQ_FIRST_CORE (2)
+//#define SEQ_ALLOC_POLICY SEQ_WORST_FIT
+#define SEQ_ALLOC_POLICY SEQ_FIRST_FIT
+
+// sequencer period, each service is released every so many of these
+#define SEQ_PERIOD_USEC (10000)
+
 // Of the available user space clocks, CLOCK_MONONTONIC_RAW is typically most precise and not subject to 
 // updates from external timer adjustments
 //
@@ -153,6 +167,22 @@ static struct itimerspec last_itime;
 
 static unsigned long long seqCnt=0;
 
+// Periods and WCET estimates for allocation - measure the WCETs for real services
+// (e.g. max of the syslog timestamps from release to completion) and update these
+//
+static seqService_t sequencer = {"Seq", SEQ_PERIOD_USEC, 100};
+
+static seqService_t services[NUM_THREADS] =
+{
+    {"S1", SEQ_PERIOD_USEC*2,   1000},
+    {"S2", SEQ_PERIOD_USEC*5,   2000},
+    {"S3", SEQ_PERIOD_USEC*10,  4000},
+    {"S4", SEQ_PERIOD_USEC*20,  8000},
+    {"S5", SEQ_PERIOD_USEC*50,  20000},
+    {"S6", SEQ_PERIOD_USEC*100, 40000},
+    {"S7", SEQ_PERIOD_USEC*100, 40000}
+};
+
 typedef struct
 {
     int threadIdx;
@@ -225,7 +255,7 @@ void main(void)
     pthread_t threads[NUM_THREADS];
     threadParams_t threadParams[NUM_THREADS];
     pthread_attr_t rt_sched_attr[NUM_THREADS];
-    int rt_max_prio, rt_min_prio, cpuidx;
+    int rt_max_prio, rt_min_prio, cpuidx, firstcore, numcores, usedcores;
 
     struct sched_param rt_param[NUM_THREADS];
     struct sched_param main_param;
@@ -288,45 +318,50 @@ void main(void)
     printf("rt_min_prio=%d\n", rt_min_prio);
 
 
-    for(i=0; i < NUM_THREADS; i++)
+    // partition the services over the cores after the sequencer's, or the last
+    // core if there are no more than that online
+    firstcore=SEQ_FIRST_CORE;
+    numcores=((get_nprocs() < NUM_CPU_CORES) ? get_nprocs() : NUM_CPU_CORES) - firstcore;
+    if(numcores < 1)
+    {
+        firstcore=get_nprocs()-1;
+        numcores=1;
+    }
+
+    // the SIGALRM handler can preempt a service on any core
+    usedcores=seq_allocate(NUM_THREADS, services, firstcore, numcores, SEQ_ALLOC_POLICY, &sequencer);
+    seq_print_allocation(NUM_THREADS, services, rt_max_prio);
+
+    if(usedcores < 0)
     {
+        printf("Services are not feasible on cores %d-%d\n", firstcore, firstcore+numcores-1);
+        exit(-1);
+    }
 
-      // run even indexed threads on core 2
-      if(i % 2 == 0)
-      {
-          CPU_ZERO(&threadcpu);
-          cpuidx=(2);
-          CPU_SET(cpuidx, &threadcpu);
-      }
-
-      // run odd indexed threads on core 3
-      else
-      {
-          CPU_ZERO(&threadcpu);
-          cpuidx=(3);
-          CPU_SET(cpuidx, &threadcpu);
-      }
+    for(i=0; i < NUM_THREADS; i++)
+    {
+      CPU_ZERO(&threadcpu);
+      cpuidx=services[i].core;
+      CPU_SET(cpuidx, &threadcpu);
 
       rc=pthread_attr_init(&rt_sched_attr[i]);
       rc=pthread_attr_setinheritsched(&rt_sched_attr[i], PTHREAD_EXPLICIT_SCHED);
       rc=pthread_attr_setschedpolicy(&rt_sched_attr[i], SCHED_FIFO);
       rc=pthread_attr_setaffinity_np(&rt_sched_attr[i], sizeof(cpu_set_t), &threadcpu);
 
-      rt_param[i].sched_priority=rt_max_prio-i;
+      rt_param[i].sched_priority=rt_max_prio-1-services[i].rank;
       pthread_attr_setschedparam(&rt_sched_attr[i], &rt_param[i]);
 
       threadParams[i].threadIdx=i;
     }
    
-    printf("Service threads will run on %d CPU cores\n", CPU_COUNT(&threadcpu));
+    printf("Service threads will run on %d CPU cores\n", usedcores);
 
     // Create Service threads which will block awaiting release for:
     //
 
-    // Servcie_1 = RT_MAX-1	@ 50 Hz
+    // Servcie_1 @ 50 Hz
     //
-    rt_param[0].sched_priority=rt_max_prio-1;
-    pthread_attr_setschedparam(&rt_sched_attr[0], &rt_param[0]);
     rc=pthread_create(&threads[0],               // pointer to thread descriptor
                       &rt_sched_attr[0],         // use specific attributes
                       //(void *)0,               // default attributes
@@ -339,10 +374,8 @@ void main(void)
         printf("pthread_create successful for service 1\n");
 
 
-    // Service_2 = RT_MAX-2	@ 20 Hz
+    // Service_2 @ 20 Hz
     //
-    rt_param[1].sched_priority=rt_max_prio-2;
-    pthread_attr_setschedparam(&rt_sched_attr[1], &rt_param[1]);
     rc=pthread_create(&threads[1], &rt_sched_attr[1], Service_2, (void *)&(threadParams[1]));
     if(rc < 0)
         perror("pthread_create for service 2");
@@ -350,10 +383,8 @@ void main(void)
         printf("pthread_create successful for service 2\n");
 
 
-    // Service_3 = RT_MAX-3	@ 10 Hz
+    // Service_3 @ 10 Hz
     //
-    rt_param[2].sched_priority=rt_max_prio-3;
-    pthread_attr_setschedparam(&rt_sched_attr[2], &rt_param[2]);
     rc=pthread_create(&threads[2], &rt_sched_attr[2], Service_3, (void *)&(threadParams[2]));
     if(rc < 0)
         perror("pthread_create for service 3");
@@ -361,10 +392,8 @@ void main(void)
         printf("pthread_create successful for service 3\n");
 
 
-    // Service_4 = RT_MAX-4	@ 5 Hz
+    // Service_4 @ 5 Hz
     //
-    rt_param[3].sched_priority=rt_max_prio-4;
-    pthread_attr_setschedparam(&rt_sched_attr[3], &rt_param[3]);
     rc=pthread_create(&threads[3], &rt_sched_attr[3], Service_4, (void *)&(threadParams[3]));
     if(rc < 0)
         perror("pthread_create for service 4");
@@ -372,10 +401,8 @@ void main(void)
         printf("pthread_create successful for service 4\n");
 
 
-    // Service_5 = RT_MAX-5	@ 2 Hz
+    // Service_5 @ 2 Hz
     //
-    rt_param[4].sched_priority=rt_max_prio-5;
-    pthread_attr_setschedparam(&rt_sched_attr[4], &rt_param[4]);
     rc=pthread_create(&threads[4], &rt_sched_attr[4], Service_5, (void *)&(threadParams[4]));
     if(rc < 0)
         perror("pthread_create for service 5");
@@ -383,10 +410,8 @@ void main(void)
         printf("pthread_create successful for service 5\n");
 
 
-    // Service_6 = RT_MAX-6	@ 1 Hz
+    // Service_6 @ 1 Hz
     //
-    rt_param[5].sched_priority=rt_max_prio-6;
-    pthread_attr_setschedparam(&rt_sched_attr[5], &rt_param[5]);
     rc=pthread_create(&threads[5], &rt_sched_attr[5], Service_6, (void *)&(threadParams[5]));
     if(rc < 0)
         perror("pthread_create for service 6");
@@ -394,10 +419,8 @@ void main(void)
         printf("pthread_create successful for service 6\n");
 
 
-    // Service_7 = RT_MIN	@ 1 Hz
+    // Service_7 @ 1 Hz
     //
-    rt_param[6].sched_priority=rt_min_prio;
-    pthread_attr_setschedparam(&rt_sched_attr[6], &rt_param[6]);
     rc=pthread_create(&threads[6], &rt_sched_attr[6], Service_7, (void *)&(threadParams[6]));
     if(rc < 0)
         perror("pthread_create for service 7");
@@ -427,9 +450,9 @@ void main(void)
 
     /* arm the interval timer */
     itime.it_interval.tv_sec = 0;
-    itime.it_interval.tv_nsec = 10000000;
+    itime.it_interval.tv_nsec = SEQ_PERIOD_USEC*1000;
     itime.it_value.tv_sec = 0;
-    itime.it_value.tv_nsec = 10000000;
+    itime.it_value.tv_nsec = SEQ_PERIOD_USEC*1000;
     //itime.it_interval.tv_sec = 1;
     //itime.it_interval.tv_nsec = 0;
     //itime.it_value.tv_sec = 1;
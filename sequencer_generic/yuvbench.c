@@ -0,0 +1,132 @@
+// YUYV frame conversion microbenchmark
+//
+// Times each YUYV converter implementation this CPU supports on frames from
+// 320x240 to 1920x1080, and checks each gives the same bytes as the scalar
+// reference.  The frames are random, so every clipping case is covered.
+//
+// usage: yuvbench [frames]
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "yuvconvert.h"
+
+#define DEFAULT_FRAMES (100)
+
+static const int resolutions[][2] =
+{
+    { 320,  240},
+    { 640,  480},
+    { 800,  600},
+    {1280,  720},
+    {1920, 1080}
+};
+
+#define NUM_RESOLUTIONS (sizeof(resolutions)/sizeof(resolutions[0]))
+
+
+static double now_sec(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1000000000.0;
+}
+
+
+// Same output as the reference for n pixels
+//
+static int same_output(yuv_convert_t convert, yuv_convert_t reference, unsigned char *yuyv,
+                       unsigned char *out, unsigned char *ref, int n, int bytes_per_pixel)
+{
+    reference(yuyv, ref, n);
+    memset(out, 0, n*bytes_per_pixel);
+    convert(yuyv, out, n);
+
+    return (memcmp(out, ref, n*bytes_per_pixel) == 0);
+}
+
+
+int main(int argc, char **argv)
+{
+    static const char *conv_names[3] = {"rgb24", "gray", "planar"};
+    static const int out_size[3] = {3, 1, 3};
+    yuv_convert_t convert, reference;
+    unsigned char *yuyv, *out, *ref;
+    double start, msec, scalar_msec[3];
+    int frames=DEFAULT_FRAMES, res, conv, impl, f, pixels, same;
+
+    if(argc > 1)
+        frames=atoi(argv[1]);
+
+    if(frames < 1)
+    {
+        printf("usage: yuvbench [frames]\n");
+        exit(-1);
+    }
+
+    pixels=resolutions[NUM_RESOLUTIONS-1][0] * resolutions[NUM_RESOLUTIONS-1][1];
+    yuyv=malloc(pixels*2);
+    out=malloc(pixels*3);
+    ref=malloc(pixels*3);
+
+    if(!yuyv || !out || !ref)
+    {
+        perror("malloc");
+        exit(-1);
+    }
+
+    srand(1);
+    for(f=0; f < pixels*2; f++)
+        yuyv[f]=rand() & 0xff;
+
+    printf("auto selects %s, %d frames each\n", yuv_impl_name(yuv_convert_select(YUV_IMPL_AUTO)), frames);
+    printf("resolution  convert  impl     msec/frame   Mpixel/s  speedup  output\n");
+
+    for(res=0; res < NUM_RESOLUTIONS; res++)
+    {
+        pixels=resolutions[res][0] * resolutions[res][1];
+
+        for(conv=0; conv < 3; conv++)
+        {
+            for(impl=0; impl < YUV_IMPL_COUNT; impl++)
+            {
+                if(!yuv_impl_supported(impl))
+                    continue;
+
+                if(conv == 0) convert=yuv_impl_rgb24(impl), reference=yuv_impl_rgb24(YUV_IMPL_SCALAR);
+                else if(conv == 1) convert=yuv_impl_gray(impl), reference=yuv_impl_gray(YUV_IMPL_SCALAR);
+                else convert=yuv_impl_rgb_planar(impl), reference=yuv_impl_rgb_planar(YUV_IMPL_SCALAR);
+
+                // and a width that leaves a partial block
+                same=same_output(convert, reference, yuyv, out, ref, pixels, out_size[conv]) &&
+                     same_output(convert, reference, yuyv, out, ref, pixels-2, out_size[conv]);
+
+                start=now_sec();
+                for(f=0; f < frames; f++)
+                    convert(yuyv, out, pixels);
+                msec=(now_sec() - start) * 1000.0 / frames;
+
+                if(impl == YUV_IMPL_SCALAR)
+                    scalar_msec[conv]=msec;
+
+                printf("%4dx%-4d   %-7s  %-7s %10.3lf %10.1lf %8.2lf  %s\n",
+                       resolutions[res][0], resolutions[res][1], conv_names[conv], yuv_impl_name(impl),
+                       msec, (double)pixels / (msec * 1000.0), scalar_msec[conv] / msec,
+                       same ? "same" : "DIFFERENT");
+
+                if(!same)
+                    exit(-1);
+            }
+        }
+    }
+
+    free(yuyv);
+    free(out);
+    free(ref);
+
+    return 0;
+}
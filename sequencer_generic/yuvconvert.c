@@ -0,0 +1,520 @@
+// YUYV to RGB24, GRAY and planar RGB frame converters
+//
+// process_image() converts a frame one 4 byte YUYV macropixel at a time,
+// calling yuv2rgb() twice with branches to clip each of R, G and B.  At
+// 1920x1080 that is 2 million calls a frame.  The same integer conversion,
+//
+//     C = Y - 16, D = U - 128, E = V - 128
+//     R = clip((298*C           + 409*E + 128) >> 8)
+//     G = clip((298*C - 100*D - 208*E + 128) >> 8)
+//     B = clip((298*C + 516*D           + 128) >> 8)
+//
+// is done here a block of pixels at a time:
+//
+// 1) BLOCK is portable C over 32 pixel blocks with fixed trip count inner
+//    loops, restrict pointers and min/max clipping, which GCC vectorizes at
+//    -O3 on any SIMD unit (NEON on the Raspberry Pi and Jetson, SSE on x86).
+//    GRAY is only a copy, and vectorizes as it is.
+// 2) SSE2 does 16 pixels per loop.  Y, U and V are widened to 16 bits, and
+//    pmaddwd forms the sums in 32 bits from (C, 0) and (D, E) pairs, so the
+//    results are exact - 298*C alone does not fit in 16 bits.  The saturating
+//    packs back to 16 and then 8 bits clip to 0-255 for free.
+// 3) AVX2 does the same 32 pixels per loop, and interleaves RGB24 with byte
+//    shuffles, where SSE2 has none and writes each pixel from the planes.
+//
+// Every implementation gives the same bytes as the scalar reference.
+//
+
+#include <stdio.h>
+#include <string.h>
+
+#include "yuvconvert.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define YUV_X86
+#include <immintrin.h>
+#endif
+
+#define YUV_BLOCK (32)
+
+
+static inline unsigned char clip(int x)
+{
+    x = (x < 0) ? 0 : x;
+    return (x > 255) ? 255 : x;
+}
+
+
+// Scalar reference, as yuv2rgb() in capturelib.c
+//
+static inline void yuv_pixel(int y, int u, int v, unsigned char *r, unsigned char *g, unsigned char *b)
+{
+    int c = y-16, d = u - 128, e = v - 128;
+
+    *r = clip((298 * c           + 409 * e + 128) >> 8);
+    *g = clip((298 * c - 100 * d - 208 * e + 128) >> 8);
+    *b = clip((298 * c + 516 * d           + 128) >> 8);
+}
+
+
+static void scalar_rgb24(const unsigned char *yuyv, unsigned char *out, int pixels)
+{
+    int i;
+
+    for(i=0; i < pixels*2; i+=4, out+=6)
+    {
+        yuv_pixel(yuyv[i],   yuyv[i+1], yuyv[i+3], &out[0], &out[1], &out[2]);
+        yuv_pixel(yuyv[i+2], yuyv[i+1], yuyv[i+3], &out[3], &out[4], &out[5]);
+    }
+}
+
+
+static void scalar_gray(const unsigned char *yuyv, unsigned char *out, int pixels)
+{
+    int i;
+
+    for(i=0; i < pixels; i++)
+        out[i]=yuyv[i*2];
+}
+
+
+static void scalar_rgb_planar(const unsigned char *yuyv, unsigned char *out, int pixels)
+{
+    unsigned char *r=out, *g=out+pixels, *b=out+2*pixels;
+    int i;
+
+    for(i=0; i < pixels; i+=2, yuyv+=4)
+    {
+        yuv_pixel(yuyv[0], yuyv[1], yuyv[3], &r[i],   &g[i],   &b[i]);
+        yuv_pixel(yuyv[2], yuyv[1], yuyv[3], &r[i+1], &g[i+1], &b[i+1]);
+    }
+}
+
+
+// One block of YUV_BLOCK pixels to planes r, g and b - each macropixel in
+// turn, so the loads are a 4 way de-interleave (e.g. NEON vld4) and the
+// stores 2 way
+//
+static inline void block_planes(const unsigned char * __restrict yuyv, unsigned char * __restrict r,
+                                unsigned char * __restrict g, unsigned char * __restrict b)
+{
+    int m, c0, c1, d, e, rv, gv, bv;
+
+    for(m=0; m < YUV_BLOCK/2; m++)
+    {
+        c0 = 298 * (yuyv[m*4] - 16) + 128;
+        c1 = 298 * (yuyv[m*4+2] - 16) + 128;
+        d = yuyv[m*4+1] - 128;
+        e = yuyv[m*4+3] - 128;
+
+        rv = 409 * e;
+        gv = -100 * d - 208 * e;
+        bv = 516 * d;
+
+        r[m*2] = clip((c0 + rv) >> 8); r[m*2+1] = clip((c1 + rv) >> 8);
+        g[m*2] = clip((c0 + gv) >> 8); g[m*2+1] = clip((c1 + gv) >> 8);
+        b[m*2] = clip((c0 + bv) >> 8); b[m*2+1] = clip((c1 + bv) >> 8);
+    }
+}
+
+
+static void block_rgb24(const unsigned char *yuyv, unsigned char *out, int pixels)
+{
+    unsigned char r[YUV_BLOCK], g[YUV_BLOCK], b[YUV_BLOCK];
+    int i, k;
+
+    for(i=0; i+YUV_BLOCK <= pixels; i+=YUV_BLOCK, yuyv+=YUV_BLOCK*2, out+=YUV_BLOCK*3)
+    {
+        block_planes(yuyv, r, g, b);
+
+        for(k=0; k < YUV_BLOCK; k++)
+        {
+            out[k*3]   = r[k];
+            out[k*3+1] = g[k];
+            out[k*3+2] = b[k];
+        }
+    }
+
+    scalar_rgb24(yuyv, out, pixels-i);
+}
+
+
+static void block_rgb_planar(const unsigned char *yuyv, unsigned char *out, int pixels)
+{
+    int i;
+
+    for(i=0; i+YUV_BLOCK <= pixels; i+=YUV_BLOCK)
+        block_planes(yuyv+i*2, out+i, out+pixels+i, out+2*pixels+i);
+
+    for(; i < pixels; i+=2)
+    {
+        yuv_pixel(yuyv[i*2],   yuyv[i*2+1], yuyv[i*2+3], &out[i],   &out[pixels+i],   &out[2*pixels+i]);
+        yuv_pixel(yuyv[i*2+2], yuyv[i*2+1], yuyv[i*2+3], &out[i+1], &out[pixels+i+1], &out[2*pixels+i+1]);
+    }
+}
+
+
+#ifdef YUV_X86
+
+#pragma GCC push_options
+#pragma GCC target("sse2")
+
+// R, G and B of 4 pixels, as 32 bit, from their YUYV widened to 16 bits
+//
+static inline void sse2_rgb4(__m128i yuyv16, __m128i *r, __m128i *g, __m128i *b)
+{
+    // (Y - 16, U - 128) and (Y - 16, V - 128) pairs
+    __m128i s = _mm_sub_epi16(yuyv16, _mm_setr_epi16(16, 128, 16, 128, 16, 128, 16, 128));
+
+    // 298*C + 128 from (C, U or V) with (298, 0), and (D, E) for each pixel
+    __m128i y = _mm_add_epi32(_mm_madd_epi16(s, _mm_setr_epi16(298, 0, 298, 0, 298, 0, 298, 0)), _mm_set1_epi32(128));
+    __m128i de = _mm_shufflehi_epi16(_mm_shufflelo_epi16(s, _MM_SHUFFLE(3,1,3,1)), _MM_SHUFFLE(3,1,3,1));
+
+    *r = _mm_srai_epi32(_mm_add_epi32(y, _mm_madd_epi16(de, _mm_setr_epi16(0, 409, 0, 409, 0, 409, 0, 409))), 8);
+    *g = _mm_srai_epi32(_mm_add_epi32(y, _mm_madd_epi16(de, _mm_setr_epi16(-100, -208, -100, -208, -100, -208, -100, -208))), 8);
+    *b = _mm_srai_epi32(_mm_add_epi32(y, _mm_madd_epi16(de, _mm_setr_epi16(516, 0, 516, 0, 516, 0, 516, 0))), 8);
+}
+
+
+// R, G and B of 8 pixels, 16 bytes of YUYV, as 16 bit
+//
+static inline void sse2_rgb8(__m128i v, __m128i *r, __m128i *g, __m128i *b)
+{
+    __m128i zero = _mm_setzero_si128(), rlo, glo, blo, rhi, ghi, bhi;
+
+    sse2_rgb4(_mm_unpacklo_epi8(v, zero), &rlo, &glo, &blo);
+    sse2_rgb4(_mm_unpackhi_epi8(v, zero), &rhi, &ghi, &bhi);
+
+    *r = _mm_packs_epi32(rlo, rhi);
+    *g = _mm_packs_epi32(glo, ghi);
+    *b = _mm_packs_epi32(blo, bhi);
+}
+
+
+// R, G and B bytes of 16 pixels, clipped by the unsigned saturating pack
+//
+static inline void sse2_rgb16(const unsigned char *yuyv, __m128i *r, __m128i *g, __m128i *b)
+{
+    __m128i r0, g0, b0, r1, g1, b1;
+
+    sse2_rgb8(_mm_loadu_si128((const __m128i *)yuyv), &r0, &g0, &b0);
+    sse2_rgb8(_mm_loadu_si128((const __m128i *)(yuyv+16)), &r1, &g1, &b1);
+
+    *r = _mm_packus_epi16(r0, r1);
+    *g = _mm_packus_epi16(g0, g1);
+    *b = _mm_packus_epi16(b0, b1);
+}
+
+
+static void sse2_rgb24(const unsigned char *yuyv, unsigned char *out, int pixels)
+{
+    unsigned char r[16], g[16], b[16];
+    __m128i rv, gv, bv;
+    int i, k;
+
+    for(i=0; i+16 <= pixels; i+=16, yuyv+=32, out+=48)
+    {
+        sse2_rgb16(yuyv, &rv, &gv, &bv);
+        _mm_storeu_si128((__m128i *)r, rv);
+        _mm_storeu_si128((__m128i *)g, gv);
+        _mm_storeu_si128((__m128i *)b, bv);
+
+        for(k=0; k < 16; k++)
+        {
+            out[k*3]   = r[k];
+            out[k*3+1] = g[k];
+            out[k*3+2] = b[k];
+        }
+    }
+
+    scalar_rgb24(yuyv, out, pixels-i);
+}
+
+
+static void sse2_gray(const unsigned char *yuyv, unsigned char *out, int pixels)
+{
+    __m128i ymask = _mm_set1_epi16(0x00ff), v0, v1;
+    int i;
+
+    for(i=0; i+16 <= pixels; i+=16)
+    {
+        v0 = _mm_and_si128(_mm_loadu_si128((const __m128i *)(yuyv+i*2)), ymask);
+        v1 = _mm_and_si128(_mm_loadu_si128((const __m128i *)(yuyv+i*2+16)), ymask);
+        _mm_storeu_si128((__m128i *)(out+i), _mm_packus_epi16(v0, v1));
+    }
+
+    scalar_gray(yuyv+i*2, out+i, pixels-i);
+}
+
+
+static void sse2_rgb_planar(const unsigned char *yuyv, unsigned char *out, int pixels)
+{
+    __m128i rv, gv, bv;
+    int i;
+
+    for(i=0; i+16 <= pixels; i+=16)
+    {
+        sse2_rgb16(yuyv+i*2, &rv, &gv, &bv);
+        _mm_storeu_si128((__m128i *)(out+i), rv);
+        _mm_storeu_si128((__m128i *)(out+pixels+i), gv);
+        _mm_storeu_si128((__m128i *)(out+2*pixels+i), bv);
+    }
+
+    for(; i < pixels; i+=2)
+    {
+        yuv_pixel(yuyv[i*2],   yuyv[i*2+1], yuyv[i*2+3], &out[i],   &out[pixels+i],   &out[2*pixels+i]);
+        yuv_pixel(yuyv[i*2+2], yuyv[i*2+1], yuyv[i*2+3], &out[i+1], &out[pixels+i+1], &out[2*pixels+i+1]);
+    }
+}
+
+#pragma GCC pop_options
+
+
+#pragma GCC push_options
+#pragma GCC target("avx2")
+
+// pshufb masks that interleave 16 R, G and B bytes into 48 bytes of RGB24,
+// output byte k is channel k%3 of pixel k/3, -1 gives a zero byte
+//
+static const signed char shuf_r[3][16] =
+{
+    { 0, -1, -1,  1, -1, -1,  2, -1, -1,  3, -1, -1,  4, -1, -1,  5},
+    {-1, -1,  6, -1, -1,  7, -1, -1,  8, -1, -1,  9, -1, -1, 10, -1},
+    {-1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15, -1, -1}
+};
+
+static const signed char shuf_g[3][16] =
+{
+    {-1,  0, -1, -1,  1, -1, -1,  2, -1, -1,  3, -1, -1,  4, -1, -1},
+    { 5, -1, -1,  6, -1, -1,  7, -1, -1,  8, -1, -1,  9, -1, -1, 10},
+    {-1, -1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15, -1}
+};
+
+static const signed char shuf_b[3][16] =
+{
+    {-1, -1,  0, -1, -1,  1, -1, -1,  2, -1, -1,  3, -1, -1,  4, -1},
+    {-1,  5, -1, -1,  6, -1, -1,  7, -1, -1,  8, -1, -1,  9, -1, -1},
+    {10, -1, -1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15}
+};
+
+
+// as sse2_rgb4(), the coefficients as (low, high) 16 bit pairs in each 32 bits
+//
+static inline void avx2_rgb4(__m256i yuyv16, __m256i *r, __m256i *g, __m256i *b)
+{
+    __m256i s = _mm256_sub_epi16(yuyv16, _mm256_set1_epi32(0x00800010));
+    __m256i y = _mm256_add_epi32(_mm256_madd_epi16(s, _mm256_set1_epi32(298)), _mm256_set1_epi32(128));
+    __m256i de = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(s, _MM_SHUFFLE(3,1,3,1)), _MM_SHUFFLE(3,1,3,1));
+
+    *r = _mm256_srai_epi32(_mm256_add_epi32(y, _mm256_madd_epi16(de, _mm256_set1_epi32(409 << 16))), 8);
+    *g = _mm256_srai_epi32(_mm256_add_epi32(y, _mm256_madd_epi16(de, _mm256_set1_epi32((int)0xff30ff9c))), 8);
+    *b = _mm256_srai_epi32(_mm256_add_epi32(y, _mm256_madd_epi16(de, _mm256_set1_epi32(516))), 8);
+}
+
+
+// 16 pixels, as 16 bit, in order - each 128 bit lane widens, converts and
+// packs its own 8 pixels
+//
+static inline void avx2_rgb16(__m256i v, __m256i *r, __m256i *g, __m256i *b)
+{
+    __m256i zero = _mm256_setzero_si256(), rlo, glo, blo, rhi, ghi, bhi;
+
+    avx2_rgb4(_mm256_unpacklo_epi8(v, zero), &rlo, &glo, &blo);
+    avx2_rgb4(_mm256_unpackhi_epi8(v, zero), &rhi, &ghi, &bhi);
+
+    *r = _mm256_packs_epi32(rlo, rhi);
+    *g = _mm256_packs_epi32(glo, ghi);
+    *b = _mm256_packs_epi32(blo, bhi);
+}
+
+
+// 32 pixels as bytes, the lane-wise pack leaves the 8 pixel groups in the
+// order 0, 2, 1, 3
+//
+static inline void avx2_rgb32(const unsigned char *yuyv, __m256i *r, __m256i *g, __m256i *b)
+{
+    __m256i r0, g0, b0, r1, g1, b1;
+
+    avx2_rgb16(_mm256_loadu_si256((const __m256i *)yuyv), &r0, &g0, &b0);
+    avx2_rgb16(_mm256_loadu_si256((const __m256i *)(yuyv+32)), &r1, &g1, &b1);
+
+    *r = _mm256_permute4x64_epi64(_mm256_packus_epi16(r0, r1), _MM_SHUFFLE(3,1,2,0));
+    *g = _mm256_permute4x64_epi64(_mm256_packus_epi16(g0, g1), _MM_SHUFFLE(3,1,2,0));
+    *b = _mm256_permute4x64_epi64(_mm256_packus_epi16(b0, b1), _MM_SHUFFLE(3,1,2,0));
+}
+
+
+static inline void interleave16(__m128i r, __m128i g, __m128i b, unsigned char *out)
+{
+    int j;
+
+    for(j=0; j < 3; j++)
+        _mm_storeu_si128((__m128i *)(out+j*16),
+                         _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(r, _mm_loadu_si128((const __m128i *)shuf_r[j])),
+                                                   _mm_shuffle_epi8(g, _mm_loadu_si128((const __m128i *)shuf_g[j]))),
+                                      _mm_shuffle_epi8(b, _mm_loadu_si128((const __m128i *)shuf_b[j]))));
+}
+
+
+static void avx2_rgb24(const unsigned char *yuyv, unsigned char *out, int pixels)
+{
+    __m256i rv, gv, bv;
+    int i;
+
+    for(i=0; i+32 <= pixels; i+=32, yuyv+=64, out+=96)
+    {
+        avx2_rgb32(yuyv, &rv, &gv, &bv);
+        interleave16(_mm256_castsi256_si128(rv), _mm256_castsi256_si128(gv), _mm256_castsi256_si128(bv), out);
+        interleave16(_mm256_extracti128_si256(rv, 1), _mm256_extracti128_si256(gv, 1),
+                     _mm256_extracti128_si256(bv, 1), out+48);
+    }
+
+    scalar_rgb24(yuyv, out, pixels-i);
+}
+
+
+static void avx2_gray(const unsigned char *yuyv, unsigned char *out, int pixels)
+{
+    __m256i ymask = _mm256_set1_epi16(0x00ff), v0, v1;
+    int i;
+
+    for(i=0; i+32 <= pixels; i+=32)
+    {
+        v0 = _mm256_and_si256(_mm256_loadu_si256((const __m256i *)(yuyv+i*2)), ymask);
+        v1 = _mm256_and_si256(_mm256_loadu_si256((const __m256i *)(yuyv+i*2+32)), ymask);
+        _mm256_storeu_si256((__m256i *)(out+i),
+                            _mm256_permute4x64_epi64(_mm256_packus_epi16(v0, v1), _MM_SHUFFLE(3,1,2,0)));
+    }
+
+    scalar_gray(yuyv+i*2, out+i, pixels-i);
+}
+
+
+static void avx2_rgb_planar(const unsigned char *yuyv, unsigned char *out, int pixels)
+{
+    __m256i rv, gv, bv;
+    int i;
+
+    for(i=0; i+32 <= pixels; i+=32)
+    {
+        avx2_rgb32(yuyv+i*2, &rv, &gv, &bv);
+        _mm256_storeu_si256((__m256i *)(out+i), rv);
+        _mm256_storeu_si256((__m256i *)(out+pixels+i), gv);
+        _mm256_storeu_si256((__m256i *)(out+2*pixels+i), bv);
+    }
+
+    for(; i < pixels; i+=2)
+    {
+        yuv_pixel(yuyv[i*2],   yuyv[i*2+1], yuyv[i*2+3], &out[i],   &out[pixels+i],   &out[2*pixels+i]);
+        yuv_pixel(yuyv[i*2+2], yuyv[i*2+1], yuyv[i*2+3], &out[i+1], &out[pixels+i+1], &out[2*pixels+i+1]);
+    }
+}
+
+#pragma GCC pop_options
+
+#endif
+
+
+typedef struct
+{
+    const char *name;
+    yuv_convert_t rgb24;
+    yuv_convert_t gray;
+    yuv_convert_t rgb_planar;
+} yuvImpl_t;
+
+static const yuvImpl_t impls[YUV_IMPL_COUNT] =
+{
+    {"scalar", scalar_rgb24, scalar_gray, scalar_rgb_planar},
+    {"block",  block_rgb24,  scalar_gray, block_rgb_planar},
+#ifdef YUV_X86
+    {"sse2",   sse2_rgb24,   sse2_gray,   sse2_rgb_planar},
+    {"avx2",   avx2_rgb24,   avx2_gray,   avx2_rgb_planar}
+#else
+    {"sse2",   NULL,         NULL,        NULL},
+    {"avx2",   NULL,         NULL,        NULL}
+#endif
+};
+
+yuv_convert_t yuyv_to_rgb24 = scalar_rgb24;
+yuv_convert_t yuyv_to_gray = scalar_gray;
+yuv_convert_t yuyv_to_rgb_planar = scalar_rgb_planar;
+
+
+int yuv_impl_supported(int impl)
+{
+    if((impl < 0) || (impl >= YUV_IMPL_COUNT) || (impls[impl].rgb24 == NULL))
+        return 0;
+
+#ifdef YUV_X86
+    if(impl == YUV_IMPL_SSE2)
+        return __builtin_cpu_supports("sse2");
+
+    if(impl == YUV_IMPL_AVX2)
+        return __builtin_cpu_supports("avx2");
+#endif
+
+    return 1;
+}
+
+
+const char *yuv_impl_name(int impl)
+{
+    if((impl < 0) || (impl >= YUV_IMPL_COUNT))
+        return "unknown";
+
+    return impls[impl].name;
+}
+
+
+yuv_convert_t yuv_impl_rgb24(int impl)
+{
+    return yuv_impl_supported(impl) ? impls[impl].rgb24 : NULL;
+}
+
+
+yuv_convert_t yuv_impl_gray(int impl)
+{
+    return yuv_impl_supported(impl) ? impls[impl].gray : NULL;
+}
+
+
+yuv_convert_t yuv_impl_rgb_planar(int impl)
+{
+    return yuv_impl_supported(impl) ? impls[impl].rgb_planar : NULL;
+}
+
+
+int yuv_convert_select(int impl)
+{
+    if(impl == YUV_IMPL_AUTO)
+    {
+        for(impl=YUV_IMPL_COUNT-1; impl > YUV_IMPL_SCALAR; impl--)
+            if(yuv_impl_supported(impl))
+                break;
+    }
+
+    if(!yuv_impl_supported(impl))
+        return -1;
+
+    yuyv_to_rgb24 = impls[impl].rgb24;
+    yuyv_to_gray = impls[impl].gray;
+    yuyv_to_rgb_planar = impls[impl].rgb_planar;
+
+    return impl;
+}
+
+
+int yuv_convert_select_name(const char *name)
+{
+    int impl;
+
+    if((name == NULL) || (strcmp(name, "auto") == 0))
+        return yuv_convert_select(YUV_IMPL_AUTO);
+
+    for(impl=0; impl < YUV_IMPL_COUNT; impl++)
+        if(strcmp(name, impls[impl].name) == 0)
+            return yuv_convert_select(impl);
+
+    return -1;
+}
@@ -0,0 +1,41 @@
+#ifndef _YUVCONVERT_
+#define _YUVCONVERT_
+
+// YUYV (YUV 4:2:2) frame converters
+//
+// All take the number of pixels in the frame, which must be even, and give
+// the same bytes as yuv2rgb() in capturelib.c for every pixel whichever
+// implementation is selected.
+//
+// RGB24 is RGBRGB..., 3 bytes per pixel, GRAY is the Y samples only, and
+// planar RGB is all R, then all G, then all B, pixels bytes each.
+
+#define YUV_IMPL_AUTO   (-1)
+#define YUV_IMPL_SCALAR (0)     // yuv2rgb() per pixel, the reference
+#define YUV_IMPL_BLOCK  (1)     // portable 32 pixel blocks, auto-vectorized (e.g. NEON)
+#define YUV_IMPL_SSE2   (2)
+#define YUV_IMPL_AVX2   (3)
+#define YUV_IMPL_COUNT  (4)
+
+typedef void (*yuv_convert_t)(const unsigned char *yuyv, unsigned char *out, int pixels);
+
+// Current converters, set by yuv_convert_select()
+extern yuv_convert_t yuyv_to_rgb24;
+extern yuv_convert_t yuyv_to_gray;
+extern yuv_convert_t yuyv_to_rgb_planar;
+
+// Select by YUV_IMPL_* or name ("scalar", "block", "sse2", "avx2", "auto"),
+// NULL name for auto, which is the fastest one this CPU supports.  Returns
+// the implementation selected, or -1 if it is not supported here.
+int yuv_convert_select(int impl);
+int yuv_convert_select_name(const char *name);
+
+int yuv_impl_supported(int impl);
+const char *yuv_impl_name(int impl);
+
+// Converters of one implementation, NULL if not built for this CPU
+yuv_convert_t yuv_impl_rgb24(int impl);
+yuv_convert_t yuv_impl_gray(int impl);
+yuv_convert_t yuv_impl_rgb_planar(int impl);
+
+#endif
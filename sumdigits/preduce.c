@@ -0,0 +1,166 @@
+#include <pthread.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "preduce.h"
+
+
+typedef struct
+{
+    preduceSum_t partial;
+} __attribute__((aligned(PREDUCE_CACHE_LINE))) preducePartial_t;
+
+typedef struct
+{
+    // shared, read only once the workers start - except nextChunk
+    unsigned long long first;
+    unsigned long long last;
+    unsigned long long chunk;
+    preduceChunk_t chunkFunc;
+    preduceCombine_t combine;
+    preduceSum_t identity;
+    void *arg;
+
+    // claimed with an atomic add, on its own line so claims don't disturb
+    // the read only fields above
+    unsigned long long nextChunk __attribute__((aligned(PREDUCE_CACHE_LINE)));
+
+    preducePartial_t *partials;
+} preduceJob_t;
+
+typedef struct
+{
+    preduceJob_t *job;
+    int threadIdx;
+} preduceThread_t;
+
+
+static void *reduceThread(void *threadp)
+{
+    preduceThread_t *thread = (preduceThread_t *)threadp;
+    preduceJob_t *job = thread->job;
+    preduceSum_t partial = job->identity, result;
+    unsigned long long chunkIdx, start, end;
+    unsigned long long span = job->last - job->first;
+    unsigned long long numChunks = span / job->chunk + ((span % job->chunk) != 0);
+
+    while((chunkIdx = __atomic_fetch_add(&job->nextChunk, 1, __ATOMIC_RELAXED)) < numChunks)
+    {
+        // last may be close to 2^64, so never form start + chunk past it
+        start = job->first + chunkIdx*job->chunk;
+        end = (job->last - start > job->chunk) ? start + job->chunk : job->last;
+
+        result = (*job->chunkFunc)(start, end, job->arg);
+        partial = (job->combine == NULL) ? partial + result : (*job->combine)(partial, result);
+    }
+
+    // one write to this thread's line at the end, not one per chunk
+    job->partials[thread->threadIdx].partial = partial;
+
+    return NULL;
+}
+
+
+preduceSum_t parallelReduce(unsigned long long first, unsigned long long last,
+                            preduceChunk_t chunkFunc, preduceCombine_t combine,
+                            preduceSum_t identity, void *arg, preduceConfig_t *config)
+{
+    preduceJob_t job;
+    preduceThread_t *threadParams;
+    pthread_t *threads;
+    preduceSum_t result = identity;
+    int i, rc, started, nthreads = config->nthreads;
+
+    if(last <= first)
+        return identity;
+
+    if(nthreads < 1)
+        nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+    if(nthreads < 1)
+        nthreads = 1;
+
+    job.first = first;
+    job.last = last;
+    job.chunkFunc = chunkFunc;
+    job.combine = combine;
+    job.identity = identity;
+    job.arg = arg;
+    job.nextChunk = 0;
+
+    // about 64 chunks per thread, enough to even out uneven threads
+    job.chunk = config->chunk;
+    if(job.chunk == 0)
+    {
+        job.chunk = (last - first) / ((unsigned long long)nthreads * 64);
+        if(job.chunk < PREDUCE_MIN_CHUNK) job.chunk = PREDUCE_MIN_CHUNK;
+        if(job.chunk > PREDUCE_MAX_CHUNK) job.chunk = PREDUCE_MAX_CHUNK;
+    }
+
+    if(((threads = malloc(nthreads * sizeof(pthread_t))) == NULL) ||
+       ((threadParams = malloc(nthreads * sizeof(preduceThread_t))) == NULL))
+    {
+        perror("malloc");
+        exit(-1);
+    }
+
+    if(posix_memalign((void **)&job.partials, PREDUCE_CACHE_LINE, nthreads * sizeof(preducePartial_t)) != 0)
+    {
+        perror("posix_memalign");
+        exit(-1);
+    }
+
+    // workers claim chunks until none are left, so the threads that did start
+    // still cover the whole range
+    for(started=0; started<nthreads; started++)
+    {
+        threadParams[started].job = &job;
+        threadParams[started].threadIdx = started;
+
+        if((rc=pthread_create(&threads[started], (void *)0, reduceThread, (void *)&threadParams[started])) != 0)
+        {
+            fprintf(stderr, "parallelReduce: pthread_create: %s, running on %d of %d threads\n",
+                    strerror(rc), started, nthreads);
+            break;
+        }
+    }
+
+    for(i=0; i<started; i++)
+        pthread_join(threads[i], NULL);
+
+    // no thread at all, reduce on this one
+    if(started == 0)
+    {
+        reduceThread(&threadParams[0]);
+        started = 1;
+    }
+
+    for(i=0; i<started; i++)
+        result = (combine == NULL) ? result + job.partials[i].partial : (*combine)(result, job.partials[i].partial);
+
+    free(job.partials);
+    free(threadParams);
+    free(threads);
+
+    return result;
+}
+
+
+char *preduceSumString(preduceSum_t value, char *buffer)
+{
+    char digits[40];
+    int idx=0, out=0;
+
+    do
+    {
+        digits[idx++] = '0' + (int)(value % 10);
+        value /= 10;
+    } while(value > 0);
+
+    while(idx > 0)
+        buffer[out++] = digits[--idx];
+    buffer[out] = '\0';
+
+    return buffer;
+}
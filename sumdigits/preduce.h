@@ -0,0 +1,42 @@
+#ifndef PREDUCE_H
+#define PREDUCE_H
+
+// Parallel reduction over an index range
+//
+// parallelReduce() splits [first, last) into chunks that worker threads claim
+// one at a time from a shared atomic counter, so a fast thread simply takes
+// more chunks than a slow one.  Each chunk is reduced by the caller's chunk
+// function, usually into a plain 64 bit accumulator, and each worker folds
+// its chunk results into its own 128 bit partial.  The partials sit in
+// separate cache lines so workers never write to a line another worker is
+// using, and they are combined once all the workers have been joined.
+//
+
+#define PREDUCE_CACHE_LINE (64)
+
+// chunk size limits when chosen automatically
+#define PREDUCE_MIN_CHUNK (4096ULL)
+#define PREDUCE_MAX_CHUNK (1ULL << 20)
+
+typedef unsigned __int128 preduceSum_t;
+
+// reduce indices [first, last) to one partial result
+typedef preduceSum_t (*preduceChunk_t)(unsigned long long first, unsigned long long last, void *arg);
+
+// combine two partial results, NULL for addition
+typedef preduceSum_t (*preduceCombine_t)(preduceSum_t a, preduceSum_t b);
+
+typedef struct
+{
+    int nthreads;               // 0 for one per online CPU
+    unsigned long long chunk;   // indices per claim, 0 to choose from the range
+} preduceConfig_t;
+
+preduceSum_t parallelReduce(unsigned long long first, unsigned long long last,
+                            preduceChunk_t chunkFunc, preduceCombine_t combine,
+                            preduceSum_t identity, void *arg, preduceConfig_t *config);
+
+// decimal string for a 128 bit value, buffer of at least 40 bytes
+char *preduceSumString(preduceSum_t value, char *buffer);
+
+#endif
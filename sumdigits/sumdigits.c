@@ -1,13 +1,19 @@
 #include <pthread.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "preduce.h"
 
 #define COUNT  (1000)
 
-// Note that this is hardcoded to work for just 2 threads below
-// Be very carefult about assuming you can just bump this up to make
-// everythign work for a larger scale (number of workers).
-#define NUM_THREADS (10)
+// Default number of workers, 0 for one per online CPU - set on the command
+// line with sumdigits [n] [threads] [chunk]
+#define NUM_THREADS (0)
 
 // Note that often the "digit sum" rather than "sum of the digits" is defined as the sum of the digit in each 10's place, but
 // that's not what we want to model here.  E.g., Wikipedia - https://en.wikipedia.org/wiki/Digit_sum
@@ -31,71 +37,129 @@
 // It should techically be called a sum of a series of numbers in an arithmetic progression.
 //
 
-typedef struct
+// With parallelReduce() (preduce.c) the range is no longer cut into one
+// fixed sub-range per thread.  Workers claim chunks of the range dynamically,
+// each chunk is summed in a 64 bit accumulator (or 128 bit when the chunk
+// could overflow 64 bits), and per-thread 128 bit partials in their own cache
+// lines are added up after the join, so sum(0...10^12) ~ 5x10^23 is exact.
+//
+
+// Sum of the integers in [first, last)
+//
+preduceSum_t sumRange(unsigned long long first, unsigned long long last, void *arg)
 {
-    int threadIdx;
-    int start;
-    int end;
-} threadParams_t;
+    unsigned long long i, sum64=0;
+    preduceSum_t sum128=0;
+
+    // 64 bits are enough when (last-first) values all below last can't overflow
+    if((last - first) <= (UINT64_MAX / last))
+    {
+        for(i=first; i<last; i++)
+            sum64 += i;
+
+        return sum64;
+    }
 
+    for(i=first; i<last; i++)
+        sum128 += i;
 
-// POSIX thread declarations and scheduling attributes
-pthread_t threads[NUM_THREADS];
-threadParams_t threadParams[NUM_THREADS];
+    return sum128;
+}
 
-// Thread specific globals
-int gsum[NUM_THREADS];
 
-void *sumThread(void *threadp)
+double elapsedSecs(struct timespec *start, struct timespec *stop)
 {
-    int i, idx, start, end;
-    threadParams_t *threadParams = (threadParams_t *)threadp;
+    return (double)(stop->tv_sec - start->tv_sec) + (double)(stop->tv_nsec - start->tv_nsec)/1000000000.0;
+}
 
-    start = threadParams->start;
-    end = threadParams->end;
-    idx = threadParams->threadIdx;
 
-    printf("Thread %d summing range %d to %d\n", idx, start, end);
+// Sum 0...n on 1, 2, 4 ... maxThreads workers and print the speed up
+//
+void benchmark(unsigned long long n, int maxThreads)
+{
+    preduceConfig_t config;
+    struct timespec start, stop;
+    preduceSum_t gsumall, expected=((preduceSum_t)n*(n+1))/2;
+    double secs, baseSecs=0.0;
+    char sumString[40];
+    int nthreads;
+
+    printf("threads      secs  speedup  efficiency  sum(0...%llu)\n", n);
 
-    for(i=start; i<=end; i++)
+    for(nthreads=1; ; nthreads*=2)
     {
-        gsum[idx] = gsum[idx] + i;
-        printf("thread idx=%d, gsum=%d\n", idx, gsum[idx]);
+        if(nthreads > maxThreads) nthreads=maxThreads;
+
+        config.nthreads=nthreads;
+        config.chunk=0;
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        gsumall=parallelReduce(0, n+1, sumRange, NULL, 0, NULL, &config);
+        clock_gettime(CLOCK_MONOTONIC, &stop);
+
+        secs=elapsedSecs(&start, &stop);
+        if(nthreads == 1) baseSecs=secs;
+
+        printf("%7d %9.4lf %8.2lf %10.1lf%%  %s%s\n", nthreads, secs, baseSecs/secs,
+               100.0*(baseSecs/secs)/nthreads, preduceSumString(gsumall, sumString),
+               (gsumall == expected) ? "" : " WRONG");
+
+        if(nthreads == maxThreads) break;
     }
 }
 
+
 int main (int argc, char *argv[])
 {
-   int range=COUNT/NUM_THREADS, gsumall=0; int i=0;
-
-   // initialize gsum array to zero
-   for(i=0; i<NUM_THREADS; i++)
-       gsum[i]=0;
-
-   printf("Each thread subrange is %d\n", range);
-
-   for(i=0; i<NUM_THREADS; i++)
+   unsigned long long n=COUNT;
+   preduceConfig_t config;
+   preduceSum_t gsumall, expected;
+   char sumString[40], expectedString[40];
+   struct timespec start, stop;
+   int maxThreads=sysconf(_SC_NPROCESSORS_ONLN);
+
+   config.nthreads=NUM_THREADS;
+   config.chunk=0;
+
+   // sumdigits bench [n] [max threads]
+   if((argc >= 2) && (strcmp(argv[1], "bench") == 0))
    {
-      threadParams[i].threadIdx=i;
-      threadParams[i].start=(i*range);
-      threadParams[i].end=((i*range)+range)-1;
-
-      pthread_create(&threads[i], (void *)0, sumThread, (void *)&(threadParams[i]));
+      if(argc >= 3) sscanf(argv[2], "%llu", &n);
+      if(argc >= 4) sscanf(argv[3], "%d", &maxThreads);
+      if(maxThreads < 1) maxThreads=1;
+
+      if(n == ULLONG_MAX)
+      {
+         printf("n must be less than %llu, the range is 0...n+1\n", ULLONG_MAX);
+         return -1;
+      }
+
+      benchmark(n, maxThreads);
+      return 0;
    }
 
-   for(i=0; i<NUM_THREADS; i++)
-     pthread_join(threads[i], NULL);
-
-   // we add int COUNT here in the final reduction since each worker
-   // summed up to n-1, so we have to add final value n
-   for(i=0; i<NUM_THREADS; i++)
-       gsumall+=gsum[i];
+   // sumdigits [n] [threads] [chunk]
+   if(argc >= 2) sscanf(argv[1], "%llu", &n);
+   if(argc >= 3) sscanf(argv[2], "%d", &config.nthreads);
+   if(argc >= 4) sscanf(argv[3], "%llu", &config.chunk);
 
-   gsumall+=COUNT;
+   // n+1 would wrap to an empty range
+   if(n == ULLONG_MAX)
+   {
+      printf("n must be less than %llu, the range is 0...n+1\n", ULLONG_MAX);
+      return -1;
+   }
 
-   printf("TEST COMPLETE: gsum[0]=%d, gsum[1]=%d, gsumall=%d\n", 
-          gsum[0], gsum[1], gsumall);
+   clock_gettime(CLOCK_MONOTONIC, &start);
+   gsumall=parallelReduce(0, n+1, sumRange, NULL, 0, NULL, &config);
+   clock_gettime(CLOCK_MONOTONIC, &stop);
 
    // Verfiy that sum of thread indexed sums is (n*(n+1))/2
-   printf("TEST COMPLETE: gsumall=%d, [n[n+1]]/2=%d\n", gsumall, (COUNT*(COUNT+1))/2);
+   expected=((preduceSum_t)n*(n+1))/2;
+   printf("TEST %s: gsumall=%s, [n[n+1]]/2=%s in %lf secs\n",
+          (gsumall == expected) ? "COMPLETE" : "FAILED",
+          preduceSumString(gsumall, sumString), preduceSumString(expected, expectedString),
+          elapsedSecs(&start, &stop));
+
+   return (gsumall == expected) ? 0 : -1;
 }